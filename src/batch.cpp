@@ -0,0 +1,178 @@
+#include "batch.hpp"
+#include "uci.hpp"
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+BatchAnalyzer::BatchAnalyzer(const Options& options) : options(options) {
+    this->options.threads = std::max(1, options.threads);
+    
+    for (int i = 0; i < this->options.threads; i++) {
+        queues.push_back(std::make_unique<WorkQueue>());
+        engines.push_back(std::make_unique<SearchEngine>(options.hash_mb));
+    }
+}
+
+size_t BatchAnalyzer::run(std::istream& in, std::ostream& out) {
+    auto start = std::chrono::steady_clock::now();
+    size_t chunk_size = JOBS_PER_THREAD * options.threads;
+    size_t total = 0;
+    std::string line;
+    
+    write_header(out);
+    
+    while (in) {
+        // Read the next chunk, reusing the line buffers of the previous one
+        size_t count = 0;
+        while (count < chunk_size && std::getline(in, line)) {
+            size_t start_pos = line.find_first_not_of(" \t\r");
+            if (start_pos == std::string::npos || line[start_pos] == '#') continue;
+            
+            if (count == jobs.size()) jobs.emplace_back();
+            Job& job = jobs[count];
+            job.index = total + count;
+            job.line.assign(line, start_pos, line.find_last_not_of(" \t\r") + 1 - start_pos);
+            job.valid = false;
+            count++;
+        }
+        
+        if (count == 0) break;
+        
+        // Deal the jobs round-robin so that neighbouring lines spread out
+        for (size_t i = 0; i < count; i++) {
+            queues[i % options.threads]->jobs.push_back(i);
+        }
+        
+        std::vector<std::thread> threads;
+        for (int id = 0; id < options.threads; id++) {
+            threads.emplace_back(&BatchAnalyzer::worker, this, id, std::ref(out));
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        
+        if (options.ordered) {
+            for (size_t i = 0; i < count; i++) {
+                write_result(out, jobs[i]);
+            }
+        }
+        out.flush();
+        
+        total += count;
+    }
+    
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "batch: " << total << " positions in " << seconds << " s, "
+              << (seconds > 0 ? total / seconds : 0.0) << " positions/s on "
+              << options.threads << " threads" << std::endl;
+    
+    return total;
+}
+
+void BatchAnalyzer::worker(int id, std::ostream& out) {
+    Position pos;
+    SearchEngine& engine = *engines[id];
+    size_t index;
+    
+    while (next_job(id, index)) {
+        Job& job = jobs[index];
+        
+        job.valid = pos.set_fen(job.line);
+        if (job.valid) {
+            engine.search(pos, options.limits);
+            job.result = engine.last_result();
+        }
+        
+        if (!options.ordered) {
+            std::lock_guard<std::mutex> lock(output_mutex);
+            write_result(out, job);
+        }
+    }
+}
+
+bool BatchAnalyzer::next_job(int id, size_t& job) {
+    {
+        WorkQueue& own = *queues[id];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = own.jobs.back();
+            own.jobs.pop_back();
+            return true;
+        }
+    }
+    
+    // Steal the oldest job of the next non-empty queue
+    for (int i = 1; i < options.threads; i++) {
+        WorkQueue& victim = *queues[(id + i) % options.threads];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+void BatchAnalyzer::write_header(std::ostream& out) {
+    if (options.format == CSV) {
+        out << "index,id,bestmove,score,depth,nodes,time_ms,pv\n";
+    }
+}
+
+void BatchAnalyzer::write_result(std::ostream& out, const Job& job) {
+    std::string_view id = epd_id(job.line);
+    const SearchEngine::SearchResult& r = job.result;
+    
+    if (options.format == CSV) {
+        out << job.index << ",\"";
+        for (char c : id) {
+            out << c;
+            if (c == '"') out << '"';
+        }
+        out << "\",";
+        
+        if (job.valid) {
+            out << MoveUtils::to_string(r.best_move) << ',' << UCIInterface::format_score(r.score) << ','
+                << r.depth << ',' << r.nodes << ',' << r.time_ms << ',' << UCIInterface::format_pv(r.pv);
+        } else {
+            out << "error,,,,,";
+        }
+        out << '\n';
+        return;
+    }
+    
+    out << "{\"index\":" << job.index << ",\"id\":\"";
+    for (char c : id) {
+        if (c == '"' || c == '\\') out << '\\';
+        out << c;
+    }
+    out << '"';
+    
+    if (job.valid) {
+        out << ",\"bestmove\":\"" << MoveUtils::to_string(r.best_move) << '"'
+            << ",\"score\":\"" << UCIInterface::format_score(r.score) << '"'
+            << ",\"depth\":" << r.depth
+            << ",\"nodes\":" << r.nodes
+            << ",\"time_ms\":" << r.time_ms
+            << ",\"pv\":\"" << UCIInterface::format_pv(r.pv) << '"';
+    } else {
+        out << ",\"error\":\"invalid fen\"";
+    }
+    out << "}\n";
+}
+
+// The value of an EPD "id" operation, e.g. id "WAC.001";
+std::string_view BatchAnalyzer::epd_id(std::string_view line) {
+    size_t pos = line.find(" id ");
+    if (pos == std::string_view::npos) return std::string_view();
+    
+    size_t start = line.find('"', pos);
+    if (start == std::string_view::npos) return std::string_view();
+    
+    size_t end = line.find('"', start + 1);
+    if (end == std::string_view::npos) return std::string_view();
+    
+    return line.substr(start + 1, end - start - 1);
+}
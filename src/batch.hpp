@@ -0,0 +1,56 @@
+// ===== BATCH ANALYSIS =====
+#include <deque>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+
+// Analyses a stream of FEN/EPD lines on a pool of threads, each with its
+// own SearchEngine. Lines are read in chunks; every worker owns a queue of
+// jobs and steals from the others once its own queue runs dry.
+class BatchAnalyzer {
+public:
+    enum OutputFormat { JSONL, CSV };
+    
+    struct Options {
+        int threads = 1;
+        size_t hash_mb = 16;
+        SearchEngine::SearchInfo limits;
+        OutputFormat format = JSONL;
+        bool ordered = true; // otherwise results are written as they finish
+    };
+    
+    explicit BatchAnalyzer(const Options& options);
+    
+    // Returns the number of positions analysed
+    size_t run(std::istream& in, std::ostream& out);
+    
+private:
+    static constexpr size_t JOBS_PER_THREAD = 256;
+    
+    struct Job {
+        size_t index;
+        std::string line;
+        bool valid;
+        SearchEngine::SearchResult result;
+    };
+    
+    // The owner pops from the back, thieves take from the front
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<size_t> jobs;
+    };
+    
+    Options options;
+    std::vector<Job> jobs;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::unique_ptr<SearchEngine>> engines;
+    std::mutex output_mutex;
+    
+    void worker(int id, std::ostream& out);
+    bool next_job(int id, size_t& job);
+    void write_header(std::ostream& out);
+    void write_result(std::ostream& out, const Job& job);
+    
+    static std::string_view epd_id(std::string_view line);
+};
@@ -0,0 +1,31 @@
+// ===== BENCHMARK =====
+#include <ostream>
+
+// Searches a fixed set of positions to a fixed depth. Every position starts
+// from a cleared engine, so the total node count is a functional signature
+// of the search that does not depend on timing or the number of threads.
+class Benchmark {
+public:
+    struct Options {
+        int depth = 8;
+        int threads = 1;
+        size_t hash_mb = 16;
+        bool json = false;
+    };
+    
+    // bench [depth] [threads] [hashMB] [json]
+    static Options parse_options(const std::vector<std::string>& args);
+    static uint64_t run(const Options& options, std::ostream& out);
+    
+private:
+    struct PositionResult {
+        int nodes = 0;
+        int qnodes = 0;
+        int time_ms = 0;
+        int tt_probes = 0;
+        int tt_hits = 0;
+    };
+    
+    static const char* const positions[];
+    static const size_t position_count;
+};
@@ -2,12 +2,15 @@
 #include <bit>
 
 // Static member initialization
-Bitboard BitboardUtils::attack_tables[PIECE_TYPE_NB][SQUARE_NB];
 Bitboard BitboardUtils::rook_attacks[SQUARE_NB][4096];
 Bitboard BitboardUtils::bishop_attacks[SQUARE_NB][512];
+Bitboard BitboardUtils::rook_masks[SQUARE_NB];
+Bitboard BitboardUtils::bishop_masks[SQUARE_NB];
 Bitboard BitboardUtils::knight_attacks[SQUARE_NB];
 Bitboard BitboardUtils::king_attacks[SQUARE_NB];
 Bitboard BitboardUtils::pawn_attacks[COLOR_NB][SQUARE_NB];
+bool BitboardUtils::use_popcnt = POPCNT_NATIVE;
+bool BitboardUtils::use_pext = PEXT_NATIVE;
 
 // Magic bitboard constants
 const Bitboard BitboardUtils::rook_magics[SQUARE_NB] = {
@@ -49,24 +52,31 @@ const Bitboard BitboardUtils::bishop_magics[SQUARE_NB] = {
 };
 
 void BitboardUtils::init() {
+    detect_cpu();
     init_knight_attacks();
     init_king_attacks();
     init_pawn_attacks();
     init_magics();
 }
 
-Square BitboardUtils::lsb(Bitboard b) {
-    return Square(std::countr_zero(b));
-}
-
-Square BitboardUtils::pop_lsb(Bitboard& b) {
-    Square s = lsb(b);
-    b &= b - 1;
-    return s;
+// PEXT is microcoded on AMD before Zen 3 (families 15h and 17h) and much
+// slower there than a magic multiplication, so those CPUs keep the magics
+void BitboardUtils::detect_cpu() {
+    if constexpr (CPU_DISPATCH_ENABLED) {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+        __builtin_cpu_init();
+        bool slow_pext = __builtin_cpu_is("amdfam15h") || __builtin_cpu_is("amdfam17h");
+        
+        use_popcnt = POPCNT_NATIVE || __builtin_cpu_supports("popcnt");
+        use_pext = PEXT_NATIVE || (__builtin_cpu_supports("bmi2") && !slow_pext);
+#endif
+    }
 }
 
-int BitboardUtils::popcount(Bitboard b) {
-    return std::popcount(b);
+std::string BitboardUtils::cpu_path() {
+    std::string path = use_popcnt ? "popcnt" : "generic";
+    path += use_pext ? " pext" : " magic";
+    return path;
 }
 
 void BitboardUtils::init_knight_attacks() {
@@ -177,17 +187,19 @@ void BitboardUtils::init_magics() {
     
     // Initialize rook attacks
     for (Square s = A1; s <= H8; ++s) {
+        rook_masks[s] = rook_mask(s);
         for (int i = 0; i < 4096; i++) {
-            Bitboard occupied = index_to_bitboard(i, rook_mask(s));
-            rook_attacks[s][i] = sliding_attacks(s, occupied, rook_deltas, 4);
+            Bitboard occupied = index_to_bitboard(i, rook_masks[s]);
+            rook_attacks[s][rook_index(s, occupied)] = sliding_attacks(s, occupied, rook_deltas, 4);
         }
     }
     
     // Initialize bishop attacks
     for (Square s = A1; s <= H8; ++s) {
+        bishop_masks[s] = bishop_mask(s);
         for (int i = 0; i < 512; i++) {
-            Bitboard occupied = index_to_bitboard(i, bishop_mask(s));
-            bishop_attacks[s][i] = sliding_attacks(s, occupied, bishop_deltas, 4);
+            Bitboard occupied = index_to_bitboard(i, bishop_masks[s]);
+            bishop_attacks[s][bishop_index(s, occupied)] = sliding_attacks(s, occupied, bishop_deltas, 4);
         }
     }
 }
@@ -249,34 +261,3 @@ Bitboard BitboardUtils::index_to_bitboard(int index, Bitboard mask) {
     
     return result;
 }
-
-// Attack getters using magic bitboards
-Bitboard BitboardUtils::get_rook_attacks(Square sq, Bitboard occupied) {
-    occupied &= rook_mask(sq);
-    occupied *= rook_magics[sq];
-    occupied >>= 52;  // 64 - 12 bits
-    return rook_attacks[sq][occupied];
-}
-
-Bitboard BitboardUtils::get_bishop_attacks(Square sq, Bitboard occupied) {
-    occupied &= bishop_mask(sq);
-    occupied *= bishop_magics[sq];
-    occupied >>= 55;  // 64 - 9 bits
-    return bishop_attacks[sq][occupied];
-}
-
-Bitboard BitboardUtils::get_queen_attacks(Square sq, Bitboard occupied) {
-    return get_rook_attacks(sq, occupied) | get_bishop_attacks(sq, occupied);
-}
-
-Bitboard BitboardUtils::get_knight_attacks(Square sq) {
-    return knight_attacks[sq];
-}
-
-Bitboard BitboardUtils::get_king_attacks(Square sq) {
-    return king_attacks[sq];
-}
-
-Bitboard BitboardUtils::get_pawn_attacks(Square sq, Color c) {
-    return pawn_attacks[c][sq];
-}
\ No newline at end of file
@@ -1,8 +1,39 @@
 // ===== BITBOARD UTILITIES =====
+#include <bit>
+#include <cstdlib>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+// The bit kernels use POPCNT and, for slider lookups, BMI2 PEXT. A build
+// targeting them (-mpopcnt, -mbmi2, -march=native) uses them directly. A
+// generic x86-64 build checks the CPU once in init() and picks a path with
+// a well-predicted branch; the instructions are emitted as inline assembly
+// so the kernels stay inlinable without being compiled for one target.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+constexpr bool CPU_DISPATCH_ENABLED = true;
+#else
+constexpr bool CPU_DISPATCH_ENABLED = false;
+#endif
+
+#ifdef __POPCNT__
+constexpr bool POPCNT_NATIVE = true;
+#else
+constexpr bool POPCNT_NATIVE = false;
+#endif
+
+#ifdef __BMI2__
+constexpr bool PEXT_NATIVE = true;
+#else
+constexpr bool PEXT_NATIVE = false;
+#endif
+
 class BitboardUtils {
 private:
     static Bitboard rook_attacks[SQUARE_NB][4096];
     static Bitboard bishop_attacks[SQUARE_NB][512];
+    static Bitboard rook_masks[SQUARE_NB];
+    static Bitboard bishop_masks[SQUARE_NB];
     static Bitboard knight_attacks[SQUARE_NB];
     static Bitboard king_attacks[SQUARE_NB];
     static Bitboard pawn_attacks[COLOR_NB][SQUARE_NB];
@@ -10,19 +41,89 @@ private:
     static const Bitboard rook_magics[SQUARE_NB];
     static const Bitboard bishop_magics[SQUARE_NB];
     
+    // Selected once by detect_cpu(), before the slider tables are filled
+    static bool use_popcnt;
+    static bool use_pext;
+    
+    static void detect_cpu();
     static void init_knight_attacks();
     static void init_king_attacks();
     static void init_pawn_attacks();
+    static void init_magics();
     static Bitboard sliding_attacks(Square sq, Bitboard occupied, const int deltas[][2], int num_deltas);
     static Bitboard rook_mask(Square sq);
     static Bitboard bishop_mask(Square sq);
     static Bitboard index_to_bitboard(int index, Bitboard mask);
-
+    
+    static Bitboard pext(Bitboard b, Bitboard mask) {
+#if defined(__BMI2__)
+        return _pext_u64(b, mask);
+#elif defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+        asm("pextq %2, %1, %0" : "=r"(b) : "r"(b), "r"(mask));
+        return b;
+#else
+        return b & mask;  // not reached: PEXT is only selected on x86-64
+#endif
+    }
+    
+    // Index into the slider tables, by PEXT or by magic multiplication
+    static size_t rook_index(Square sq, Bitboard occupied) {
+        if (PEXT_NATIVE || use_pext) return size_t(pext(occupied, rook_masks[sq]));
+        return size_t(((occupied & rook_masks[sq]) * rook_magics[sq]) >> 52);  // 64 - 12 bits
+    }
+    
+    static size_t bishop_index(Square sq, Bitboard occupied) {
+        if (PEXT_NATIVE || use_pext) return size_t(pext(occupied, bishop_masks[sq]));
+        return size_t(((occupied & bishop_masks[sq]) * bishop_magics[sq]) >> 55);  // 64 - 9 bits
+    }
+    
 public:
-    static Bitboard get_rook_attacks(Square sq, Bitboard occupied);
-    static Bitboard get_bishop_attacks(Square sq, Bitboard occupied);
-    static Bitboard get_queen_attacks(Square sq, Bitboard occupied);
-    static Bitboard get_knight_attacks(Square sq);
-    static Bitboard get_king_attacks(Square sq);
-    static Bitboard get_pawn_attacks(Square sq, Color c);
+    static void init();
+    
+    // The paths selected for this CPU, e.g. "popcnt pext"
+    static std::string cpu_path();
+    
+    static constexpr Bitboard square_bb(Square s) { return 1ULL << s; }
+    
+    static Square lsb(Bitboard b) { return Square(std::countr_zero(b)); }
+    
+    static Square pop_lsb(Bitboard& b) {
+        Square s = lsb(b);
+        b &= b - 1;
+        return s;
+    }
+    
+    static int popcount(Bitboard b) {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+        if (!POPCNT_NATIVE && use_popcnt) {
+            asm("popcntq %1, %0" : "=r"(b) : "r"(b));
+            return int(b);
+        }
+#endif
+        return std::popcount(b);
+    }
+    
+    static Bitboard get_rook_attacks(Square sq, Bitboard occupied) { return rook_attacks[sq][rook_index(sq, occupied)]; }
+    static Bitboard get_bishop_attacks(Square sq, Bitboard occupied) { return bishop_attacks[sq][bishop_index(sq, occupied)]; }
+    static Bitboard get_queen_attacks(Square sq, Bitboard occupied) {
+        return get_rook_attacks(sq, occupied) | get_bishop_attacks(sq, occupied);
+    }
+    static Bitboard get_knight_attacks(Square sq) { return knight_attacks[sq]; }
+    static Bitboard get_king_attacks(Square sq) { return king_attacks[sq]; }
+    static Bitboard get_pawn_attacks(Square sq, Color c) { return pawn_attacks[c][sq]; }
+    
+    // Squares strictly between two squares sharing a rank, file or diagonal
+    static Bitboard between_squares(Square a, Square b) {
+        Bitboard ends = square_bb(a) | square_bb(b);
+        
+        if (a / 8 == b / 8 || a % 8 == b % 8) {
+            return get_rook_attacks(a, ends) & get_rook_attacks(b, ends);
+        }
+        
+        if (std::abs(a / 8 - b / 8) == std::abs(a % 8 - b % 8)) {
+            return get_bishop_attacks(a, ends) & get_bishop_attacks(b, ends);
+        }
+        
+        return 0ULL;
+    }
 };
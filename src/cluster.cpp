@@ -0,0 +1,689 @@
+#include "cluster.hpp"
+#include "uci.hpp"
+#include "movegen.hpp"
+#include "move_utils.hpp"
+#include <algorithm>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+    // Replays a "position" command up to its first illegal move, which is
+    // left in invalid_move; false when its FEN is invalid
+    bool set_position(Position& pos, const std::vector<std::string>& tokens, std::string& invalid_move) {
+        std::string base;
+        std::vector<std::string> moves;
+        if (!UCIInterface::parse_position(tokens, base, moves)) return false;
+        
+        Position result;
+        if (!result.set_fen(base)) return false;
+        invalid_move.clear();
+        for (const std::string& move : moves) {
+            Move m = UCIInterface::parse_move(move, result);
+            if (MoveUtils::is_null(m)) {
+                invalid_move = move;
+                break;
+            }
+            result.do_move(m);
+        }
+        
+        pos = result;
+        return true;
+    }
+    
+    void set_no_delay(int fd) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+}
+
+ClusterLink::~ClusterLink() {
+    if (fd >= 0) close(fd);
+}
+
+void ClusterLink::send(const std::string& line) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    std::string data = line + '\n';
+    
+    for (size_t sent = 0; sent < data.size();) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        sent += size_t(n);
+    }
+}
+
+bool ClusterLink::receive(std::vector<std::string>& lines) {
+    char buffer[65536];
+    ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) return false;
+    
+    input.append(buffer, size_t(n));
+    
+    size_t start = 0;
+    size_t newline;
+    while ((newline = input.find('\n', start)) != std::string::npos) {
+        lines.push_back(input.substr(start, newline - start));
+        start = newline + 1;
+    }
+    input.erase(0, start);
+    
+    return true;
+}
+
+void ClusterLink::flush_export(TTExport& log, const std::vector<ClusterLink*>& links) {
+    std::vector<TTEntry> entries;
+    {
+        std::lock_guard<std::mutex> lock(log.mutex);
+        entries.swap(log.entries);
+    }
+    
+    for (size_t first = 0; first < entries.size(); first += ENTRIES_PER_LINE) {
+        std::string line = "tt";
+        for (size_t i = first; i < std::min(entries.size(), first + ENTRIES_PER_LINE); i++) {
+            const TTEntry& e = entries[i];
+            line += ' ' + std::to_string(e.key) + ' ' + std::to_string(e.score) + ' '
+                  + std::to_string(e.best_move) + ' ' + std::to_string(e.depth) + ' ' + std::to_string(e.flag);
+        }
+        for (ClusterLink* link : links) {
+            link->send(line);
+        }
+    }
+}
+
+// Runs while this process searches: a slot is only accepted when it
+// matches its key, so a merge racing a store or probe of the same slot
+// costs that entry and nothing else. Malformed entries are skipped.
+void ClusterLink::merge_entries(TranspositionTable& tt, const std::vector<std::string>& tokens) {
+    for (size_t i = 1; i + 5 <= tokens.size(); i += 5) {
+        TTEntry entry{};
+        bool valid = UCIInterface::parse_number(tokens[i], entry.key)
+                     && UCIInterface::parse_number(tokens[i + 1], entry.score)
+                     && UCIInterface::parse_number(tokens[i + 2], entry.best_move)
+                     && UCIInterface::parse_number(tokens[i + 3], entry.depth)
+                     && UCIInterface::parse_number(tokens[i + 4], entry.flag)
+                     && entry.flag <= LOWER_BOUND;
+        if (valid) tt.merge(entry);
+    }
+}
+
+bool ClusterLink::split_address(const std::string& address, std::string& host, std::string& port) {
+    size_t colon = address.rfind(':');
+    host = colon == std::string::npos ? "" : address.substr(0, colon);
+    port = colon == std::string::npos ? address : address.substr(colon + 1);
+    return !port.empty();
+}
+
+ClusterCoordinator::ClusterCoordinator(const Options& options)
+    : options(options), listen_fd(-1), engine(options.hash_mb), searching(false),
+      shutting_down(false), reported_depth(0) {
+    this->options.ranks = std::max(1, options.ranks);
+    ranks.resize(this->options.ranks);
+    
+    exported.min_depth = ClusterLink::SHARE_DEPTH;
+    engine.table().set_export(&exported);
+    position.set_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    position_command = "position startpos";
+}
+
+ClusterCoordinator::~ClusterCoordinator() {
+    handle_stop();
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutting_down = true;
+    }
+    if (network_thread.joinable()) network_thread.join();
+    
+    // Workers exit once their connection is closed
+    ranks.clear();
+    if (listen_fd >= 0) close(listen_fd);
+    for (pid_t pid : children) {
+        waitpid(pid, nullptr, 0);
+    }
+}
+
+bool ClusterCoordinator::run() {
+    if (options.ranks > 1 && (!open_socket() || (options.spawn_local && !spawn_workers()) || !accept_workers())) {
+        return false;
+    }
+    
+    network_thread = std::thread(&ClusterCoordinator::network_loop, this);
+    
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::vector<std::string> tokens = UCIInterface::split_string(line);
+        if (tokens.empty()) continue;
+        
+        const std::string& command = tokens[0];
+        
+        if (command == "uci") {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::cout << "id name Nexus Chess" << std::endl;
+            std::cout << "id author the Nexus Chess developers" << std::endl;
+            std::cout << "info string cluster of " << options.ranks << " ranks" << std::endl;
+            std::cout << "uciok" << std::endl;
+        } else if (command == "isready") {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::cout << "readyok" << std::endl;
+        } else if (command == "ucinewgame") {
+            handle_stop();
+            engine.clear();
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            for (Rank& rank : ranks) {
+                if (rank.link) rank.link->send("newgame");
+            }
+        } else if (command == "position") {
+            handle_stop();
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            std::string invalid_move;
+            if (set_position(position, tokens, invalid_move)) {
+                if (!invalid_move.empty()) std::cout << "info string invalid move " << invalid_move << std::endl;
+                position_command = line;
+                for (Rank& rank : ranks) {
+                    if (rank.link) rank.link->send(line);
+                }
+            } else {
+                std::cout << "info string invalid position" << std::endl;
+            }
+        } else if (command == "go") {
+            handle_go(tokens);
+        } else if (command == "stop") {
+            handle_stop();
+        } else if (command == "quit") {
+            break;
+        }
+    }
+    
+    return true;
+}
+
+bool ClusterCoordinator::open_socket() {
+    std::string host;
+    std::string port;
+    if (!ClusterLink::split_address(options.address, host, port)) {
+        std::cerr << "invalid address: " << options.address << std::endl;
+        return false;
+    }
+    
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+        std::cerr << "cannot resolve " << options.address << std::endl;
+        return false;
+    }
+    
+    for (addrinfo* a = addresses; a && listen_fd < 0; a = a->ai_next) {
+        listen_fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (listen_fd < 0) continue;
+        
+        int one = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(listen_fd, a->ai_addr, a->ai_addrlen) != 0 || listen(listen_fd, SOMAXCONN) != 0) {
+            close(listen_fd);
+            listen_fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    
+    if (listen_fd < 0) {
+        std::cerr << "cannot listen on " << options.address << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Local ranks are this executable in worker mode, connecting back to us
+bool ClusterCoordinator::spawn_workers() {
+    std::string host;
+    std::string port;
+    ClusterLink::split_address(options.address, host, port);
+    if (host.empty() || host == "0.0.0.0") host = "127.0.0.1";
+    
+    std::string address = host + ':' + port;
+    std::string hash = std::to_string(options.hash_mb);
+    
+    for (int i = 1; i < options.ranks; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            execl("/proc/self/exe", "nexus", "cluster", "--connect", address.c_str(),
+                  "--hash", hash.c_str(), static_cast<char*>(nullptr));
+            _exit(127);
+        }
+        if (pid < 0) {
+            std::cerr << "cannot start a local rank" << std::endl;
+            return false;
+        }
+        children.push_back(pid);
+    }
+    
+    return true;
+}
+
+// Ranks are numbered in the order the workers connect
+bool ClusterCoordinator::accept_workers() {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.connect_timeout_ms);
+    
+    for (int rank = 1; rank < options.ranks; rank++) {
+        int remaining = int(std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count());
+        
+        pollfd fd{listen_fd, POLLIN, 0};
+        if (remaining <= 0 || poll(&fd, 1, remaining) <= 0) {
+            std::cerr << "only " << rank << " of " << options.ranks << " ranks connected" << std::endl;
+            return false;
+        }
+        
+        int worker_fd = accept(listen_fd, nullptr, nullptr);
+        if (worker_fd < 0) {
+            rank--;
+            continue;
+        }
+        
+        set_no_delay(worker_fd);
+        ranks[rank].link = std::make_unique<ClusterLink>(worker_fd);
+        ranks[rank].link->send(position_command);
+    }
+    
+    return true;
+}
+
+// Every rank gets the same limits except the node budget, which is split.
+// Ranks that have disconnected get no root moves.
+void ClusterCoordinator::handle_go(const std::vector<std::string>& tokens) {
+    handle_stop();
+    
+    std::vector<std::string> invalid;
+    SearchEngine::SearchInfo info = UCIInterface::parse_go(tokens, position.side_to_move(), &invalid);
+    
+    std::vector<Move> moves = position.in_check() ? MoveGenerator::generate_evasions(position)
+                                                  : MoveGenerator::generate_moves(position);
+    std::vector<Move> legal;
+    for (Move m : moves) {
+        if (position.is_legal(m)) legal.push_back(m);
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    for (const std::string& value : invalid) {
+        std::cout << "info string ignoring invalid " << value << std::endl;
+    }
+    
+    if (legal.empty()) {
+        std::cout << "bestmove 0000" << std::endl;
+        return;
+    }
+    
+    std::vector<int> live = {0};
+    for (int r = 1; r < options.ranks; r++) {
+        if (ranks[r].link) live.push_back(r);
+    }
+    
+    int participants = std::min(int(live.size()), int(legal.size()));
+    std::vector<std::vector<Move>> dealt(options.ranks);
+    for (size_t i = 0; i < legal.size(); i++) {
+        dealt[live[i % participants]].push_back(legal[i]);
+    }
+    
+    root_moves = legal;
+    searching = true;
+    reported_depth = 0;
+    best = SearchEngine::SearchResult();
+    best.best_move = legal[0];
+    start_time = std::chrono::steady_clock::now();
+    
+    info.max_nodes = std::max(1, info.max_nodes / participants);
+    
+    for (int r = 0; r < options.ranks; r++) {
+        Rank& rank = ranks[r];
+        rank.iterations.clear();
+        rank.nodes = 0;
+        rank.searching = !dealt[r].empty();
+        if (!rank.searching || !rank.link) continue;
+        
+        std::string command = "go depth " + std::to_string(info.max_depth)
+                            + " movetime " + std::to_string(info.max_time_ms)
+                            + " nodes " + std::to_string(info.max_nodes)
+                            + (info.infinite ? " infinite" : "") + " searchmoves";
+        for (Move m : dealt[r]) {
+            command += ' ' + MoveUtils::to_string(m);
+        }
+        rank.link->send(command);
+    }
+    
+    info.search_moves = dealt[0];
+    info.on_iteration = [this](const SearchEngine::SearchResult& result) {
+        std::lock_guard<std::mutex> guard(mutex);
+        on_iteration(0, result);
+    };
+    
+    // A "stop" right after this "go" reaches the search even before it starts
+    engine.clear_stop();
+    search_thread = std::thread([this, info]() {
+        engine.search(position, info);
+        
+        std::lock_guard<std::mutex> guard(mutex);
+        on_done(0, engine.last_result().nodes);
+    });
+}
+
+// Stops every rank and waits for the bestmove of the search
+void ClusterCoordinator::handle_stop() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (searching) {
+            engine.stop_search();
+            for (Rank& rank : ranks) {
+                if (rank.link && rank.searching) rank.link->send("stop");
+            }
+            search_finished.wait(lock, [this] { return !searching; });
+        }
+    }
+    
+    if (search_thread.joinable()) search_thread.join();
+}
+
+// Reads the workers and relays the shared table entries until shutdown
+void ClusterCoordinator::network_loop() {
+    std::vector<ClusterLink*> all_links;
+    std::vector<pollfd> fds;
+    std::vector<int> polled;
+    std::vector<std::string> lines;
+    auto next_exchange = std::chrono::steady_clock::now();
+    
+    for (Rank& rank : ranks) {
+        if (rank.link) all_links.push_back(rank.link.get());
+    }
+    
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (shutting_down) return;
+        }
+        
+        fds.clear();
+        polled.clear();
+        for (int r = 1; r < options.ranks; r++) {
+            if (!ranks[r].link) continue;
+            fds.push_back({ranks[r].link->descriptor(), POLLIN, 0});
+            polled.push_back(r);
+        }
+        
+        if (!fds.empty()) {
+            poll(fds.data(), fds.size(), ClusterLink::EXCHANGE_INTERVAL_MS);
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(ClusterLink::EXCHANGE_INTERVAL_MS));
+        }
+        
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (!fds[i].revents) continue;
+            
+            int r = polled[i];
+            lines.clear();
+            bool connected = ranks[r].link->receive(lines);
+            
+            for (const std::string& line : lines) {
+                handle_message(r, UCIInterface::split_string(line), line);
+            }
+            
+            if (!connected) {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::cout << "info string rank " << r << " disconnected" << std::endl;
+                all_links.erase(std::find(all_links.begin(), all_links.end(), ranks[r].link.get()));
+                ranks[r].link.reset();
+                if (ranks[r].searching) on_done(r, ranks[r].nodes);
+            }
+        }
+        
+        if (std::chrono::steady_clock::now() >= next_exchange) {
+            ClusterLink::flush_export(exported, all_links);
+            next_exchange = std::chrono::steady_clock::now()
+                          + std::chrono::milliseconds(ClusterLink::EXCHANGE_INTERVAL_MS);
+        }
+    }
+}
+
+void ClusterCoordinator::handle_message(int rank, const std::vector<std::string>& tokens, const std::string& line) {
+    if (tokens.empty()) return;
+    
+    if (tokens[0] == "tt") {
+        // Entries go to everybody but their sender
+        ClusterLink::merge_entries(engine.table(), tokens);
+        for (int r = 1; r < options.ranks; r++) {
+            if (r != rank && ranks[r].link) ranks[r].link->send(line);
+        }
+    } else if (tokens[0] == "iteration" && tokens.size() >= 6) {
+        SearchEngine::SearchResult result;
+        if (!UCIInterface::parse_number(tokens[1], result.depth)
+            || !UCIInterface::parse_number(tokens[2], result.seldepth)
+            || !UCIInterface::parse_number(tokens[3], result.score)
+            || !UCIInterface::parse_number(tokens[4], result.nodes)
+            || !UCIInterface::parse_number(tokens[5], result.time_ms)) {
+            return;
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        Position pos = position;
+        for (size_t i = 6; i < tokens.size(); i++) {
+            Move m = UCIInterface::parse_move(tokens[i], pos);
+            if (MoveUtils::is_null(m)) break;
+            result.pv.push_back(m);
+            pos.do_move(m);
+        }
+        if (!result.pv.empty()) result.best_move = result.pv[0];
+        
+        on_iteration(rank, result);
+    } else if (tokens[0] == "done" && tokens.size() >= 2) {
+        // A rank that reports garbage still has to finish the search
+        int nodes = 0;
+        UCIInterface::parse_number(tokens[1], nodes);
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        on_done(rank, nodes);
+    }
+}
+
+// Requires the mutex
+void ClusterCoordinator::on_iteration(int rank, const SearchEngine::SearchResult& result) {
+    if (!searching || !ranks[rank].searching) return;
+    
+    ranks[rank].iterations.push_back(result);
+    ranks[rank].nodes = result.nodes;
+    report_iterations();
+}
+
+// Requires the mutex
+void ClusterCoordinator::on_done(int rank, int nodes) {
+    if (!searching || !ranks[rank].searching) return;
+    
+    ranks[rank].searching = false;
+    ranks[rank].nodes = nodes;
+    
+    for (const Rank& r : ranks) {
+        if (r.searching) return;
+    }
+    
+    report_iterations();
+    searching = false;
+    std::cout << "bestmove " << MoveUtils::to_string(best.best_move) << std::endl;
+    search_finished.notify_all();
+}
+
+// Requires the mutex. An iteration is complete once every rank that has
+// root moves has reported it; a rank that stopped early holds it back.
+void ClusterCoordinator::report_iterations() {
+    while (true) {
+        SearchEngine::SearchResult combined;
+        bool complete = true;
+        bool any = false;
+        
+        for (const Rank& rank : ranks) {
+            if (rank.iterations.empty() && !rank.searching) continue;
+            if (int(rank.iterations.size()) <= reported_depth) {
+                complete = false;
+                break;
+            }
+            
+            const SearchEngine::SearchResult& r = rank.iterations[reported_depth];
+            if (!any || r.score > combined.score) {
+                combined.best_move = r.best_move;
+                combined.score = r.score;
+                combined.pv = r.pv;
+            }
+            combined.seldepth = std::max(combined.seldepth, r.seldepth);
+            any = true;
+        }
+        
+        if (!complete || !any) return;
+        
+        reported_depth++;
+        combined.depth = reported_depth;
+        for (const Rank& rank : ranks) {
+            combined.nodes += rank.nodes;
+        }
+        combined.time_ms = elapsed_ms();
+        best = combined;
+        
+        std::cout << UCIInterface::format_info(combined) << std::endl;
+    }
+}
+
+int ClusterCoordinator::elapsed_ms() const {
+    auto elapsed = std::chrono::steady_clock::now() - start_time;
+    return int(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+}
+
+ClusterWorker::ClusterWorker(const Options& options) : options(options), engine(options.hash_mb) {
+    exported.min_depth = ClusterLink::SHARE_DEPTH;
+    engine.table().set_export(&exported);
+    position.set_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+}
+
+ClusterWorker::~ClusterWorker() {
+    handle_stop();
+}
+
+bool ClusterWorker::run() {
+    if (!connect_coordinator()) return false;
+    
+    std::vector<ClusterLink*> links = {link.get()};
+    std::vector<std::string> lines;
+    auto next_exchange = std::chrono::steady_clock::now();
+    
+    while (true) {
+        pollfd fd{link->descriptor(), POLLIN, 0};
+        if (poll(&fd, 1, ClusterLink::EXCHANGE_INTERVAL_MS) > 0) {
+            lines.clear();
+            bool connected = link->receive(lines);
+            
+            for (const std::string& line : lines) {
+                handle_message(UCIInterface::split_string(line));
+            }
+            if (!connected) break;
+        }
+        
+        if (std::chrono::steady_clock::now() >= next_exchange) {
+            ClusterLink::flush_export(exported, links);
+            next_exchange = std::chrono::steady_clock::now()
+                          + std::chrono::milliseconds(ClusterLink::EXCHANGE_INTERVAL_MS);
+        }
+    }
+    
+    return true;
+}
+
+// Retries until the coordinator is listening or the timeout expires
+bool ClusterWorker::connect_coordinator() {
+    std::string host;
+    std::string port;
+    if (!ClusterLink::split_address(options.address, host, port) || host.empty()) {
+        std::cerr << "invalid address: " << options.address << std::endl;
+        return false;
+    }
+    
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.connect_timeout_ms);
+    
+    while (std::chrono::steady_clock::now() < deadline) {
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) == 0) {
+            for (addrinfo* a = addresses; a; a = a->ai_next) {
+                int fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+                if (fd < 0) continue;
+                
+                if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) {
+                    freeaddrinfo(addresses);
+                    set_no_delay(fd);
+                    link = std::make_unique<ClusterLink>(fd);
+                    return true;
+                }
+                close(fd);
+            }
+            freeaddrinfo(addresses);
+        }
+        
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    
+    std::cerr << "cannot connect to " << options.address << std::endl;
+    return false;
+}
+
+void ClusterWorker::handle_message(const std::vector<std::string>& tokens) {
+    if (tokens.empty()) return;
+    
+    const std::string& command = tokens[0];
+    
+    if (command == "tt") {
+        ClusterLink::merge_entries(engine.table(), tokens);
+    } else if (command == "position") {
+        handle_stop();
+        std::string invalid_move;
+        set_position(position, tokens, invalid_move);
+    } else if (command == "newgame") {
+        handle_stop();
+        engine.clear();
+    } else if (command == "stop") {
+        engine.stop_search();
+    } else if (command == "go") {
+        handle_stop();
+        
+        SearchEngine::SearchInfo info = UCIInterface::parse_go(tokens, position.side_to_move());
+        auto first = std::find(tokens.begin(), tokens.end(), "searchmoves");
+        for (auto it = first == tokens.end() ? first : first + 1; it != tokens.end(); ++it) {
+            Move m = MoveUtils::from_string(*it, position);
+            if (!MoveUtils::is_null(m)) info.search_moves.push_back(m);
+        }
+        
+        info.on_iteration = [this](const SearchEngine::SearchResult& result) {
+            link->send("iteration " + std::to_string(result.depth) + ' ' + std::to_string(result.seldepth) + ' '
+                       + std::to_string(result.score) + ' ' + std::to_string(result.nodes) + ' '
+                       + std::to_string(result.time_ms) + ' ' + UCIInterface::format_pv(result.pv));
+        };
+        
+        // The coordinator's "stop" may arrive before the search has started
+        engine.clear_stop();
+        search_thread = std::thread([this, info]() {
+            engine.search(position, info);
+            link->send("done " + std::to_string(engine.last_result().nodes));
+        });
+    }
+}
+
+void ClusterWorker::handle_stop() {
+    engine.stop_search();
+    if (search_thread.joinable()) search_thread.join();
+}
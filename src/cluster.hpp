@@ -0,0 +1,144 @@
+// ===== CLUSTER SEARCH =====
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// A search spread over several engine processes that talk over TCP, one
+// line per message. Rank 0 is the coordinator: it speaks UCI on stdin and
+// stdout, deals the legal root moves round-robin to every rank including
+// itself, and reports an iteration once all ranks have completed it. Each
+// rank searches its root moves with a full window, so the best of their
+// scores is the score of the position.
+//
+// Every rank also exports the entries of at least SHARE_DEPTH it stores in
+// its transposition table; the coordinator relays them to the other ranks
+// every EXCHANGE_INTERVAL_MS.
+//
+// Coordinator to worker:
+//   position <as in UCI>
+//   go depth <d> movetime <ms> nodes <n> [infinite] searchmoves <moves>
+//   stop | newgame
+//   tt {<key> <score> <move> <depth> <flag>}
+// Worker to coordinator:
+//   iteration <depth> <seldepth> <score> <nodes> <time_ms> <pv>
+//   done <nodes>
+//   tt {<key> <score> <move> <depth> <flag>}
+class ClusterLink {
+public:
+    static constexpr int SHARE_DEPTH = 5;
+    static constexpr int EXCHANGE_INTERVAL_MS = 50;
+    static constexpr size_t ENTRIES_PER_LINE = 64;
+    
+    explicit ClusterLink(int fd) : fd(fd) {}
+    ~ClusterLink();
+    
+    // Output to a peer that has gone is dropped silently
+    void send(const std::string& line);
+    
+    // Appends the complete lines received; false once the peer has gone
+    bool receive(std::vector<std::string>& lines);
+    
+    int descriptor() const { return fd; }
+    
+    // Sends the entries exported since the last call
+    static void flush_export(TTExport& log, const std::vector<ClusterLink*>& links);
+    static void merge_entries(TranspositionTable& tt, const std::vector<std::string>& tokens);
+    
+    // "host:port", with the port alone meaning all interfaces
+    static bool split_address(const std::string& address, std::string& host, std::string& port);
+    
+private:
+    int fd;
+    std::string input;
+    std::mutex write_mutex;
+};
+
+class ClusterCoordinator {
+public:
+    struct Options {
+        std::string address = "127.0.0.1:7600";
+        int ranks = 2;              // including the coordinator
+        size_t hash_mb = 64;        // per rank
+        bool spawn_local = false;   // start ranks 1..N-1 on this host
+        int connect_timeout_ms = 10000;
+    };
+    
+    explicit ClusterCoordinator(const Options& options);
+    ~ClusterCoordinator();
+    
+    // Waits for the workers, then serves UCI until "quit"; false if the
+    // cluster could not be assembled
+    bool run();
+    
+private:
+    struct Rank {
+        std::unique_ptr<ClusterLink> link;   // none for rank 0
+        std::vector<SearchEngine::SearchResult> iterations;
+        int nodes = 0;
+        bool searching = false;
+    };
+    
+    Options options;
+    int listen_fd;
+    std::vector<pid_t> children;
+    std::vector<Rank> ranks;
+    
+    SearchEngine engine;
+    TTExport exported;
+    Position position;
+    std::string position_command;
+    std::thread search_thread;
+    std::thread network_thread;
+    
+    // Protected by the mutex, which also serialises stdout
+    std::mutex mutex;
+    std::condition_variable search_finished;
+    bool searching;
+    bool shutting_down;
+    int reported_depth;
+    SearchEngine::SearchResult best;
+    std::vector<Move> root_moves;
+    std::chrono::steady_clock::time_point start_time;
+    
+    bool open_socket();
+    bool spawn_workers();
+    bool accept_workers();
+    void handle_go(const std::vector<std::string>& tokens);
+    void handle_stop();
+    void network_loop();
+    void handle_message(int rank, const std::vector<std::string>& tokens, const std::string& line);
+    void on_iteration(int rank, const SearchEngine::SearchResult& result);
+    void on_done(int rank, int nodes);
+    void report_iterations();
+    int elapsed_ms() const;
+};
+
+class ClusterWorker {
+public:
+    struct Options {
+        std::string address;
+        size_t hash_mb = 64;
+        int connect_timeout_ms = 10000;
+    };
+    
+    explicit ClusterWorker(const Options& options);
+    ~ClusterWorker();
+    
+    // Serves the coordinator until it disconnects; false if it could not
+    // be reached
+    bool run();
+    
+private:
+    Options options;
+    std::unique_ptr<ClusterLink> link;
+    SearchEngine engine;
+    TTExport exported;
+    Position position;
+    std::thread search_thread;
+    
+    bool connect_coordinator();
+    void handle_message(const std::vector<std::string>& tokens);
+    void handle_stop();
+};
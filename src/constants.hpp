@@ -1,7 +1,7 @@
 // ===== TYPES AND CONSTANTS =====
 using Bitboard = uint64_t;
 using Square = int;
-using Move = uint32_t;
+using Move = uint16_t;
 using Score = int;
 
 enum Color { WHITE, BLACK, COLOR_NB };
@@ -24,3 +24,18 @@ enum Squares {
     A8, B8, C8, D8, E8, F8, G8, H8,
     SQUARE_NB = 64
 };
+
+// Castling rights bits
+constexpr int WHITE_OO = 1;
+constexpr int WHITE_OOO = 2;
+constexpr int BLACK_OO = 4;
+constexpr int BLACK_OOO = 8;
+
+// Seed of the Zobrist keys; saved tables are only valid for the same keys
+constexpr uint64_t ZOBRIST_SEED = 12345;
+
+// Search score bounds
+constexpr int MAX_PLY = 128;
+constexpr Score SCORE_INFINITE = 32001;
+constexpr Score SCORE_MATE = 32000;
+constexpr Score SCORE_MATE_IN_MAX_PLY = SCORE_MATE - MAX_PLY;
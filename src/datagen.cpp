@@ -0,0 +1,141 @@
+#include "datagen.hpp"
+#include "bitboard_utils.hpp"
+#include "movegen.hpp"
+#include "move_utils.hpp"
+#include <chrono>
+#include <thread>
+
+SelfPlayGenerator::SelfPlayGenerator(const Options& options) : options(options), next_game(0) {
+    this->options.threads = std::max(1, options.threads);
+}
+
+uint64_t SelfPlayGenerator::run(PackedWriter& writer, std::ostream& log) {
+    next_game = 0;
+    stats.assign(options.threads, ThreadStats());
+    
+    auto start = std::chrono::steady_clock::now();
+    
+    std::vector<std::thread> threads;
+    for (int i = 0; i < options.threads; i++) {
+        threads.emplace_back(&SelfPlayGenerator::worker, this, i, std::ref(writer));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    uint64_t games = 0;
+    uint64_t positions = 0;
+    for (int i = 0; i < options.threads; i++) {
+        const ThreadStats& s = stats[i];
+        games += s.games;
+        positions += s.positions;
+        log << "thread " << i << ": " << s.games << " games, " << s.positions << " positions, "
+            << uint64_t(s.seconds > 0 ? s.positions / s.seconds : 0) << " positions/s" << std::endl;
+    }
+    
+    log << games << " games, " << positions << " positions in " << seconds << " s, "
+        << uint64_t(seconds > 0 ? positions / seconds : 0) << " positions/s" << std::endl;
+    
+    return positions;
+}
+
+void SelfPlayGenerator::worker(int id, PackedWriter& writer) {
+    SearchEngine engine(options.hash_mb);
+    std::mt19937_64 rng(options.seed * 0x9E3779B97F4A7C15ULL + id);
+    std::vector<PackedPosition> records;
+    ThreadStats& s = stats[id];
+    
+    auto start = std::chrono::steady_clock::now();
+    
+    while (next_game.fetch_add(1) < options.games) {
+        records.clear();
+        engine.clear();
+        
+        GameOutcome result = play_game(engine, rng, records);
+        for (PackedPosition& record : records) {
+            record.result = result;
+        }
+        
+        writer.write(records);
+        s.games++;
+        s.positions += records.size();
+    }
+    
+    s.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Plays one game and records the quiet positions of it; results are
+// filled in by the caller once the outcome is known
+GameOutcome SelfPlayGenerator::play_game(SearchEngine& engine, std::mt19937_64& rng,
+                                         std::vector<PackedPosition>& records) {
+    Position pos;
+    while (!random_opening(pos, rng)) {}
+    
+    int resign_count[COLOR_NB] = {0, 0};
+    int draw_count = 0;
+    
+    for (int ply = 0; ply < options.max_plies; ply++) {
+        Color us = pos.side_to_move();
+        
+        if (legal_moves(pos).empty()) {
+            if (!pos.in_check()) return DRAWN;
+            return us == WHITE ? BLACK_WINS : WHITE_WINS;
+        }
+        
+        // Fifty moves, repetition or bare kings
+        if (pos.halfmove_count() >= 100 || pos.is_repetition()
+            || BitboardUtils::popcount(pos.pieces()) == 2) {
+            return DRAWN;
+        }
+        
+        Move best_move = engine.search(pos, options.limits);
+        Score score = engine.last_result().score;
+        
+        // Positions in check, with a capture or promotion to come, or with
+        // a mate score say little about the static evaluation
+        if (!pos.in_check() && MoveUtils::is_quiet(best_move, pos)
+            && std::abs(score) < SCORE_MATE_IN_MAX_PLY) {
+            records.push_back(PackedPosition::pack(pos, score, DRAWN));
+        }
+        
+        // Adjudication, with scores from the side to move's point of view
+        if (score <= -options.resign_score) {
+            if (++resign_count[us] >= options.resign_plies) return us == WHITE ? BLACK_WINS : WHITE_WINS;
+        } else {
+            resign_count[us] = 0;
+        }
+        
+        if (ply >= options.draw_min_ply && std::abs(score) <= options.draw_score) {
+            if (++draw_count >= options.draw_plies) return DRAWN;
+        } else {
+            draw_count = 0;
+        }
+        
+        pos.do_move(best_move);
+    }
+    
+    return DRAWN;
+}
+
+// False when the random moves ended the game, so the caller tries again
+bool SelfPlayGenerator::random_opening(Position& pos, std::mt19937_64& rng) {
+    pos = Position();
+    
+    for (int ply = 0; ply < options.random_plies; ply++) {
+        std::vector<Move> moves = legal_moves(pos);
+        if (moves.empty()) return false;
+        pos.do_move(moves[rng() % moves.size()]);
+    }
+    
+    return !legal_moves(pos).empty();
+}
+
+std::vector<Move> SelfPlayGenerator::legal_moves(const Position& pos) {
+    std::vector<Move> moves = pos.in_check() ? MoveGenerator::generate_evasions(pos)
+                                             : MoveGenerator::generate_moves(pos);
+    moves.erase(std::remove_if(moves.begin(), moves.end(), [&](Move m) { return !pos.is_legal(m); }),
+                moves.end());
+    return moves;
+}
@@ -0,0 +1,56 @@
+// ===== SELF-PLAY DATA GENERATION =====
+#include <atomic>
+#include <ostream>
+#include <random>
+
+// Plays engine-vs-itself games on a pool of threads, each with its own
+// SearchEngine, and writes every recorded position with its search score
+// and the final game result as a PackedPosition.
+class SelfPlayGenerator {
+public:
+    struct Options {
+        int threads = 1;
+        size_t hash_mb = 16;
+        uint64_t games = 1000;
+        uint64_t seed = 1;
+        SearchEngine::SearchInfo limits;
+        
+        // Random legal moves played before the engines take over
+        int random_plies = 8;
+        
+        // A side resigns after scoring below -resign_score on this many of
+        // its own moves in a row
+        Score resign_score = 1000;
+        int resign_plies = 4;
+        
+        // Draw after this many consecutive plies within the score, once
+        // draw_min_ply has been reached
+        Score draw_score = 10;
+        int draw_plies = 12;
+        int draw_min_ply = 80;
+        
+        int max_plies = 400;
+    };
+    
+    explicit SelfPlayGenerator(const Options& options);
+    
+    // Returns the number of positions written
+    uint64_t run(PackedWriter& writer, std::ostream& log);
+    
+private:
+    struct ThreadStats {
+        uint64_t games = 0;
+        uint64_t positions = 0;
+        double seconds = 0;
+    };
+    
+    Options options;
+    std::atomic<uint64_t> next_game;
+    std::vector<ThreadStats> stats;
+    
+    void worker(int id, PackedWriter& writer);
+    GameOutcome play_game(SearchEngine& engine, std::mt19937_64& rng, std::vector<PackedPosition>& records);
+    bool random_opening(Position& pos, std::mt19937_64& rng);
+    
+    static std::vector<Move> legal_moves(const Position& pos);
+};
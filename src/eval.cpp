@@ -0,0 +1,445 @@
+#include "eval.hpp"
+#include "eval_params.hpp"
+#include "bitboard_utils.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+    constexpr Bitboard FILE_A_BB = 0x0101010101010101ULL;
+    constexpr Bitboard DARK_SQUARES = 0xAA55AA55AA55AA55ULL;
+    
+    constexpr int phase_weights[PIECE_TYPE_NB] = {0, 1, 1, 2, 4, 0};
+    
+    // Added to the score of an ending that is won with correct play, so
+    // that the search heads for it; still below any mate score
+    constexpr Score KNOWN_WIN = 10000;
+    
+    // Squares as seen from white's side, so both colours share one table
+    Square relative_square(Color c, Square sq) {
+        return c == WHITE ? sq : sq ^ 56;
+    }
+    
+    Bitboard adjacent_files(int file) {
+        return (file > 0 ? FILE_A_BB << (file - 1) : 0) | (file < 7 ? FILE_A_BB << (file + 1) : 0);
+    }
+    
+    // Ranks strictly in front of the square from c's point of view
+    Bitboard forward_ranks(Color c, Square sq) {
+        int rank = sq / 8;
+        if (c == WHITE) return rank == 7 ? 0 : ~0ULL << (8 * (rank + 1));
+        return rank == 0 ? 0 : (1ULL << (8 * rank)) - 1;
+    }
+    
+    Bitboard pawn_attacks(Color c, Bitboard pawns) {
+        Bitboard attacks = 0;
+        while (pawns) {
+            attacks |= BitboardUtils::get_pawn_attacks(BitboardUtils::pop_lsb(pawns), c);
+        }
+        return attacks;
+    }
+    
+    Bitboard piece_attacks(PieceType pt, Square sq, Bitboard occupied) {
+        switch (pt) {
+            case KNIGHT: return BitboardUtils::get_knight_attacks(sq);
+            case BISHOP: return BitboardUtils::get_bishop_attacks(sq, occupied);
+            case ROOK: return BitboardUtils::get_rook_attacks(sq, occupied);
+            case QUEEN: return BitboardUtils::get_queen_attacks(sq, occupied);
+            default: return 0;
+        }
+    }
+    
+    // Sums weighted counts for evaluate()
+    struct ScoreAccumulator {
+        int score[EVAL_PHASE_NB] = {0, 0};
+        
+        void add(int param, int count) {
+            score[MIDGAME] += EVAL_PARAMS[param][MIDGAME] * count;
+            score[ENDGAME] += EVAL_PARAMS[param][ENDGAME] * count;
+        }
+    };
+    
+    // Per thread, so that searching threads never share an entry
+    struct MaterialTable {
+        static constexpr size_t SIZE = 8192;
+        MaterialEntry entries[SIZE] = {};
+    };
+    
+    thread_local MaterialTable material_table;
+    
+    Piece make_piece(Color c, PieceType pt) {
+        return Piece((c == WHITE ? 0 : 6) + pt);
+    }
+    
+    Score piece_value(PieceType pt, EvalPhase phase) {
+        return EVAL_PARAMS[PARAM_MATERIAL + int(pt)][phase];
+    }
+    
+    Score non_pawn_material(const Position& pos, Color c) {
+        Score value = 0;
+        for (int pt = KNIGHT; pt <= QUEEN; pt++) {
+            value += piece_value(PieceType(pt), MIDGAME) * pos.count(make_piece(c, PieceType(pt)));
+        }
+        return value;
+    }
+    
+    int distance(Square a, Square b) {
+        return std::max(std::abs(a % 8 - b % 8), std::abs(a / 8 - b / 8));
+    }
+    
+    bool is_dark(Square sq) {
+        return DARK_SQUARES & BitboardUtils::square_bb(sq);
+    }
+    
+    // Drive the losing king to the edge and the winning king towards it
+    int push_to_edge(Square sq) {
+        int file = std::min(sq % 8, 7 - sq % 8);
+        int rank = std::min(sq / 8, 7 - sq / 8);
+        return 90 - 10 * (file + rank);
+    }
+    
+    int push_close(Square a, Square b) {
+        constexpr int bonus[8] = {0, 0, 100, 80, 60, 40, 20, 10};
+        return bonus[distance(a, b)];
+    }
+    
+    // Only a corner of the bishop's colour can be forced with bishop and knight
+    int push_to_bishop_corner(Square sq, bool dark_bishop) {
+        int corner = dark_bishop ? std::min(distance(sq, A1), distance(sq, H8))
+                                 : std::min(distance(sq, A8), distance(sq, H1));
+        return 100 * (7 - corner);
+    }
+    
+    // King and enough material against a bare king
+    Score evaluate_kxk(const Position& pos, Color strong) {
+        Color weak = Color(strong ^ 1);
+        Square strong_king = pos.king_square(strong);
+        Square weak_king = pos.king_square(weak);
+        
+        int knights = pos.count(make_piece(strong, KNIGHT));
+        int pawns = pos.count(make_piece(strong, PAWN));
+        Bitboard bishops = pos.pieces(strong, BISHOP);
+        Score material = non_pawn_material(pos, strong) + pawns * piece_value(PAWN, ENDGAME);
+        
+        // Two knights cannot force mate
+        if (!pawns && material == 2 * piece_value(KNIGHT, MIDGAME) && knights == 2) return 0;
+        
+        bool bishop_and_knight = bishops && knights && material == piece_value(BISHOP, MIDGAME) + piece_value(KNIGHT, MIDGAME);
+        Score result = material + push_close(strong_king, weak_king);
+        result += bishop_and_knight ? push_to_bishop_corner(weak_king, bishops & DARK_SQUARES)
+                                    : push_to_edge(weak_king);
+        
+        if (pos.pieces(strong, QUEEN) || pos.pieces(strong, ROOK) || bishop_and_knight
+            || ((bishops & DARK_SQUARES) && (bishops & ~DARK_SQUARES))) {
+            result += KNOWN_WIN;
+        }
+        return result;
+    }
+    
+    // Rook against a pawn: a win unless the pawn is far on and escorted by
+    // its king, with the winning king too far away to help
+    Score evaluate_krkp(const Position& pos, Color strong) {
+        Color weak = Color(strong ^ 1);
+        Square strong_king = relative_square(strong, pos.king_square(strong));
+        Square weak_king = relative_square(strong, pos.king_square(weak));
+        Square rook = relative_square(strong, BitboardUtils::lsb(pos.pieces(strong, ROOK)));
+        Square pawn = relative_square(strong, BitboardUtils::lsb(pos.pieces(weak, PAWN)));
+        Square queening = pawn % 8;
+        bool weak_to_move = pos.side_to_move() == weak;
+        Score rook_value = piece_value(ROOK, ENDGAME);
+        
+        // The winning king stands in front of the pawn
+        if (strong_king % 8 == pawn % 8 && strong_king < pawn) {
+            return rook_value - distance(strong_king, pawn);
+        }
+        
+        // The defending king is too far from both pawn and rook
+        if (distance(weak_king, pawn) >= 3 + weak_to_move && distance(weak_king, rook) >= 3) {
+            return rook_value - distance(strong_king, pawn);
+        }
+        
+        // The pawn is far on and escorted, with the winning king behind
+        if (weak_king / 8 <= 2 && distance(weak_king, pawn) == 1
+            && strong_king / 8 >= 3 && distance(strong_king, pawn) > 2 + !weak_to_move) {
+            return 80 - 8 * distance(strong_king, pawn);
+        }
+        
+        return 200 - 8 * (distance(strong_king, pawn - 8) - distance(weak_king, pawn - 8) - distance(pawn, queening));
+    }
+    
+    // Rook against a minor piece is a draw, harder to hold the closer the
+    // defending king is to the edge or the further it is from its knight
+    Score evaluate_krkm(const Position& pos, Color strong) {
+        constexpr int push_away[8] = {0, 5, 20, 40, 60, 80, 90, 100};
+        
+        Color weak = Color(strong ^ 1);
+        Square weak_king = pos.king_square(weak);
+        Score result = push_to_edge(weak_king);
+        
+        Bitboard knights = pos.pieces(weak, KNIGHT);
+        if (knights) result += push_away[distance(weak_king, BitboardUtils::lsb(knights))];
+        return result;
+    }
+    
+    // Where the pawns of the strong side queen if all of them are on one
+    // rook file, and SQUARE_NB otherwise
+    Square rook_pawn_queening_square(const Position& pos, Color strong) {
+        Bitboard pawns = pos.pieces(strong, PAWN);
+        for (int file : {0, 7}) {
+            if (!(pawns & ~(FILE_A_BB << file))) return relative_square(strong, 56 + file);
+        }
+        return SQUARE_NB;
+    }
+    
+    // Pawns only: rook pawns are a draw once the defending king reaches
+    // the queening square
+    int scale_kpsk(const Position& pos, Color strong) {
+        Square queening = rook_pawn_queening_square(pos, strong);
+        if (queening != SQUARE_NB && distance(pos.king_square(Color(strong ^ 1)), queening) <= 1) {
+            return SCALE_DRAW;
+        }
+        return SCALE_NONE;
+    }
+    
+    // Bishop and pawns. Rook pawns are a draw as above when the bishop does
+    // not control the queening square, and bishops of opposite colours are
+    // drawish with few pawns between them
+    int scale_kbpsk(const Position& pos, Color strong) {
+        Color weak = Color(strong ^ 1);
+        Square bishop = BitboardUtils::lsb(pos.pieces(strong, BISHOP));
+        Square queening = rook_pawn_queening_square(pos, strong);
+        
+        if (queening != SQUARE_NB && is_dark(queening) != is_dark(bishop)
+            && distance(pos.king_square(weak), queening) <= 1) {
+            return SCALE_DRAW;
+        }
+        
+        Bitboard weak_bishops = pos.pieces(weak, BISHOP);
+        if (BitboardUtils::popcount(weak_bishops) == 1
+            && pos.pieces(weak) == (weak_bishops | pos.pieces(weak, PAWN) | pos.pieces(weak, KING))
+            && is_dark(BitboardUtils::lsb(weak_bishops)) != is_dark(bishop)) {
+            int extra_pawns = pos.count(make_piece(strong, PAWN)) - pos.count(make_piece(weak, PAWN));
+            return extra_pawns <= 1 ? 16 : 32;
+        }
+        
+        return SCALE_NONE;
+    }
+    
+    // Records the counts themselves for the tuner
+    struct FeatureAccumulator {
+        int counts[EVAL_PARAM_NB] = {};
+        
+        void add(int param, int count) {
+            counts[param] += count;
+        }
+    };
+}
+
+Score Evaluator::evaluate(const Position& pos) {
+    const MaterialEntry& material = probe_material(pos);
+    
+    if (material.eval) {
+        Score score = material.eval(pos, material.strong);
+        return pos.side_to_move() == material.strong ? score : -score;
+    }
+    
+    ScoreAccumulator acc;
+    acc.score[MIDGAME] = material.score[MIDGAME];
+    acc.score[ENDGAME] = material.score[ENDGAME];
+    collect_positional(pos, acc);
+    
+    Color strong = acc.score[ENDGAME] > 0 ? WHITE : BLACK;
+    int factor = material.scale[strong] ? material.scale[strong](pos, strong) : SCALE_NONE;
+    if (factor == SCALE_NONE) factor = material.factor[strong];
+    
+    int phase = material.phase;
+    int endgame = acc.score[ENDGAME] * factor / SCALE_NORMAL;
+    Score score = (acc.score[MIDGAME] * phase + endgame * (PHASE_MAX - phase)) / PHASE_MAX;
+    return pos.side_to_move() == WHITE ? score : -score;
+}
+
+void Evaluator::extract_features(const Position& pos, EvalFeatures& features) {
+    FeatureAccumulator acc;
+    collect(pos, acc);
+    
+    features.terms.clear();
+    for (int param = 0; param < EVAL_PARAM_NB; param++) {
+        if (acc.counts[param]) {
+            features.terms.push_back({uint16_t(param), int16_t(acc.counts[param])});
+        }
+    }
+    features.phase = game_phase(pos);
+}
+
+int Evaluator::game_phase(const Position& pos) {
+    int phase = 0;
+    for (int pt = KNIGHT; pt <= QUEEN; pt++) {
+        phase += phase_weights[pt] * BitboardUtils::popcount(pos.pieces(PieceType(pt)));
+    }
+    return std::min(phase, PHASE_MAX);
+}
+
+const MaterialEntry& Evaluator::probe_material(const Position& pos) {
+    uint64_t key = pos.material_key();
+    MaterialEntry& entry = material_table.entries[key & (MaterialTable::SIZE - 1)];
+    if (entry.key != key) compute_material(pos, entry);
+    return entry;
+}
+
+void Evaluator::compute_material(const Position& pos, MaterialEntry& entry) {
+    ScoreAccumulator acc;
+    material_value(pos, WHITE, 1, acc);
+    material_value(pos, BLACK, -1, acc);
+    
+    entry.key = pos.material_key();
+    entry.score[MIDGAME] = acc.score[MIDGAME];
+    entry.score[ENDGAME] = acc.score[ENDGAME];
+    entry.phase = game_phase(pos);
+    entry.eval = nullptr;
+    entry.strong = WHITE;
+    
+    Score npm[COLOR_NB] = {non_pawn_material(pos, WHITE), non_pawn_material(pos, BLACK)};
+    int pawns[COLOR_NB] = {pos.count(W_PAWN), pos.count(B_PAWN)};
+    Score rook = piece_value(ROOK, MIDGAME);
+    Score bishop = piece_value(BISHOP, MIDGAME);
+    
+    for (Color us : {WHITE, BLACK}) {
+        Color them = Color(us ^ 1);
+        entry.scale[us] = nullptr;
+        entry.factor[us] = SCALE_NORMAL;
+        
+        if (!npm[them] && !pawns[them] && npm[us] >= rook) {
+            entry.eval = evaluate_kxk;
+            entry.strong = us;
+        } else if (npm[us] == rook && !pawns[us] && !npm[them] && pawns[them] == 1) {
+            entry.eval = evaluate_krkp;
+            entry.strong = us;
+        } else if (npm[us] == rook && !pawns[us] && !pawns[them]
+                   && (npm[them] == bishop || npm[them] == piece_value(KNIGHT, MIDGAME))) {
+            entry.eval = evaluate_krkm;
+            entry.strong = us;
+        }
+        
+        if (!npm[us] && !npm[them] && pawns[us]) {
+            entry.scale[us] = scale_kpsk;
+        } else if (npm[us] == bishop && pawns[us]) {
+            entry.scale[us] = scale_kbpsk;
+        }
+        
+        // Without pawns, up to a minor piece ahead is rarely enough to win
+        if (!pawns[us] && npm[us] - npm[them] <= bishop) {
+            entry.factor[us] = npm[us] < rook ? SCALE_DRAW : npm[them] <= bishop ? 4 : 14;
+        } else if (pawns[us] == 1 && npm[us] - npm[them] <= bishop) {
+            entry.factor[us] = SCALE_ONE_PAWN;
+        }
+    }
+}
+
+// White terms count +1 and black terms -1
+template<typename Accumulator>
+void Evaluator::collect(const Position& pos, Accumulator& acc) {
+    material_value(pos, WHITE, 1, acc);
+    material_value(pos, BLACK, -1, acc);
+    collect_positional(pos, acc);
+}
+
+template<typename Accumulator>
+void Evaluator::collect_positional(const Position& pos, Accumulator& acc) {
+    for (Color c : {WHITE, BLACK}) {
+        int sign = c == WHITE ? 1 : -1;
+        piece_square_value(pos, c, sign, acc);
+        mobility_value(pos, c, sign, acc);
+        king_safety_value(pos, c, sign, acc);
+        pawn_structure_value(pos, c, sign, acc);
+    }
+}
+
+template<typename Accumulator>
+void Evaluator::material_value(const Position& pos, Color c, int sign, Accumulator& acc) {
+    for (int pt = PAWN; pt <= QUEEN; pt++) {
+        int count = BitboardUtils::popcount(pos.pieces(c, PieceType(pt)));
+        if (count) acc.add(PARAM_MATERIAL + pt, sign * count);
+    }
+    
+    if (BitboardUtils::popcount(pos.pieces(c, BISHOP)) >= 2) {
+        acc.add(PARAM_BISHOP_PAIR, sign);
+    }
+}
+
+template<typename Accumulator>
+void Evaluator::piece_square_value(const Position& pos, Color c, int sign, Accumulator& acc) {
+    for (int pt = PAWN; pt <= KING; pt++) {
+        Bitboard pieces = pos.pieces(c, PieceType(pt));
+        while (pieces) {
+            Square sq = relative_square(c, BitboardUtils::pop_lsb(pieces));
+            acc.add(PARAM_PSQT + pt * 64 + sq, sign);
+        }
+    }
+}
+
+// Squares reachable that are neither own pieces nor guarded by enemy pawns
+template<typename Accumulator>
+void Evaluator::mobility_value(const Position& pos, Color c, int sign, Accumulator& acc) {
+    Color them = Color(c ^ 1);
+    Bitboard occupied = pos.pieces();
+    Bitboard available = ~pos.pieces(c) & ~pawn_attacks(them, pos.pieces(them, PAWN));
+    
+    for (int pt = KNIGHT; pt <= QUEEN; pt++) {
+        int mobility = 0;
+        Bitboard pieces = pos.pieces(c, PieceType(pt));
+        while (pieces) {
+            Square sq = BitboardUtils::pop_lsb(pieces);
+            mobility += BitboardUtils::popcount(piece_attacks(PieceType(pt), sq, occupied) & available);
+        }
+        if (mobility) acc.add(PARAM_MOBILITY + pt - KNIGHT, sign * mobility);
+    }
+}
+
+// Attacks on the enemy king's surroundings, and pawns sheltering our own king
+template<typename Accumulator>
+void Evaluator::king_safety_value(const Position& pos, Color c, int sign, Accumulator& acc) {
+    Color them = Color(c ^ 1);
+    Bitboard occupied = pos.pieces();
+    Square their_king = pos.king_square(them);
+    Bitboard king_zone = BitboardUtils::get_king_attacks(their_king);
+    
+    for (int pt = KNIGHT; pt <= QUEEN; pt++) {
+        int attacks = 0;
+        Bitboard pieces = pos.pieces(c, PieceType(pt));
+        while (pieces) {
+            Square sq = BitboardUtils::pop_lsb(pieces);
+            attacks += BitboardUtils::popcount(piece_attacks(PieceType(pt), sq, occupied) & king_zone);
+        }
+        if (attacks) acc.add(PARAM_KING_ATTACK + pt - KNIGHT, sign * attacks);
+    }
+    
+    Square our_king = pos.king_square(c);
+    Bitboard shelter = BitboardUtils::get_king_attacks(our_king) & forward_ranks(c, our_king);
+    int shield = BitboardUtils::popcount(shelter & pos.pieces(c, PAWN));
+    if (shield) acc.add(PARAM_PAWN_SHIELD, sign * shield);
+}
+
+template<typename Accumulator>
+void Evaluator::pawn_structure_value(const Position& pos, Color c, int sign, Accumulator& acc) {
+    Bitboard our_pawns = pos.pieces(c, PAWN);
+    Bitboard their_pawns = pos.pieces(Color(c ^ 1), PAWN);
+    
+    for (int file = 0; file < 8; file++) {
+        int count = BitboardUtils::popcount(our_pawns & (FILE_A_BB << file));
+        if (count > 1) acc.add(PARAM_DOUBLED_PAWN, sign * (count - 1));
+    }
+    
+    Bitboard pawns = our_pawns;
+    while (pawns) {
+        Square sq = BitboardUtils::pop_lsb(pawns);
+        int file = sq % 8;
+        Bitboard file_bb = FILE_A_BB << file;
+        
+        if (!(our_pawns & adjacent_files(file))) {
+            acc.add(PARAM_ISOLATED_PAWN, sign);
+        }
+        
+        if (!(their_pawns & forward_ranks(c, sq) & (file_bb | adjacent_files(file)))) {
+            acc.add(PARAM_PASSED_PAWN + relative_square(c, sq) / 8, sign);
+        }
+    }
+}
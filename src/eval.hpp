@@ -1,17 +1,88 @@
 // ===== EVALUATION =====
+
+// Every evaluation term is a weight times a count taken white minus black.
+// Each weight has a middlegame and an endgame value, blended by game phase,
+// so the whole evaluation is linear in the weights and can be tuned.
+enum EvalParam {
+    PARAM_MATERIAL = 0,                          // PAWN..QUEEN
+    PARAM_PSQT = PARAM_MATERIAL + 5,             // [piece type][square], from white's side
+    PARAM_MOBILITY = PARAM_PSQT + 6 * 64,        // KNIGHT..QUEEN, per reachable square
+    PARAM_KING_ATTACK = PARAM_MOBILITY + 4,      // KNIGHT..QUEEN, per attacked king zone square
+    PARAM_PAWN_SHIELD = PARAM_KING_ATTACK + 4,
+    PARAM_DOUBLED_PAWN,
+    PARAM_ISOLATED_PAWN,
+    PARAM_PASSED_PAWN,                           // by relative rank
+    PARAM_BISHOP_PAIR = PARAM_PASSED_PAWN + 8,
+    EVAL_PARAM_NB
+};
+
+enum EvalPhase { MIDGAME, ENDGAME, EVAL_PHASE_NB };
+
+// Non-pawn material left, 24 at the start and 0 with bare kings and pawns
+constexpr int PHASE_MAX = 24;
+
+// The endgame score of the side ahead is scaled by factor / SCALE_NORMAL
+constexpr int SCALE_NORMAL = 64;
+constexpr int SCALE_ONE_PAWN = 48;
+constexpr int SCALE_DRAW = 0;
+constexpr int SCALE_NONE = 255;   // from a scale function that does not apply
+
+// What depends only on the pieces on the board, cached by material key:
+// the material terms and the phase, and for the endings the evaluator
+// knows, an evaluation that replaces the general one or a scale factor
+struct MaterialEntry {
+    using EndgameEval = Score (*)(const Position& pos, Color strong);
+    using EndgameScale = int (*)(const Position& pos, Color strong);
+    
+    uint64_t key;
+    Score score[EVAL_PHASE_NB];      // white minus black
+    int phase;
+    EndgameEval eval;                // from the strong side's point of view
+    Color strong;
+    EndgameScale scale[COLOR_NB];    // applied to the side ahead in the endgame
+    uint8_t factor[COLOR_NB];        // when there is no scale function or it does not apply
+};
+
+// Sparse white-minus-black counts of one position
+struct EvalFeatures {
+    struct Term {
+        uint16_t param;
+        int16_t count;
+    };
+    
+    std::vector<Term> terms;
+    int phase = 0;
+};
+
 class Evaluator {
 public:
+    // From the side to move's point of view
     static Score evaluate(const Position& pos);
     
+    // The counts evaluate() multiplies its weights with, for the tuner;
+    // without the endgame evaluations and scale factors
+    static void extract_features(const Position& pos, EvalFeatures& features);
+    
+    static int game_phase(const Position& pos);
+    
 private:
-    static Score material_value(const Position& pos);
-    static Score piece_square_value(const Position& pos);
-    static Score mobility_value(const Position& pos);
-    static Score king_safety_value(const Position& pos);
-    static Score pawn_structure_value(const Position& pos);
+    // The entry of the calling thread's material table, filled in on a miss
+    static const MaterialEntry& probe_material(const Position& pos);
+    static void compute_material(const Position& pos, MaterialEntry& entry);
     
-    // Piece values in centipawns
-    static constexpr Score piece_values[PIECE_TYPE_NB] = {
-        100, 320, 330, 500, 900, 20000
-    };
+    template<typename Accumulator>
+    static void collect(const Position& pos, Accumulator& acc);
+    template<typename Accumulator>
+    static void collect_positional(const Position& pos, Accumulator& acc);
+    
+    template<typename Accumulator>
+    static void material_value(const Position& pos, Color c, int sign, Accumulator& acc);
+    template<typename Accumulator>
+    static void piece_square_value(const Position& pos, Color c, int sign, Accumulator& acc);
+    template<typename Accumulator>
+    static void mobility_value(const Position& pos, Color c, int sign, Accumulator& acc);
+    template<typename Accumulator>
+    static void king_safety_value(const Position& pos, Color c, int sign, Accumulator& acc);
+    template<typename Accumulator>
+    static void pawn_structure_value(const Position& pos, Color c, int sign, Accumulator& acc);
 };
@@ -0,0 +1,75 @@
+// ===== EVALUATION PARAMETERS =====
+// Generated by `nexus tune`; retune rather than editing by hand.
+// {middlegame, endgame} weight of every EvalParam, in centipawns.
+constexpr Score EVAL_PARAMS[EVAL_PARAM_NB][EVAL_PHASE_NB] = {
+    // Material
+    {82, 94}, {337, 281}, {365, 297}, {477, 512}, {1025, 936},
+    // Piece-square tables: pawn
+    {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0},
+    {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0},
+    {5, 10}, {5, 10}, {10, 10}, {10, 10}, {10, 10}, {10, 10}, {5, 10}, {5, 10},
+    {10, 20}, {10, 20}, {15, 20}, {20, 20}, {20, 20}, {15, 20}, {10, 20}, {10, 20},
+    {15, 30}, {15, 30}, {20, 30}, {25, 30}, {25, 30}, {20, 30}, {15, 30}, {15, 30},
+    {20, 40}, {20, 40}, {20, 40}, {20, 40}, {20, 40}, {20, 40}, {20, 40}, {20, 40},
+    {25, 50}, {25, 50}, {25, 50}, {25, 50}, {25, 50}, {25, 50}, {25, 50}, {25, 50},
+    {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0},
+    // Piece-square tables: knight
+    {-24, -20}, {-18, -15}, {-12, -10}, {-6, -5}, {-6, -5}, {-12, -10}, {-18, -15}, {-24, -20},
+    {-18, -15}, {-12, -10}, {-6, -5}, {0, 0}, {0, 0}, {-6, -5}, {-12, -10}, {-18, -15},
+    {-12, -10}, {-6, -5}, {0, 0}, {6, 5}, {6, 5}, {0, 0}, {-6, -5}, {-12, -10},
+    {-6, -5}, {0, 0}, {6, 5}, {12, 10}, {12, 10}, {6, 5}, {0, 0}, {-6, -5},
+    {-6, -5}, {0, 0}, {6, 5}, {12, 10}, {12, 10}, {6, 5}, {0, 0}, {-6, -5},
+    {-12, -10}, {-6, -5}, {0, 0}, {6, 5}, {6, 5}, {0, 0}, {-6, -5}, {-12, -10},
+    {-18, -15}, {-12, -10}, {-6, -5}, {0, 0}, {0, 0}, {-6, -5}, {-12, -10}, {-18, -15},
+    {-24, -20}, {-18, -15}, {-12, -10}, {-6, -5}, {-6, -5}, {-12, -10}, {-18, -15}, {-24, -20},
+    // Piece-square tables: bishop
+    {-12, -12}, {-9, -9}, {-6, -6}, {-3, -3}, {-3, -3}, {-6, -6}, {-9, -9}, {-12, -12},
+    {-9, -9}, {-6, -6}, {-3, -3}, {0, 0}, {0, 0}, {-3, -3}, {-6, -6}, {-9, -9},
+    {-6, -6}, {-3, -3}, {0, 0}, {3, 3}, {3, 3}, {0, 0}, {-3, -3}, {-6, -6},
+    {-3, -3}, {0, 0}, {3, 3}, {6, 6}, {6, 6}, {3, 3}, {0, 0}, {-3, -3},
+    {-3, -3}, {0, 0}, {3, 3}, {6, 6}, {6, 6}, {3, 3}, {0, 0}, {-3, -3},
+    {-6, -6}, {-3, -3}, {0, 0}, {3, 3}, {3, 3}, {0, 0}, {-3, -3}, {-6, -6},
+    {-9, -9}, {-6, -6}, {-3, -3}, {0, 0}, {0, 0}, {-3, -3}, {-6, -6}, {-9, -9},
+    {-12, -12}, {-9, -9}, {-6, -6}, {-3, -3}, {-3, -3}, {-6, -6}, {-9, -9}, {-12, -12},
+    // Piece-square tables: rook
+    {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0},
+    {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0},
+    {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0},
+    {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0},
+    {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0},
+    {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0},
+    {20, 10}, {20, 10}, {20, 10}, {20, 10}, {20, 10}, {20, 10}, {20, 10}, {20, 10},
+    {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0},
+    // Piece-square tables: queen
+    {-8, -16}, {-6, -12}, {-4, -8}, {-2, -4}, {-2, -4}, {-4, -8}, {-6, -12}, {-8, -16},
+    {-6, -12}, {-4, -8}, {-2, -4}, {0, 0}, {0, 0}, {-2, -4}, {-4, -8}, {-6, -12},
+    {-4, -8}, {-2, -4}, {0, 0}, {2, 4}, {2, 4}, {0, 0}, {-2, -4}, {-4, -8},
+    {-2, -4}, {0, 0}, {2, 4}, {4, 8}, {4, 8}, {2, 4}, {0, 0}, {-2, -4},
+    {-2, -4}, {0, 0}, {2, 4}, {4, 8}, {4, 8}, {2, 4}, {0, 0}, {-2, -4},
+    {-4, -8}, {-2, -4}, {0, 0}, {2, 4}, {2, 4}, {0, 0}, {-2, -4}, {-4, -8},
+    {-6, -12}, {-4, -8}, {-2, -4}, {0, 0}, {0, 0}, {-2, -4}, {-4, -8}, {-6, -12},
+    {-8, -16}, {-6, -12}, {-4, -8}, {-2, -4}, {-2, -4}, {-4, -8}, {-6, -12}, {-8, -16},
+    // Piece-square tables: king
+    {20, -32}, {30, -24}, {10, -16}, {0, -8}, {0, -8}, {10, -16}, {30, -24}, {20, -32},
+    {20, -24}, {20, -16}, {0, -8}, {0, 0}, {0, 0}, {0, -8}, {20, -16}, {20, -24},
+    {-20, -16}, {-20, -8}, {-20, 0}, {-20, 8}, {-20, 8}, {-20, 0}, {-20, -8}, {-20, -16},
+    {-30, -8}, {-30, 0}, {-30, 8}, {-30, 16}, {-30, 16}, {-30, 8}, {-30, 0}, {-30, -8},
+    {-40, -8}, {-40, 0}, {-40, 8}, {-40, 16}, {-40, 16}, {-40, 8}, {-40, 0}, {-40, -8},
+    {-50, -16}, {-50, -8}, {-50, 0}, {-50, 8}, {-50, 8}, {-50, 0}, {-50, -8}, {-50, -16},
+    {-60, -24}, {-60, -16}, {-60, -8}, {-60, 0}, {-60, 0}, {-60, -8}, {-60, -16}, {-60, -24},
+    {-70, -32}, {-70, -24}, {-70, -16}, {-70, -8}, {-70, -8}, {-70, -16}, {-70, -24}, {-70, -32},
+    // Mobility
+    {4, 4}, {3, 4}, {2, 4}, {1, 2},
+    // King zone attacks
+    {10, 2}, {8, 2}, {10, 2}, {12, 4},
+    // Pawn shield
+    {12, 0},
+    // Doubled pawns
+    {-10, -20},
+    // Isolated pawns
+    {-12, -10},
+    // Passed pawns by rank
+    {0, 0}, {5, 10}, {5, 15}, {10, 25}, {20, 45}, {35, 75}, {60, 120}, {0, 0},
+    // Bishop pair
+    {30, 50},
+};
@@ -0,0 +1,581 @@
+#include "main.hpp"
+#include "bitboard_utils.hpp"
+#include "uci.hpp"
+#include "batch.hpp"
+#include "bench.hpp"
+#include "microbench.hpp"
+#include "packed_position.hpp"
+#include "datagen.hpp"
+#include "tuner.hpp"
+#include "match.hpp"
+#include "server.hpp"
+#include "cluster.hpp"
+#include "position_index.hpp"
+#include "move_utils.hpp"
+#include "movegen.hpp"
+#include "search_trace.hpp"
+#include <chrono>
+#include <climits>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    // The value of a command-line option; one that is not a number is
+    // reported and the option keeps its previous value
+    template<typename T>
+    bool read_option(const char* mode, const std::string& option, const char* text, T& value) {
+        if (UCIInterface::parse_number(text, value)) return true;
+        
+        std::cerr << mode << ": ignoring " << option << " " << text << std::endl;
+        return false;
+    }
+}
+
+bool ChessEngine::initialized = false;
+
+void ChessEngine::initialize() {
+    if (initialized) return;
+    
+    BitboardUtils::init();
+    initialized = true;
+}
+
+void ChessEngine::run_uci() {
+    UCIInterface uci;
+    uci.run();
+}
+
+// Without arguments the engine speaks UCI on stdin/stdout; a first
+// argument selects one of the command-line modes instead
+int ChessEngine::run(int argc, char* argv[]) {
+    initialize();
+    
+    std::string mode = argc > 1 ? argv[1] : "";
+    
+    if (mode == "batch") {
+        return run_batch(argc - 2, argv + 2);
+    }
+    if (mode == "index") {
+        return run_index(argc - 2, argv + 2);
+    }
+    if (mode == "bench") {
+        return run_bench(argc - 2, argv + 2);
+    }
+    if (mode == "microbench") {
+        return run_microbench(argc - 2, argv + 2);
+    }
+    if (mode == "perft") {
+        return run_perft(argc - 2, argv + 2);
+    }
+    if (mode == "trace") {
+        return run_trace(argc - 2, argv + 2);
+    }
+    if (mode == "datagen") {
+        return run_datagen(argc - 2, argv + 2);
+    }
+    if (mode == "tune") {
+        return run_tune(argc - 2, argv + 2);
+    }
+    if (mode == "match") {
+        return run_match(argc - 2, argv + 2);
+    }
+    if (mode == "server") {
+        return run_server(argc - 2, argv + 2);
+    }
+    if (mode == "cluster") {
+        return run_cluster(argc - 2, argv + 2);
+    }
+    
+    run_uci();
+    return 0;
+}
+
+// batch [--threads N] [--hash MB] [--depth D] [--nodes N] [--movetime MS]
+//       [--format jsonl|csv] [--unordered] [file]
+// Reads FEN/EPD lines from the file, or from stdin when none is given.
+int ChessEngine::run_batch(int argc, char* argv[]) {
+    BatchAnalyzer::Options options;
+    std::string input_path;
+    bool has_limit = false;
+    
+    // Once any limit is given, the others no longer apply
+    options.limits.max_depth = MAX_PLY - 1;
+    options.limits.max_nodes = INT_MAX;
+    options.limits.max_time_ms = INT_MAX;
+    
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        
+        if (arg == "--threads" && has_value) {
+            read_option("batch", arg, argv[++i], options.threads);
+        } else if (arg == "--hash" && has_value) {
+            read_option("batch", arg, argv[++i], options.hash_mb);
+        } else if (arg == "--depth" && has_value) {
+            has_limit |= read_option("batch", arg, argv[++i], options.limits.max_depth);
+        } else if (arg == "--nodes" && has_value) {
+            has_limit |= read_option("batch", arg, argv[++i], options.limits.max_nodes);
+        } else if (arg == "--movetime" && has_value) {
+            has_limit |= read_option("batch", arg, argv[++i], options.limits.max_time_ms);
+        } else if (arg == "--format" && has_value) {
+            options.format = std::string(argv[++i]) == "csv" ? BatchAnalyzer::CSV : BatchAnalyzer::JSONL;
+        } else if (arg == "--unordered") {
+            options.ordered = false;
+        } else if (arg != "-") {
+            input_path = arg;
+        }
+    }
+    
+    if (!has_limit) {
+        options.limits = SearchEngine::SearchInfo();
+    }
+    
+    BatchAnalyzer analyzer(options);
+    
+    if (input_path.empty()) {
+        analyzer.run(std::cin, std::cout);
+    } else {
+        std::ifstream input(input_path);
+        if (!input) {
+            std::cerr << "batch: cannot open " << input_path << std::endl;
+            return 1;
+        }
+        analyzer.run(input, std::cout);
+    }
+    
+    return 0;
+}
+
+// index build <games.pgn> <out.idx> [--memory MB]
+// index query <index.idx> <fen>
+int ChessEngine::run_index(int argc, char* argv[]) {
+    std::string command = argc > 0 ? argv[0] : "";
+    
+    if (command == "build" && argc >= 3) {
+        size_t memory_mb = 1024;
+        if (argc >= 5 && std::string(argv[3]) == "--memory") {
+            read_option("index", "--memory", argv[4], memory_mb);
+        }
+        
+        std::FILE* input = std::fopen(argv[1], "rb");
+        if (!input) {
+            std::cerr << "index: cannot open " << argv[1] << std::endl;
+            return 1;
+        }
+        
+        auto start = std::chrono::steady_clock::now();
+        
+        PGNReader reader(input);
+        PositionIndexBuilder builder(argv[2], memory_mb);
+        PGNReader::Game game;
+        uint64_t invalid = 0;
+        
+        while (reader.next_game(game)) {
+            invalid += !game.valid;
+            builder.add_game(game);
+        }
+        std::fclose(input);
+        
+        double ingest_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        bool ok = builder.finish();
+        double total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        std::cerr << "index: " << builder.games() << " games (" << invalid << " with unreadable moves), "
+                  << (ingest_seconds > 0 ? builder.games() / ingest_seconds : 0.0) << " games/s ingest on one core, "
+                  << total_seconds << " s total" << std::endl;
+        return ok ? 0 : 1;
+    }
+    
+    if (command == "query" && argc >= 3) {
+        PositionIndex index;
+        if (!index.open(argv[1])) {
+            std::cerr << "index: cannot open " << argv[1] << std::endl;
+            return 1;
+        }
+        
+        std::string fen;
+        for (int i = 2; i < argc; i++) {
+            if (!fen.empty()) fen += ' ';
+            fen += argv[i];
+        }
+        
+        Position pos;
+        if (!pos.set_fen(fen)) {
+            std::cerr << "index: invalid fen" << std::endl;
+            return 1;
+        }
+        
+        PositionIndex::Stats stats = index.stats(pos.key());
+        std::cout << "games " << stats.games << " +" << stats.white_wins << " =" << stats.draws
+                  << " -" << stats.black_wins << std::endl;
+        
+        for (const PositionIndex::MoveStats& ms : stats.moves) {
+            std::cout << MoveUtils::to_algebraic(ms.move, pos) << ' ' << ms.count << " +" << ms.white_wins
+                      << " =" << ms.draws << " -" << ms.black_wins << std::endl;
+        }
+        
+        for (uint64_t offset : index.games(pos.key(), 20)) {
+            std::cout << "offset " << offset << std::endl;
+        }
+        return 0;
+    }
+    
+    std::cerr << "usage: index build <games.pgn> <out.idx> [--memory MB] | index query <index.idx> <fen>" << std::endl;
+    return 1;
+}
+
+// bench [depth] [threads] [hashMB] [json]
+int ChessEngine::run_bench(int argc, char* argv[]) {
+    std::vector<std::string> args(argv, argv + argc);
+    Benchmark::run(Benchmark::parse_options(args), std::cout);
+    return 0;
+}
+
+// microbench [filter] [--repetitions N] [--seed S]
+int ChessEngine::run_microbench(int argc, char* argv[]) {
+    std::vector<std::string> args(argv, argv + argc);
+    MicroBenchmark::run(MicroBenchmark::parse_options(args), std::cout);
+    return 0;
+}
+
+// perft [depth] [fen]
+// Without a FEN, runs the standard positions to their depth (capped by the
+// given one) and checks the counts against the published ones.
+int ChessEngine::run_perft(int argc, char* argv[]) {
+    struct PerftCase {
+        std::string fen;
+        int depth;
+        uint64_t expected;
+    };
+    
+    std::vector<PerftCase> cases = {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6, 119060324},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5, 193690690},
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 11030083},
+        {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292},
+        {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 5, 89941194},
+    };
+    
+    int max_depth = 5;
+    if (argc > 0) read_option("perft", "depth", argv[0], max_depth);
+    if (argc > 1) {
+        std::string fen;
+        for (int i = 1; i < argc; i++) {
+            if (!fen.empty()) fen += ' ';
+            fen += argv[i];
+        }
+        cases = {{fen, max_depth, 0}};
+    }
+    
+    uint64_t total = 0;
+    double total_seconds = 0;
+    bool ok = true;
+    
+    for (const PerftCase& c : cases) {
+        Position pos;
+        if (!pos.set_fen(c.fen)) {
+            std::cerr << "perft: invalid fen " << c.fen << std::endl;
+            return 1;
+        }
+        
+        int depth = std::min(c.depth, max_depth);
+        auto start = std::chrono::steady_clock::now();
+        uint64_t nodes = MoveGenerator::perft(pos, depth);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        // The published counts are for the full depth only
+        bool checked = c.expected != 0 && depth == c.depth;
+        std::cout << "depth " << depth << " nodes " << nodes << " time_ms " << int(seconds * 1000)
+                  << " mnps " << (seconds > 0 ? nodes / seconds / 1e6 : 0.0);
+        if (checked) std::cout << (nodes == c.expected ? " ok" : " MISMATCH");
+        std::cout << "  " << c.fen << std::endl;
+        
+        ok &= !checked || nodes == c.expected;
+        total += nodes;
+        total_seconds += seconds;
+    }
+    
+    std::cout << "total nodes " << total << " mnps " << (total_seconds > 0 ? total / total_seconds / 1e6 : 0.0)
+              << std::endl;
+    return ok ? 0 : 1;
+}
+
+// trace [--top N] <trace.bin>
+// Analyses a search tree recorded with TraceFile by a SEARCH_TRACE build.
+int ChessEngine::run_trace(int argc, char* argv[]) {
+    TraceAnalyzer::Options options;
+    std::string path;
+    
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        
+        if (arg == "--top" && has_value) {
+            read_option("trace", arg, argv[++i], options.top);
+        } else {
+            path = arg;
+        }
+    }
+    
+    if (path.empty()) {
+        std::cerr << "usage: trace [--top N] <trace.bin>" << std::endl;
+        return 1;
+    }
+    
+    if (!TraceAnalyzer::run(path, options, std::cout)) {
+        std::cerr << "trace: cannot read " << path << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// datagen [--threads N] [--games G] [--hash MB] [--depth D] [--nodes N]
+//         [--random-plies K] [--seed S] [--append] <out.bin>
+// datagen dump <in.bin> [count]
+int ChessEngine::run_datagen(int argc, char* argv[]) {
+    if (argc >= 2 && std::string(argv[0]) == "dump") {
+        PackedReader reader;
+        if (!reader.open(argv[1])) {
+            std::cerr << "datagen: cannot open " << argv[1] << std::endl;
+            return 1;
+        }
+        
+        static const char* outcomes[] = {"0-1", "1/2-1/2", "1-0"};
+        uint64_t limit = UINT64_MAX;
+        if (argc >= 3) read_option("datagen", "count", argv[2], limit);
+        PackedPosition record;
+        for (uint64_t i = 0; i < limit && reader.next(record); i++) {
+            std::cout << record.fen() << " | " << record.score << " | " << outcomes[record.result % 3] << "\n";
+        }
+        std::cout.flush();
+        return 0;
+    }
+    
+    SelfPlayGenerator::Options options;
+    std::string output_path;
+    bool append = false;
+    
+    // Fixed-depth games unless a node limit is given
+    options.limits.max_depth = 8;
+    options.limits.max_nodes = INT_MAX;
+    options.limits.max_time_ms = INT_MAX;
+    
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        
+        if (arg == "--threads" && has_value) {
+            read_option("datagen", arg, argv[++i], options.threads);
+        } else if (arg == "--games" && has_value) {
+            read_option("datagen", arg, argv[++i], options.games);
+        } else if (arg == "--hash" && has_value) {
+            read_option("datagen", arg, argv[++i], options.hash_mb);
+        } else if (arg == "--depth" && has_value) {
+            read_option("datagen", arg, argv[++i], options.limits.max_depth);
+        } else if (arg == "--nodes" && has_value) {
+            if (read_option("datagen", arg, argv[++i], options.limits.max_nodes)) {
+                options.limits.max_depth = MAX_PLY - 1;
+            }
+        } else if (arg == "--random-plies" && has_value) {
+            read_option("datagen", arg, argv[++i], options.random_plies);
+        } else if (arg == "--seed" && has_value) {
+            read_option("datagen", arg, argv[++i], options.seed);
+        } else if (arg == "--append") {
+            append = true;
+        } else {
+            output_path = arg;
+        }
+    }
+    
+    PackedWriter writer;
+    if (output_path.empty() || !writer.open(output_path, append)) {
+        std::cerr << "usage: datagen [options] <out.bin> | datagen dump <in.bin> [count]" << std::endl;
+        return 1;
+    }
+    
+    SelfPlayGenerator generator(options);
+    generator.run(writer, std::cerr);
+    return 0;
+}
+
+// tune [--threads N] [--epochs E] [--lr X] [--lambda L] [--positions N]
+//      [--output eval_params.hpp] <data.bin>...
+// Tunes the evaluation on packed positions from datagen.
+int ChessEngine::run_tune(int argc, char* argv[]) {
+    Tuner::Options options;
+    std::vector<std::string> inputs;
+    
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        
+        if (arg == "--threads" && has_value) {
+            read_option("tune", arg, argv[++i], options.threads);
+        } else if (arg == "--epochs" && has_value) {
+            read_option("tune", arg, argv[++i], options.epochs);
+        } else if (arg == "--lr" && has_value) {
+            read_option("tune", arg, argv[++i], options.learning_rate);
+        } else if (arg == "--lambda" && has_value) {
+            read_option("tune", arg, argv[++i], options.lambda);
+        } else if (arg == "--positions" && has_value) {
+            read_option("tune", arg, argv[++i], options.max_positions);
+        } else if (arg == "--output" && has_value) {
+            options.output = argv[++i];
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    
+    if (inputs.empty()) {
+        std::cerr << "usage: tune [options] <data.bin>..." << std::endl;
+        return 1;
+    }
+    
+    Tuner tuner(options);
+    for (const std::string& input : inputs) {
+        auto start = std::chrono::steady_clock::now();
+        size_t loaded = tuner.load(input);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << input << ": " << loaded << " positions in " << seconds << " s" << std::endl;
+    }
+    
+    tuner.run(std::cerr);
+    return 0;
+}
+
+// match --engine <path> --engine <path> [--option1 name=value] [--option2 name=value]
+//       [--openings file.epd] [--concurrency N] [--games N] [--tc base+inc]
+//       [--sprt elo0 elo1] [--alpha A] [--beta B] [--no-pin]
+// Time controls are in seconds, e.g. 10+0.1.
+int ChessEngine::run_match(int argc, char* argv[]) {
+    MatchRunner::Options options;
+    int engine_count = 0;
+    
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        
+        if (arg == "--engine" && has_value && engine_count < 2) {
+            options.engines[engine_count++] = argv[++i];
+        } else if ((arg == "--option1" || arg == "--option2") && has_value) {
+            options.engine_options[arg == "--option2"].push_back(argv[++i]);
+        } else if (arg == "--openings" && has_value) {
+            options.openings_path = argv[++i];
+        } else if (arg == "--concurrency" && has_value) {
+            read_option("match", arg, argv[++i], options.concurrency);
+        } else if (arg == "--games" && has_value) {
+            read_option("match", arg, argv[++i], options.games);
+        } else if (arg == "--tc" && has_value) {
+            std::string tc = argv[++i];
+            size_t plus = tc.find('+');
+            double base = 0;
+            double increment = 0;
+            if (UCIInterface::parse_number(tc.substr(0, plus), base)
+                && (plus == std::string::npos || UCIInterface::parse_number(tc.substr(plus + 1), increment))) {
+                options.base_ms = int(base * 1000);
+                options.increment_ms = int(increment * 1000);
+            } else {
+                std::cerr << "match: ignoring --tc " << tc << std::endl;
+            }
+        } else if (arg == "--sprt" && i + 2 < argc) {
+            read_option("match", "--sprt", argv[++i], options.elo0);
+            read_option("match", "--sprt", argv[++i], options.elo1);
+        } else if (arg == "--alpha" && has_value) {
+            read_option("match", arg, argv[++i], options.alpha);
+        } else if (arg == "--beta" && has_value) {
+            read_option("match", arg, argv[++i], options.beta);
+        } else if (arg == "--no-pin") {
+            options.pin_cpus = false;
+        }
+    }
+    
+    if (engine_count < 2) {
+        std::cerr << "usage: match --engine <path> --engine <path> [options]" << std::endl;
+        return 1;
+    }
+    
+    MatchRunner runner(options);
+    if (!runner.run(std::cout)) {
+        std::cerr << "match: cannot read openings from " << options.openings_path << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// server --socket <path> [--threads N] [--hash MB] [--tt shared|tagged|private]
+//        [--session-hash MB] [--max-sessions N] [--time-slice MS]
+// Serves UCI sessions over a Unix domain socket until interrupted.
+int ChessEngine::run_server(int argc, char* argv[]) {
+    AnalysisServer::Options options;
+    
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        
+        if (arg == "--socket" && has_value) {
+            options.socket_path = argv[++i];
+        } else if (arg == "--threads" && has_value) {
+            read_option("server", arg, argv[++i], options.threads);
+        } else if (arg == "--hash" && has_value) {
+            read_option("server", arg, argv[++i], options.hash_mb);
+        } else if (arg == "--tt" && has_value) {
+            std::string mode = argv[++i];
+            options.table_mode = mode == "shared"  ? AnalysisServer::TT_SHARED
+                               : mode == "private" ? AnalysisServer::TT_PRIVATE
+                                                   : AnalysisServer::TT_TAGGED;
+        } else if (arg == "--session-hash" && has_value) {
+            read_option("server", arg, argv[++i], options.session_hash_mb);
+        } else if (arg == "--max-sessions" && has_value) {
+            read_option("server", arg, argv[++i], options.max_sessions);
+        } else if (arg == "--time-slice" && has_value) {
+            read_option("server", arg, argv[++i], options.time_slice_ms);
+        }
+    }
+    
+    if (options.socket_path.empty()) {
+        std::cerr << "usage: server --socket <path> [options]" << std::endl;
+        return 1;
+    }
+    
+    AnalysisServer server(options);
+    return server.run() ? 0 : 1;
+}
+
+// cluster --ranks N [--listen [HOST:]PORT] [--local] [--hash MB]
+// cluster --connect HOST:PORT [--hash MB]
+// The first form is rank 0 and speaks UCI on stdin/stdout once N - 1
+// workers have connected; --local starts them as child processes.
+int ChessEngine::run_cluster(int argc, char* argv[]) {
+    ClusterCoordinator::Options coordinator;
+    ClusterWorker::Options worker;
+    
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        
+        if (arg == "--ranks" && has_value) {
+            read_option("cluster", arg, argv[++i], coordinator.ranks);
+        } else if (arg == "--listen" && has_value) {
+            coordinator.address = argv[++i];
+        } else if (arg == "--local") {
+            coordinator.spawn_local = true;
+        } else if (arg == "--connect" && has_value) {
+            worker.address = argv[++i];
+        } else if (arg == "--hash" && has_value) {
+            read_option("cluster", arg, argv[++i], coordinator.hash_mb);
+            worker.hash_mb = coordinator.hash_mb;
+        }
+    }
+    
+    if (!worker.address.empty()) {
+        ClusterWorker rank(worker);
+        return rank.run() ? 0 : 1;
+    }
+    
+    ClusterCoordinator rank(coordinator);
+    return rank.run() ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    return ChessEngine::run(argc, argv);
+}
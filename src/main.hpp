@@ -3,6 +3,18 @@ class ChessEngine {
 public:
     static void initialize();
     static void run_uci();
+    static int run(int argc, char* argv[]);
+    static int run_batch(int argc, char* argv[]);
+    static int run_index(int argc, char* argv[]);
+    static int run_bench(int argc, char* argv[]);
+    static int run_microbench(int argc, char* argv[]);
+    static int run_perft(int argc, char* argv[]);
+    static int run_trace(int argc, char* argv[]);
+    static int run_datagen(int argc, char* argv[]);
+    static int run_tune(int argc, char* argv[]);
+    static int run_match(int argc, char* argv[]);
+    static int run_server(int argc, char* argv[]);
+    static int run_cluster(int argc, char* argv[]);
     
 private:
     static bool initialized;
@@ -0,0 +1,415 @@
+#include "match.hpp"
+#include "movegen.hpp"
+#include "move_utils.hpp"
+#include "bitboard_utils.hpp"
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <fstream>
+#include <thread>
+#include <poll.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+    int now_ms() {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return int(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+    }
+    
+    std::vector<Move> legal_moves(const Position& pos) {
+        std::vector<Move> moves = pos.in_check() ? MoveGenerator::generate_evasions(pos)
+                                                 : MoveGenerator::generate_moves(pos);
+        moves.erase(std::remove_if(moves.begin(), moves.end(), [&](Move m) { return !pos.is_legal(m); }),
+                    moves.end());
+        return moves;
+    }
+    
+    // Bare kings, or a single minor piece against a bare king
+    bool insufficient_material(const Position& pos) {
+        if (pos.pieces(PAWN) | pos.pieces(ROOK) | pos.pieces(QUEEN)) return false;
+        return BitboardUtils::popcount(pos.pieces(KNIGHT) | pos.pieces(BISHOP)) <= 1;
+    }
+}
+
+EngineProcess::~EngineProcess() {
+    stop();
+}
+
+bool EngineProcess::start(const std::string& path, const std::vector<std::string>& options, int cpu) {
+    stop();
+    
+    int to_child[2];
+    int from_child[2];
+    if (pipe(to_child) != 0) return false;
+    if (pipe(from_child) != 0) {
+        close(to_child[0]);
+        close(to_child[1]);
+        return false;
+    }
+    
+    pid = fork();
+    if (pid == 0) {
+        if (cpu >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            sched_setaffinity(0, sizeof(set), &set);
+        }
+        
+        dup2(to_child[0], STDIN_FILENO);
+        dup2(from_child[1], STDOUT_FILENO);
+        close(to_child[0]);
+        close(to_child[1]);
+        close(from_child[0]);
+        close(from_child[1]);
+        
+        execl(path.c_str(), path.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    
+    close(to_child[0]);
+    close(from_child[1]);
+    to_engine = to_child[1];
+    from_engine = from_child[0];
+    
+    if (pid < 0) {
+        stop();
+        return false;
+    }
+    
+    std::string line;
+    engine_name = path;
+    
+    send("uci");
+    while (true) {
+        if (!read_line(10000, line)) {
+            stop();
+            return false;
+        }
+        if (line.rfind("id name ", 0) == 0) engine_name = line.substr(8);
+        if (line.rfind("uciok", 0) == 0) break;
+    }
+    
+    for (const std::string& option : options) {
+        size_t eq = option.find('=');
+        if (eq == std::string::npos) continue;
+        send("setoption name " + option.substr(0, eq) + " value " + option.substr(eq + 1));
+    }
+    
+    send("isready");
+    if (!wait_for("readyok", 10000, line)) {
+        stop();
+        return false;
+    }
+    
+    return true;
+}
+
+void EngineProcess::stop() {
+    if (pid > 0) {
+        send("quit");
+        
+        // Give the engine a moment to exit on its own
+        int status;
+        int deadline = now_ms() + 1000;
+        while (waitpid(pid, &status, WNOHANG) == 0) {
+            if (now_ms() >= deadline) {
+                kill(pid, SIGKILL);
+                waitpid(pid, &status, 0);
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+    
+    if (to_engine >= 0) close(to_engine);
+    if (from_engine >= 0) close(from_engine);
+    
+    pid = -1;
+    to_engine = from_engine = -1;
+    buffer.clear();
+}
+
+bool EngineProcess::send(const std::string& line) {
+    if (to_engine < 0) return false;
+    
+    std::string data = line + "\n";
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(to_engine, data.data() + written, data.size() - written);
+        if (n <= 0) return false;
+        written += n;
+    }
+    return true;
+}
+
+bool EngineProcess::wait_for(const std::string& prefix, int timeout_ms, std::string& line) {
+    int deadline = now_ms() + timeout_ms;
+    
+    while (true) {
+        if (!read_line(std::max(0, deadline - now_ms()), line)) return false;
+        if (line.rfind(prefix, 0) == 0) return true;
+    }
+}
+
+bool EngineProcess::read_line(int timeout_ms, std::string& line) {
+    int deadline = now_ms() + timeout_ms;
+    
+    while (true) {
+        size_t newline = buffer.find('\n');
+        if (newline != std::string::npos) {
+            line = buffer.substr(0, newline);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            buffer.erase(0, newline + 1);
+            return true;
+        }
+        
+        if (from_engine < 0) return false;
+        
+        pollfd fd = {from_engine, POLLIN, 0};
+        int remaining = deadline - now_ms();
+        if (remaining <= 0 || poll(&fd, 1, remaining) <= 0) return false;
+        
+        char chunk[4096];
+        ssize_t n = read(from_engine, chunk, sizeof(chunk));
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+    }
+}
+
+MatchRunner::MatchRunner(const Options& options) : options(options), next_game(0), finished(false) {
+    this->options.concurrency = std::max(1, options.concurrency);
+}
+
+bool MatchRunner::load_openings() {
+    openings.clear();
+    
+    if (options.openings_path.empty()) {
+        openings.push_back(Position().fen());
+        return true;
+    }
+    
+    std::ifstream in(options.openings_path);
+    if (!in) return false;
+    
+    std::string line;
+    Position pos;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        if (pos.set_fen(line)) openings.push_back(pos.fen());
+    }
+    
+    return !openings.empty();
+}
+
+bool MatchRunner::run(std::ostream& out) {
+    if (!load_openings()) return false;
+    
+    // A dying engine must not take the runner down with it
+    std::signal(SIGPIPE, SIG_IGN);
+    
+    next_game = 0;
+    finished = false;
+    wins = draws = losses = 0;
+    
+    int start = now_ms();
+    
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.concurrency; i++) {
+        workers.emplace_back(&MatchRunner::worker, this, i, std::ref(out));
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    
+    int games = wins + draws + losses;
+    double hours = std::max(1, now_ms() - start) / 3600000.0;
+    double score = games ? (wins + 0.5 * draws) / games : 0.5;
+    double elo = score > 0 && score < 1 ? -400 * std::log10(1 / score - 1) : 0;
+    
+    out << "Finished: " << wins << " - " << losses << " - " << draws
+        << " (W-L-D), Elo " << elo << ", " << int(games / hours) << " games/hour" << std::endl;
+    return true;
+}
+
+void MatchRunner::worker(int id, std::ostream& out) {
+    int cpus = int(std::max(1u, std::thread::hardware_concurrency()));
+    int cpu = options.pin_cpus ? id % cpus : -1;
+    
+    // Index 0 is the engine under test, 1 the baseline
+    EngineProcess players[2];
+    for (int i = 0; i < 2; i++) {
+        if (!players[i].start(options.engines[i], options.engine_options[i], cpu)) {
+            std::lock_guard<std::mutex> lock(result_mutex);
+            out << "cannot start " << options.engines[i] << std::endl;
+            finished = true;
+            return;
+        }
+    }
+    
+    while (!finished) {
+        int game = next_game.fetch_add(1);
+        if (game >= options.games) break;
+        
+        // Each opening is played twice with colours reversed
+        const std::string& opening = openings[(game / 2) % openings.size()];
+        bool first_is_white = game % 2 == 0;
+        
+        EngineProcess* engines[COLOR_NB] = {
+            first_is_white ? &players[0] : &players[1],
+            first_is_white ? &players[1] : &players[0]
+        };
+        
+        std::string reason;
+        GameResult result = play_game(engines, opening, first_is_white, reason);
+        if (record_result(result, game, reason, out)) finished = true;
+        
+        // An engine that lost on time may still answer later; start afresh
+        if (reason.find("on time") != std::string::npos || reason == "disconnect") {
+            for (int i = 0; i < 2; i++) {
+                if (!players[i].start(options.engines[i], options.engine_options[i], cpu)) {
+                    finished = true;
+                    return;
+                }
+            }
+        }
+    }
+}
+
+MatchRunner::GameResult MatchRunner::play_game(EngineProcess* engines[COLOR_NB], const std::string& opening,
+                                               bool first_is_white, std::string& reason) {
+    auto win_for = [&](Color c) { return (c == WHITE) == first_is_white ? FIRST_WINS : SECOND_WINS; };
+    
+    Position pos;
+    pos.set_fen(opening);
+    
+    std::string line;
+    for (int c = 0; c < COLOR_NB; c++) {
+        engines[c]->send("ucinewgame");
+        engines[c]->send("isready");
+        if (!engines[c]->wait_for("readyok", 10000, line)) {
+            reason = "disconnect";
+            return win_for(Color(c ^ 1));
+        }
+    }
+    
+    std::string moves;
+    std::vector<uint64_t> keys(1, pos.key());
+    int clock[COLOR_NB] = {options.base_ms, options.base_ms};
+    
+    for (int ply = 0; ply < options.max_plies; ply++) {
+        Color us = pos.side_to_move();
+        std::vector<Move> legal = legal_moves(pos);
+        
+        if (legal.empty()) {
+            reason = pos.in_check() ? "checkmate" : "stalemate";
+            return pos.in_check() ? win_for(Color(us ^ 1)) : DRAW;
+        }
+        
+        if (pos.halfmove_count() >= 100) {
+            reason = "fifty moves";
+            return DRAW;
+        }
+        
+        // Threefold repetition within the reversible part of the game
+        int repetitions = 0;
+        int reversible = std::min<int>(pos.halfmove_count(), int(keys.size()) - 1);
+        for (int i = 0; i <= reversible; i++) {
+            repetitions += keys[keys.size() - 1 - i] == pos.key();
+        }
+        if (repetitions >= 3) {
+            reason = "threefold repetition";
+            return DRAW;
+        }
+        
+        if (insufficient_material(pos)) {
+            reason = "insufficient material";
+            return DRAW;
+        }
+        
+        EngineProcess* engine = engines[us];
+        engine->send("position fen " + opening + (moves.empty() ? "" : " moves" + moves));
+        engine->send("go wtime " + std::to_string(clock[WHITE]) + " btime " + std::to_string(clock[BLACK])
+                     + " winc " + std::to_string(options.increment_ms)
+                     + " binc " + std::to_string(options.increment_ms));
+        
+        int start = now_ms();
+        bool answered = engine->wait_for("bestmove", clock[us] + options.time_margin_ms, line);
+        clock[us] -= now_ms() - start;
+        
+        if (!answered || clock[us] < -options.time_margin_ms) {
+            reason = std::string(us == WHITE ? "white" : "black") + " loses on time";
+            return win_for(Color(us ^ 1));
+        }
+        clock[us] += options.increment_ms;
+        
+        std::string move_str = line.size() > 9 ? line.substr(9, line.find(' ', 9) - 9) : "";
+        Move m = MoveUtils::from_string(move_str, pos);
+        if (std::find(legal.begin(), legal.end(), m) == legal.end()) {
+            reason = std::string(us == WHITE ? "white" : "black") + " plays illegal move " + move_str;
+            return win_for(Color(us ^ 1));
+        }
+        
+        pos.do_move(m);
+        moves += " " + move_str;
+        keys.push_back(pos.key());
+    }
+    
+    reason = "move limit";
+    return DRAW;
+}
+
+// Returns true once the SPRT has accepted either hypothesis
+bool MatchRunner::record_result(GameResult result, int game, const std::string& reason, std::ostream& out) {
+    // From the first engine's point of view
+    static const char* result_names[] = {"win", "draw", "loss"};
+    
+    std::lock_guard<std::mutex> lock(result_mutex);
+    
+    if (result == FIRST_WINS) wins++;
+    else if (result == DRAW) draws++;
+    else losses++;
+    
+    out << "Game " << game + 1 << ": " << result_names[result] << " {" << reason << "}"
+        << " Score " << wins << " - " << losses << " - " << draws;
+    
+    if (options.elo0 == options.elo1) {
+        out << std::endl;
+        return false;
+    }
+    
+    double llr = sprt_llr();
+    double lower = std::log(options.beta / (1 - options.alpha));
+    double upper = std::log((1 - options.beta) / options.alpha);
+    out << " LLR " << llr << " [" << lower << ", " << upper << "]" << std::endl;
+    
+    if (llr >= upper) {
+        out << "SPRT: H1 accepted (elo >= " << options.elo1 << ")" << std::endl;
+        return true;
+    }
+    if (llr <= lower) {
+        out << "SPRT: H0 accepted (elo <= " << options.elo0 << ")" << std::endl;
+        return true;
+    }
+    return false;
+}
+
+// Log-likelihood ratio of elo1 against elo0 for the trinomial results,
+// using the normal approximation of the score distribution
+double MatchRunner::sprt_llr() const {
+    int n = wins + draws + losses;
+    if (n == 0 || wins + losses == 0) return 0.0;
+    
+    double w = double(wins) / n;
+    double d = double(draws) / n;
+    double l = double(losses) / n;
+    double score = w + d / 2;
+    double variance = w * (1 - score) * (1 - score) + d * (0.5 - score) * (0.5 - score) + l * score * score;
+    if (variance <= 0) return 0.0;
+    
+    double s0 = 1 / (1 + std::pow(10.0, -options.elo0 / 400));
+    double s1 = 1 / (1 + std::pow(10.0, -options.elo1 / 400));
+    return n * (s1 - s0) * (2 * score - s0 - s1) / (2 * variance);
+}
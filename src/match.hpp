@@ -0,0 +1,84 @@
+// ===== MATCH RUNNER =====
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <sys/types.h>
+
+// A UCI engine running as a child process, spoken to over pipes
+class EngineProcess {
+public:
+    ~EngineProcess();
+    
+    // Starts the engine pinned to the given CPU (-1 for no pinning) and
+    // completes the uci/isready handshake
+    bool start(const std::string& path, const std::vector<std::string>& options, int cpu);
+    void stop();
+    
+    bool send(const std::string& line);
+    
+    // Reads lines until one starts with prefix; false on timeout or exit
+    bool wait_for(const std::string& prefix, int timeout_ms, std::string& line);
+    
+    const std::string& name() const { return engine_name; }
+    
+private:
+    pid_t pid = -1;
+    int to_engine = -1;
+    int from_engine = -1;
+    std::string buffer;
+    std::string engine_name;
+    
+    bool read_line(int timeout_ms, std::string& line);
+};
+
+// Plays games between two UCI engines from a list of openings, several
+// games at a time, each pair of engines pinned to its own CPU. Positions
+// are adjudicated with our own Position and MoveGenerator, and the match
+// stops early once a sequential probability ratio test decides.
+class MatchRunner {
+public:
+    struct Options {
+        std::string engines[COLOR_NB];
+        std::vector<std::string> engine_options[COLOR_NB];  // name=value pairs
+        std::string openings_path;
+        int concurrency = 1;
+        int games = 1000;
+        int base_ms = 10000;
+        int increment_ms = 100;
+        int time_margin_ms = 100;
+        int max_plies = 600;
+        bool pin_cpus = true;
+        
+        // SPRT on the first engine's Elo gain; off when elo0 == elo1
+        double elo0 = 0.0;
+        double elo1 = 0.0;
+        double alpha = 0.05;
+        double beta = 0.05;
+    };
+    
+    explicit MatchRunner(const Options& options);
+    
+    // Returns false if the openings could not be read
+    bool run(std::ostream& out);
+    
+private:
+    enum GameResult { FIRST_WINS, DRAW, SECOND_WINS };
+    
+    Options options;
+    std::vector<std::string> openings;
+    std::atomic<int> next_game;
+    std::atomic<bool> finished;
+    
+    std::mutex result_mutex;
+    int wins = 0;
+    int draws = 0;
+    int losses = 0;
+    
+    void worker(int id, std::ostream& out);
+    GameResult play_game(EngineProcess* engines[COLOR_NB], const std::string& opening,
+                         bool first_is_white, std::string& reason);
+    bool record_result(GameResult result, int game, const std::string& reason, std::ostream& out);
+    
+    double sprt_llr() const;
+    bool load_openings();
+};
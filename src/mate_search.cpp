@@ -0,0 +1,317 @@
+#include "mate_search.hpp"
+#include "movegen.hpp"
+#include "move_utils.hpp"
+#include <algorithm>
+
+namespace {
+    std::vector<Move> legal_moves(Position& pos, const std::vector<Move>& moves) {
+        std::vector<Move> legal;
+        for (Move m : moves) {
+            if (pos.is_legal(m)) legal.push_back(m);
+        }
+        return legal;
+    }
+}
+
+MateSearch::MateSearch(size_t hash_mb) : stop_flag(false), nodes(0), next_limit_check(0) {
+    // Round down to a power of two so the index is a mask of the key
+    size_t entries = hash_mb * 1024 * 1024 / sizeof(Entry);
+    size_t size = 1;
+    while (size * 2 <= entries) {
+        size *= 2;
+    }
+    mask = size - 1;
+    
+    table.resize(size);
+    clear();
+}
+
+void MateSearch::clear() {
+    std::fill(table.begin(), table.end(), Entry{0, 0, 0, 0});
+}
+
+SearchEngine::SearchResult MateSearch::search(const Position& root_pos, int max_moves,
+                                              const SearchEngine::SearchInfo& info) {
+    Position pos = root_pos;
+    SearchEngine::SearchResult result;
+    
+    limits = info;
+    start_time = std::chrono::steady_clock::now();
+    nodes = 0;
+    next_limit_check = 0;
+    
+    // Only the last attacker move has to give check, so the root is
+    // expanded with every move left; it has none to try only when no move
+    // is legal, or with one move left when no move gives check
+    int limit = std::min(max_moves, MAX_PLY / 2);
+    std::vector<Child> children;
+    bool has_tries = limit > 0 && expand(pos, limit, true, children);
+    
+    // Iterative deepening on the number of moves, so that the first mate
+    // proven is a shortest one
+    int moves = 1;
+    for (; has_tries && moves <= limit; moves++) {
+        uint64_t key = entry_key(pos, moves);
+        const Entry* entry = nullptr;
+        
+        while (!stop_flag) {
+            mid(pos, moves, true, PN_INFINITE, PN_INFINITE);
+            entry = probe(key);
+            if (entry && (entry->pn == 0 || entry->dn == 0)) break;
+        }
+        
+        if (stop_flag) break;
+        result.depth = 2 * moves - 1;
+        
+        if (entry->pn == 0) {
+            result.score = SCORE_MATE - Score(entry->distance);
+            result.seldepth = int(entry->distance);
+            result.pv = mating_line(pos, moves);
+            break;
+        }
+    }
+    
+    if (!result.pv.empty()) {
+        result.best_move = result.pv[0];
+    } else {
+        // No mate proven: the try closest to a proof in the last iteration
+        if (has_tries) expand(pos, std::max(1, std::min(moves, limit)), true, children);
+        uint32_t best_pn = PN_INFINITE + 1;
+        for (const Child& child : children) {
+            const Entry* entry = probe(child.key);
+            uint32_t pn = entry ? entry->pn : child.check ? 1 : QUIET_MOVE_PN;
+            if (pn < best_pn) {
+                best_pn = pn;
+                result.best_move = child.move;
+            }
+        }
+        
+        // Still a legal move to play when there was no check to try
+        if (MoveUtils::is_null(result.best_move)) {
+            std::vector<Move> legal = legal_moves(pos, pos.in_check() ? MoveGenerator::generate_evasions(pos)
+                                                                       : MoveGenerator::generate_moves(pos));
+            if (!legal.empty()) result.best_move = legal[0];
+        }
+    }
+    
+    // A stop only ever ends the search it reached
+    stop_flag = false;
+    
+    result.nodes = nodes;
+    result.time_ms = elapsed_ms();
+    return result;
+}
+
+// The same position with a different number of attacker moves left is a
+// different problem, so the move count is part of the key
+uint64_t MateSearch::entry_key(const Position& pos, int remaining) {
+    return pos.key() ^ (uint64_t(remaining) * 0x9E3779B97F4A7C15ULL);
+}
+
+const MateSearch::Entry* MateSearch::probe(uint64_t key) const {
+    const Entry& entry = table[key & mask];
+    return entry.key == key ? &entry : nullptr;
+}
+
+void MateSearch::store(uint64_t key, uint32_t pn, uint32_t dn, uint32_t distance) {
+    table[key & mask] = Entry{key, pn, dn, distance};
+}
+
+// Lists the legal moves to try, or stores the result of a terminal node
+// and returns false. The attacker's children count one move fewer left.
+bool MateSearch::expand(Position& pos, int remaining, bool attacker, std::vector<Child>& children) {
+    uint64_t key = entry_key(pos, remaining);
+    std::vector<Move> checks;
+    std::vector<Move> others;
+    
+    children.clear();
+    
+    if (attacker) {
+        checks = legal_moves(pos, MoveGenerator::generate_checks(pos));
+        
+        // The last move has to give mate, so only checks are worth trying
+        if (remaining > 1) {
+            std::vector<Move> moves = pos.in_check() ? MoveGenerator::generate_evasions(pos)
+                                                     : MoveGenerator::generate_moves(pos);
+            for (Move m : legal_moves(pos, moves)) {
+                if (std::find(checks.begin(), checks.end(), m) == checks.end()) others.push_back(m);
+            }
+        }
+        
+        if (checks.empty() && others.empty()) {
+            store(key, PN_INFINITE, 0, 0);
+            return false;
+        }
+    } else {
+        std::vector<Move> moves = pos.in_check() ? MoveGenerator::generate_evasions(pos)
+                                                 : MoveGenerator::generate_moves(pos);
+        others = legal_moves(pos, moves);
+        
+        if (others.empty()) {
+            // Checkmate proves the node, stalemate disproves it
+            if (pos.in_check()) {
+                store(key, 0, PN_INFINITE, 0);
+            } else {
+                store(key, PN_INFINITE, 0, 0);
+            }
+            return false;
+        }
+        
+        if (remaining == 0) {
+            store(key, PN_INFINITE, 0, 0);
+            return false;
+        }
+    }
+    
+    int child_remaining = attacker ? remaining - 1 : remaining;
+    
+    for (const std::vector<Move>* list : {&checks, &others}) {
+        for (Move m : *list) {
+            pos.do_move(m);
+            children.push_back({m, entry_key(pos, child_remaining), list == &checks});
+            pos.undo_move(m);
+        }
+    }
+    
+    return true;
+}
+
+// Multiple iterative deepening: searches below this node until its proof
+// or disproof number reaches the given threshold
+void MateSearch::mid(Position& pos, int remaining, bool attacker, uint32_t thpn, uint32_t thdn) {
+    nodes++;
+    check_limits();
+    if (stop_flag) return;
+    
+    std::vector<Child> children;
+    if (!expand(pos, remaining, attacker, children)) return;
+    
+    uint64_t key = entry_key(pos, remaining);
+    int child_remaining = attacker ? remaining - 1 : remaining;
+    
+    while (!stop_flag) {
+        // The attacker needs one proven child and the defender all of them.
+        // "min" is the number chosen by one child, "sum" the one needing all.
+        uint32_t min_value = PN_INFINITE;
+        uint32_t second_value = PN_INFINITE;
+        uint32_t sum_value = 0;
+        uint32_t distance = attacker ? PN_INFINITE : 0;
+        uint32_t best_pn = 0;
+        uint32_t best_dn = 0;
+        size_t best = 0;
+        
+        for (size_t i = 0; i < children.size(); i++) {
+            const Entry* entry = probe(children[i].key);
+            uint32_t pn = entry ? entry->pn : attacker && !children[i].check ? QUIET_MOVE_PN : 1;
+            uint32_t dn = entry ? entry->dn : 1;
+            
+            uint32_t chosen = attacker ? pn : dn;
+            uint32_t needed = attacker ? dn : pn;
+            
+            if (chosen < min_value) {
+                second_value = min_value;
+                min_value = chosen;
+                best = i;
+                best_pn = pn;
+                best_dn = dn;
+            } else if (chosen < second_value) {
+                second_value = chosen;
+            }
+            sum_value = std::min(PN_INFINITE, sum_value + needed);
+            
+            if (entry && entry->pn == 0) {
+                distance = attacker ? std::min(distance, entry->distance + 1)
+                                    : std::max(distance, entry->distance + 1);
+            }
+        }
+        
+        uint32_t pn = attacker ? min_value : sum_value;
+        uint32_t dn = attacker ? sum_value : min_value;
+        
+        if (pn >= thpn || dn >= thdn) {
+            store(key, pn, dn, pn == 0 ? distance : 0);
+            return;
+        }
+        
+        uint32_t child_thpn;
+        uint32_t child_thdn;
+        if (attacker) {
+            child_thpn = std::min(thpn, second_value + 1);
+            child_thdn = thdn - dn + best_dn;
+        } else {
+            child_thpn = thpn - pn + best_pn;
+            child_thdn = std::min(thdn, second_value + 1);
+        }
+        
+        pos.do_move(children[best].move);
+        mid(pos, child_remaining, !attacker, child_thpn, child_thdn);
+        pos.undo_move(children[best].move);
+    }
+}
+
+// Follows a proven tree: the attacker takes its quickest mate and the
+// defender its longest resistance. Entries lost to table collisions are
+// proven again.
+std::vector<Move> MateSearch::mating_line(Position& pos, int remaining) {
+    std::vector<Move> line;
+    bool attacker = true;
+    std::vector<Child> children;
+    
+    while (!stop_flag && expand(pos, remaining, attacker, children)) {
+        int child_remaining = attacker ? remaining - 1 : remaining;
+        Move best_move = MoveUtils::null_move();
+        uint32_t best_distance = 0;
+        
+        for (const Child& child : children) {
+            const Entry* entry = probe(child.key);
+            if (!entry && !attacker) {
+                pos.do_move(child.move);
+                mid(pos, child_remaining, !attacker, PN_INFINITE, PN_INFINITE);
+                pos.undo_move(child.move);
+                entry = probe(child.key);
+            }
+            if (!entry || entry->pn != 0) continue;
+            
+            if (MoveUtils::is_null(best_move)
+                || (attacker ? entry->distance < best_distance : entry->distance > best_distance)) {
+                best_move = child.move;
+                best_distance = entry->distance;
+            }
+        }
+        
+        if (MoveUtils::is_null(best_move)) {
+            // The attacker's proven move was overwritten: prove one again
+            mid(pos, remaining, attacker, PN_INFINITE, PN_INFINITE);
+            const Entry* entry = probe(entry_key(pos, remaining));
+            if (stop_flag || !entry || entry->pn != 0 || !attacker) break;
+            continue;
+        }
+        
+        pos.do_move(best_move);
+        line.push_back(best_move);
+        remaining = child_remaining;
+        attacker = !attacker;
+    }
+    
+    return line;
+}
+
+void MateSearch::check_limits() {
+    if (!limits.infinite && nodes >= limits.max_nodes) {
+        stop_flag = true;
+        return;
+    }
+    
+    // Reading the clock is comparatively expensive
+    if (nodes < next_limit_check) return;
+    next_limit_check = nodes + 1024;
+    
+    if (!limits.infinite && elapsed_ms() >= limits.max_time_ms) {
+        stop_flag = true;
+    }
+}
+
+int MateSearch::elapsed_ms() const {
+    auto elapsed = std::chrono::steady_clock::now() - start_time;
+    return int(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+}
@@ -0,0 +1,65 @@
+// ===== MATE SEARCH =====
+#include <atomic>
+#include <chrono>
+
+// Depth-first proof-number search (df-pn) for "is there a forced mate in N
+// moves?". The side to move is the attacker: its last move must give mate,
+// so only checks are tried there, while earlier moves try checks first and
+// quiet moves after. Proof and disproof numbers live in a table keyed by the
+// position and the number of attacker moves left. Draws by repetition or
+// the fifty-move rule are not detected.
+class MateSearch {
+public:
+    explicit MateSearch(size_t hash_mb = 16);
+    
+    // Shortest mate within max_moves moves, found within the node and time
+    // limits of info. A mate is reported as a mate score with the full line
+    // in pv; otherwise the score is 0 and best_move the most promising try.
+    SearchEngine::SearchResult search(const Position& pos, int max_moves, const SearchEngine::SearchInfo& info);
+    
+    // As SearchEngine::stop_search() and clear_stop(): a stop sent before
+    // the search started still ends it
+    void stop() { stop_flag = true; }
+    void clear_stop() { stop_flag = false; }
+    void clear();
+    
+private:
+    static constexpr uint32_t PN_INFINITE = 1u << 30;
+    
+    // Initial proof number of a quiet attacker move, so that checks are
+    // explored before it
+    static constexpr uint32_t QUIET_MOVE_PN = 4;
+    
+    struct Entry {
+        uint64_t key;
+        uint32_t pn;
+        uint32_t dn;
+        uint32_t distance;   // plies to mate once proven
+    };
+    
+    struct Child {
+        Move move;
+        uint64_t key;
+        bool check;
+    };
+    
+    std::vector<Entry> table;
+    size_t mask;
+    
+    std::atomic<bool> stop_flag;
+    SearchEngine::SearchInfo limits;
+    std::chrono::steady_clock::time_point start_time;
+    int nodes;
+    int next_limit_check;
+    
+    static uint64_t entry_key(const Position& pos, int remaining);
+    
+    const Entry* probe(uint64_t key) const;
+    void store(uint64_t key, uint32_t pn, uint32_t dn, uint32_t distance);
+    
+    bool expand(Position& pos, int remaining, bool attacker, std::vector<Child>& children);
+    void mid(Position& pos, int remaining, bool attacker, uint32_t thpn, uint32_t thdn);
+    std::vector<Move> mating_line(Position& pos, int remaining);
+    void check_limits();
+    int elapsed_ms() const;
+};
@@ -0,0 +1,91 @@
+#include "metrics.hpp"
+#include <chrono>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+MetricsPublisher::~MetricsPublisher() {
+    close();
+}
+
+// Names follow shm_open rules: one leading slash, no others
+bool MetricsPublisher::open(const std::string& name) {
+    close();
+    
+    std::string shm_name = name.empty() || name[0] != '/' ? "/" + name : name;
+    
+    int fd = shm_open(shm_name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) return false;
+    
+    if (ftruncate(fd, sizeof(MetricsPage)) != 0) {
+        ::close(fd);
+        shm_unlink(shm_name.c_str());
+        return false;
+    }
+    
+    void* memory = mmap(nullptr, sizeof(MetricsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        shm_unlink(shm_name.c_str());
+        return false;
+    }
+    
+    // The segment starts zeroed; magic is written last so readers never
+    // accept a half-initialised page
+    page = new (memory) MetricsPage();
+    page->version = METRICS_VERSION;
+    page->size = sizeof(MetricsPage);
+    page->max_threads = METRICS_MAX_THREADS;
+    std::atomic_thread_fence(std::memory_order_release);
+    page->magic = METRICS_MAGIC;
+    
+    segment_name = shm_name;
+    return true;
+}
+
+void MetricsPublisher::close() {
+    if (!page) return;
+    
+    munmap(page, sizeof(MetricsPage));
+    shm_unlink(segment_name.c_str());
+    page = nullptr;
+    segment_name.clear();
+    thread_count = 0;
+}
+
+void MetricsPublisher::publish(int depth, int seldepth, int hashfull, bool searching, int elapsed_ms) {
+    if (!page) return;
+    
+    int threads = thread_count.load(std::memory_order_relaxed);
+    uint64_t nodes = 0;
+    for (int i = 0; i < threads; i++) {
+        nodes += page->thread_slots[i].nodes.load(std::memory_order_relaxed);
+    }
+    
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    uint64_t time_us = std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+    
+    uint64_t sequence = page->sequence.load(std::memory_order_relaxed);
+    page->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    
+    page->update_time_us.store(time_us, std::memory_order_relaxed);
+    page->nodes.store(nodes, std::memory_order_relaxed);
+    page->nps.store(elapsed_ms > 0 ? nodes * 1000 / elapsed_ms : 0, std::memory_order_relaxed);
+    page->depth.store(depth, std::memory_order_relaxed);
+    page->seldepth.store(seldepth, std::memory_order_relaxed);
+    page->hashfull.store(hashfull, std::memory_order_relaxed);
+    page->searching.store(searching, std::memory_order_relaxed);
+    page->threads.store(threads, std::memory_order_relaxed);
+    
+    page->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void MetricsPublisher::publish_thread(int index, uint64_t nodes) {
+    if (!page || index < 0 || index >= METRICS_MAX_THREADS) return;
+    page->thread_slots[index].nodes.store(nodes, std::memory_order_relaxed);
+    
+    int threads = thread_count.load(std::memory_order_relaxed);
+    while (threads <= index && !thread_count.compare_exchange_weak(threads, index + 1)) {}
+}
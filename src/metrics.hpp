@@ -0,0 +1,103 @@
+// ===== LIVE METRICS =====
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Layout of the shared-memory metrics page. This header stands alone so
+// that monitoring tools can include it without the rest of the engine;
+// any change to MetricsPage must bump METRICS_VERSION.
+constexpr uint32_t METRICS_MAGIC = 0x4D58454E; // "NEXM"
+constexpr uint32_t METRICS_VERSION = 1;
+constexpr int METRICS_MAX_THREADS = 64;
+
+// Plain copy of the page as seen by a reader
+struct MetricsSnapshot {
+    uint64_t update_time_us = 0;
+    uint64_t nodes = 0;
+    uint64_t nps = 0;
+    uint32_t depth = 0;
+    uint32_t seldepth = 0;
+    uint32_t hashfull = 0;
+    uint32_t searching = 0;
+    uint32_t threads = 0;
+    uint64_t thread_nodes[METRICS_MAX_THREADS] = {};
+};
+
+struct MetricsPage {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t max_threads;
+    
+    // Seqlock over the fields below: odd while the writer is updating them
+    alignas(64) std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> update_time_us;
+    std::atomic<uint64_t> nodes;
+    std::atomic<uint64_t> nps;
+    std::atomic<uint32_t> depth;
+    std::atomic<uint32_t> seldepth;
+    std::atomic<uint32_t> hashfull; // permille
+    std::atomic<uint32_t> searching;
+    std::atomic<uint32_t> threads;
+    
+    // Outside the seqlock: each slot has a single writing thread and its own cache line
+    struct alignas(64) ThreadSlot {
+        std::atomic<uint64_t> nodes;
+    };
+    ThreadSlot thread_slots[METRICS_MAX_THREADS];
+    
+    // Retries while a write is in progress; false if the page is not ours
+    bool read(MetricsSnapshot& out) const {
+        if (magic != METRICS_MAGIC || version != METRICS_VERSION) return false;
+        
+        uint64_t before;
+        uint64_t after;
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            if (before & 1) continue;
+            
+            out.update_time_us = update_time_us.load(std::memory_order_relaxed);
+            out.nodes = nodes.load(std::memory_order_relaxed);
+            out.nps = nps.load(std::memory_order_relaxed);
+            out.depth = depth.load(std::memory_order_relaxed);
+            out.seldepth = seldepth.load(std::memory_order_relaxed);
+            out.hashfull = hashfull.load(std::memory_order_relaxed);
+            out.searching = searching.load(std::memory_order_relaxed);
+            out.threads = threads.load(std::memory_order_relaxed);
+            
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        
+        for (int i = 0; i < METRICS_MAX_THREADS; i++) {
+            out.thread_nodes[i] = thread_slots[i].nodes.load(std::memory_order_relaxed);
+        }
+        return true;
+    }
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "metrics need lock-free 64-bit atomics");
+
+// Owns a named POSIX shared-memory segment holding one MetricsPage.
+// Every searching thread reports its nodes into its own slot; one thread
+// (index 0) publishes the seqlocked totals derived from them.
+class MetricsPublisher {
+public:
+    MetricsPublisher() = default;
+    ~MetricsPublisher();
+    
+    MetricsPublisher(const MetricsPublisher&) = delete;
+    MetricsPublisher& operator=(const MetricsPublisher&) = delete;
+    
+    bool open(const std::string& name);
+    void close();
+    bool is_open() const { return page != nullptr; }
+    
+    void publish(int depth, int seldepth, int hashfull, bool searching, int elapsed_ms);
+    void publish_thread(int index, uint64_t nodes);
+    
+private:
+    MetricsPage* page = nullptr;
+    std::string segment_name;
+    std::atomic<int> thread_count{0};
+};
@@ -0,0 +1,289 @@
+#include "microbench.hpp"
+#include "bitboard_utils.hpp"
+#include "move_utils.hpp"
+#include "movegen.hpp"
+#include "eval.hpp"
+#include "tt.hpp"
+#include "uci.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+
+namespace {
+    constexpr int INPUT_COUNT = 1 << 14;
+    constexpr int GAME_COUNT = 64;
+    constexpr int GAME_PLIES = 80;
+    constexpr int REPLAY_PLIES = 300;
+    
+    // A random legal game from the start position, shorter than plies if
+    // it runs into mate or stalemate
+    std::vector<Move> record_game(std::mt19937_64& rng, int plies) {
+        Position pos;
+        std::vector<Move> game;
+        
+        while (int(game.size()) < plies) {
+            std::vector<Move> legal;
+            for (Move m : MoveGenerator::generate_moves(pos)) {
+                if (pos.is_legal(m)) legal.push_back(m);
+            }
+            if (legal.empty()) break;
+            
+            Move m = legal[rng() % legal.size()];
+            pos.do_move(m);
+            game.push_back(m);
+        }
+        
+        return game;
+    }
+    
+    std::vector<std::vector<Move>> record_games(std::mt19937_64& rng) {
+        std::vector<std::vector<Move>> games;
+        for (int g = 0; g < GAME_COUNT; g++) games.push_back(record_game(rng, GAME_PLIES));
+        return games;
+    }
+    
+    // What a GUI sends over a game: the whole move list again before every
+    // move. With "ucinewgame" in between every command is a full rebuild.
+    std::string replay_script(const std::vector<Move>& game, bool rebuild) {
+        std::string script = "ucinewgame\n";
+        std::string moves;
+        
+        for (Move m : game) {
+            moves += ' ' + MoveUtils::to_string(m);
+            if (rebuild) script += "ucinewgame\n";
+            script += "position startpos moves" + moves + "\n";
+        }
+        
+        return script;
+    }
+    
+    // Every position reached in the recorded games, as FEN
+    std::vector<std::string> collect_fens(const std::vector<std::vector<Move>>& games) {
+        std::vector<std::string> fens;
+        
+        for (const std::vector<Move>& game : games) {
+            Position pos;
+            for (Move m : game) {
+                pos.do_move(m);
+                fens.push_back(pos.fen());
+            }
+        }
+        
+        return fens;
+    }
+}
+
+MicroBenchmark::Options MicroBenchmark::parse_options(const std::vector<std::string>& args) {
+    Options options;
+    
+    // Reads the value after args[i] and steps over it; one that is not a
+    // number is reported and skipped
+    auto read_value = [&](size_t& i, auto& value) {
+        const std::string& option = args[i++];
+        if (!UCIInterface::parse_number(args[i], value)) {
+            std::cerr << "microbench: ignoring " << option << " " << args[i] << std::endl;
+        }
+    };
+    
+    for (size_t i = 0; i < args.size(); i++) {
+        bool has_value = i + 1 < args.size();
+        
+        if (args[i] == "--repetitions" && has_value) {
+            read_value(i, options.repetitions);
+            options.repetitions = std::max(1, options.repetitions);
+        } else if (args[i] == "--seed" && has_value) {
+            read_value(i, options.seed);
+        } else {
+            options.filter = args[i];
+        }
+    }
+    
+    return options;
+}
+
+void MicroBenchmark::run(const Options& options, std::ostream& out) {
+    std::mt19937_64 rng(options.seed);
+    
+    struct SliderInput {
+        Square sq;
+        Bitboard occupied;
+    };
+    
+    std::vector<SliderInput> sliders(INPUT_COUNT);
+    for (SliderInput& input : sliders) {
+        input.sq = Square(rng() % SQUARE_NB);
+        input.occupied = rng() & rng();
+    }
+    
+    // Densities from a single bit to nearly full boards
+    std::vector<Bitboard> bitboards(INPUT_COUNT);
+    for (Bitboard& b : bitboards) {
+        b = rng();
+        for (int i = rng() % 4; i > 0; i--) b &= rng();
+    }
+    
+    std::vector<std::vector<Move>> games = record_games(rng);
+    std::vector<std::string> fens = collect_fens(games);
+    
+    std::vector<Position> positions;
+    for (const std::string& fen : fens) positions.emplace_back(fen);
+    
+    uint64_t game_plies = 0;
+    for (const std::vector<Move>& game : games) game_plies += game.size();
+    
+    std::vector<Case> cases;
+    
+    cases.push_back({"rook_attacks", uint64_t(INPUT_COUNT), [&] {
+        uint64_t sum = 0;
+        for (const SliderInput& in : sliders) sum ^= BitboardUtils::get_rook_attacks(in.sq, in.occupied);
+        return sum;
+    }});
+    
+    cases.push_back({"bishop_attacks", uint64_t(INPUT_COUNT), [&] {
+        uint64_t sum = 0;
+        for (const SliderInput& in : sliders) sum ^= BitboardUtils::get_bishop_attacks(in.sq, in.occupied);
+        return sum;
+    }});
+    
+    cases.push_back({"queen_attacks", uint64_t(INPUT_COUNT), [&] {
+        uint64_t sum = 0;
+        for (const SliderInput& in : sliders) sum ^= BitboardUtils::get_queen_attacks(in.sq, in.occupied);
+        return sum;
+    }});
+    
+    cases.push_back({"popcount", uint64_t(INPUT_COUNT), [&] {
+        uint64_t sum = 0;
+        for (Bitboard b : bitboards) sum += BitboardUtils::popcount(b);
+        return sum;
+    }});
+    
+    // Counted per bitboard, each popped down to zero
+    cases.push_back({"pop_lsb_loop", uint64_t(INPUT_COUNT), [&] {
+        uint64_t sum = 0;
+        for (Bitboard b : bitboards) {
+            while (b) sum += BitboardUtils::pop_lsb(b);
+        }
+        return sum;
+    }});
+    
+    // One op is a do_move plus its undo_move
+    cases.push_back({"do_undo_move", game_plies, [&] {
+        uint64_t sum = 0;
+        Position pos;
+        for (const std::vector<Move>& game : games) {
+            for (Move m : game) pos.do_move(m);
+            sum ^= pos.key();
+            for (auto it = game.rbegin(); it != game.rend(); ++it) pos.undo_move(*it);
+        }
+        return sum;
+    }});
+    
+    cases.push_back({"set_fen", uint64_t(fens.size()), [&] {
+        uint64_t sum = 0;
+        Position pos;
+        for (const std::string& fen : fens) {
+            pos.set_fen(fen);
+            sum ^= pos.key();
+        }
+        return sum;
+    }});
+    
+    cases.push_back({"fen", uint64_t(positions.size()), [&] {
+        uint64_t sum = 0;
+        for (const Position& pos : positions) sum += pos.fen().size();
+        return sum;
+    }});
+    
+    cases.push_back({"generate_moves", uint64_t(positions.size()), [&] {
+        uint64_t sum = 0;
+        for (const Position& pos : positions) sum += MoveGenerator::generate_moves(pos).size();
+        return sum;
+    }});
+    
+    cases.push_back({"evaluate", uint64_t(positions.size()), [&] {
+        uint64_t sum = 0;
+        for (const Position& pos : positions) sum += Evaluator::evaluate(pos);
+        return sum;
+    }});
+    
+    // Every other probe misses; 1 MB stays in L2 on most machines,
+    // the larger tables are DRAM bound
+    std::vector<uint64_t> keys(INPUT_COUNT * 4);
+    for (uint64_t& key : keys) key = rng();
+    
+    std::vector<std::unique_ptr<TranspositionTable>> tables;
+    for (size_t mb : {1, 16, 256}) {
+        tables.push_back(std::make_unique<TranspositionTable>(mb));
+        TranspositionTable* tt = tables.back().get();
+        std::string size = std::to_string(mb) + "mb";
+        
+        for (size_t i = 0; i < keys.size(); i += 2) {
+            tt->store(keys[i], Score(i & 0xFF), Move(i), int(i & 31), EXACT);
+        }
+        
+        cases.push_back({"tt_store_" + size, uint64_t(keys.size()), [&keys, tt] {
+            for (size_t i = 0; i < keys.size(); i++) {
+                tt->store(keys[i], Score(i & 0xFF), Move(i), int(i & 31), EXACT);
+            }
+            return uint64_t(0);
+        }});
+        
+        cases.push_back({"tt_probe_" + size, uint64_t(keys.size()), [&keys, tt] {
+            uint64_t sum = 0;
+            TTEntry entry;
+            for (size_t i = 0; i < keys.size(); i++) {
+                if (tt->probe(keys[i] ^ (i & 1), entry)) sum += entry.best_move;
+            }
+            return sum;
+        }});
+    }
+    
+    // One op is a "position" command of a 300-ply game, through the UCI
+    // command loop, incrementally or rebuilt from the start each time
+    std::vector<Move> replay_game;
+    while (int(replay_game.size()) < REPLAY_PLIES) replay_game = record_game(rng, REPLAY_PLIES);
+    
+    UCIInterface uci;
+    for (bool rebuild : {false, true}) {
+        std::string script = replay_script(replay_game, rebuild);
+        cases.push_back({rebuild ? "position_rebuild" : "position_replay", uint64_t(REPLAY_PLIES), [&uci, script] {
+            std::istringstream in(script);
+            uci.run(in);
+            return uint64_t(script.size());
+        }});
+    }
+    
+    for (const Case& c : cases) {
+        if (options.filter.empty() || c.name.find(options.filter) != std::string::npos) {
+            measure(c, options, out);
+        }
+    }
+}
+
+// Best and median of the repetitions, after one warm-up call
+void MicroBenchmark::measure(const Case& c, const Options& options, std::ostream& out) {
+    uint64_t checksum = c.body();
+    std::vector<double> ns_per_op;
+    
+    for (int r = 0; r < options.repetitions; r++) {
+        auto start = std::chrono::steady_clock::now();
+        checksum += c.body();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        
+        double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        ns_per_op.push_back(ns / std::max<uint64_t>(c.ops, 1));
+    }
+    
+    std::sort(ns_per_op.begin(), ns_per_op.end());
+    
+    out << "{\"name\":\"" << c.name << "\""
+        << ",\"ops\":" << c.ops
+        << ",\"repetitions\":" << options.repetitions
+        << ",\"min_ns_per_op\":" << ns_per_op.front()
+        << ",\"median_ns_per_op\":" << ns_per_op[ns_per_op.size() / 2]
+        << ",\"cpu_path\":\"" << BitboardUtils::cpu_path() << "\""
+        << ",\"checksum\":" << checksum << "}" << std::endl;
+}
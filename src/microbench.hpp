@@ -0,0 +1,28 @@
+// ===== MICRO BENCHMARKS =====
+#include <functional>
+#include <ostream>
+
+// Times single primitives over seeded random inputs, large enough that
+// branch predictors and caches cannot simply memorise one input. Results
+// are printed as one JSON object per benchmark.
+class MicroBenchmark {
+public:
+    struct Options {
+        std::string filter;  // run only benchmarks whose name contains this
+        int repetitions = 5;
+        uint64_t seed = 0x5EED;
+    };
+    
+    // microbench [filter] [--repetitions N] [--seed S]
+    static Options parse_options(const std::vector<std::string>& args);
+    static void run(const Options& options, std::ostream& out);
+    
+private:
+    struct Case {
+        std::string name;
+        uint64_t ops;  // primitive operations per call of body
+        std::function<uint64_t()> body;  // returns a checksum so nothing is optimised away
+    };
+    
+    static void measure(const Case& c, const Options& options, std::ostream& out);
+};
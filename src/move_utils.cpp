@@ -1,80 +1,11 @@
 #include "move_utils.hpp"
+#include "bitboard_utils.hpp"
+#include "movegen.hpp"
+#include <algorithm>
 #include <sstream>
 
-// Move encoding:
-// bits 0-5: from square (6 bits)
-// bits 6-11: to square (6 bits)  
-// bits 12-14: promotion piece type (3 bits)
-// bit 15: castling flag
-// bit 16: en passant flag
-// bit 17: capture flag
-// bits 18-31: reserved for future use
-
-constexpr Move CASTLING_FLAG = 1 << 15;
-constexpr Move EN_PASSANT_FLAG = 1 << 16;
-constexpr Move CAPTURE_FLAG = 1 << 17;
-
-Move MoveUtils::make_move(Square from, Square to, PieceType promotion) {
-    Move move = from | (to << 6);
-    
-    if (promotion != PIECE_TYPE_NB) {
-        move |= (promotion << 12);
-    }
-    
-    return move;
-}
-
-Move MoveUtils::make_castling_move(Square from, Square to) {
-    return make_move(from, to) | CASTLING_FLAG;
-}
-
-Move MoveUtils::make_en_passant_move(Square from, Square to) {
-    return make_move(from, to) | EN_PASSANT_FLAG | CAPTURE_FLAG;
-}
-
-Move MoveUtils::make_capture_move(Square from, Square to, PieceType promotion) {
-    Move move = make_move(from, to, promotion);
-    return move | CAPTURE_FLAG;
-}
-
-Move MoveUtils::make_promotion_move(Square from, Square to, PieceType promotion, bool is_capture) {
-    Move move = make_move(from, to, promotion);
-    if (is_capture) {
-        move |= CAPTURE_FLAG;
-    }
-    return move;
-}
-
-Square MoveUtils::from_sq(Move m) {
-    return Square(m & 0x3F);
-}
-
-Square MoveUtils::to_sq(Move m) {
-    return Square((m >> 6) & 0x3F);
-}
-
-PieceType MoveUtils::promotion_type(Move m) {
-    return PieceType((m >> 12) & 0x7);
-}
-
-bool MoveUtils::is_promotion(Move m) {
-    return (m >> 12) & 0x7;
-}
-
-bool MoveUtils::is_castling(Move m) {
-    return m & CASTLING_FLAG;
-}
-
-bool MoveUtils::is_en_passant(Move m) {
-    return m & EN_PASSANT_FLAG;
-}
-
-bool MoveUtils::is_capture(Move m) {
-    return m & CAPTURE_FLAG;
-}
-
 std::string MoveUtils::to_string(Move m) {
-    if (m == 0) return "0000";
+    if (is_null(m)) return "0000";
     
     Square from = from_sq(m);
     Square to = to_sq(m);
@@ -138,94 +69,268 @@ Move MoveUtils::from_string(const std::string& move_str) {
     return make_move(from, to, promotion);
 }
 
+// Position-aware parsing: recovers the castling and en passant move types
+// that plain coordinate notation does not spell out
+Move MoveUtils::from_string(const std::string& move_str, const Position& pos) {
+    Move m = from_string(move_str);
+    if (is_null(m)) return m;
+    
+    Square from = from_sq(m);
+    Square to = to_sq(m);
+    Piece moving_piece = pos.piece_on(from);
+    
+    if ((moving_piece == W_KING || moving_piece == B_KING) && std::abs(to - from) == 2) {
+        return make_castling_move(from, to);
+    }
+    
+    if ((moving_piece == W_PAWN || moving_piece == B_PAWN) && to == pos.en_passant_square()) {
+        return make_en_passant_move(from, to);
+    }
+    
+    return m;
+}
+
+namespace {
+    char piece_letter(PieceType pt) {
+        switch (pt) {
+            case KING: return 'K';
+            case QUEEN: return 'Q';
+            case ROOK: return 'R';
+            case BISHOP: return 'B';
+            case KNIGHT: return 'N';
+            default: return 0;
+        }
+    }
+    
+    PieceType piece_from_letter(char c) {
+        switch (c) {
+            case 'K': return KING;
+            case 'Q': return QUEEN;
+            case 'R': return ROOK;
+            case 'B': return BISHOP;
+            case 'N': return KNIGHT;
+            default: return PIECE_TYPE_NB;
+        }
+    }
+    
+    // Squares a piece of the given type could move from to reach sq
+    Bitboard attacks_to(PieceType pt, Square sq, Bitboard occupied) {
+        switch (pt) {
+            case KNIGHT: return BitboardUtils::get_knight_attacks(sq);
+            case BISHOP: return BitboardUtils::get_bishop_attacks(sq, occupied);
+            case ROOK: return BitboardUtils::get_rook_attacks(sq, occupied);
+            case QUEEN: return BitboardUtils::get_queen_attacks(sq, occupied);
+            case KING: return BitboardUtils::get_king_attacks(sq);
+            default: return 0ULL;
+        }
+    }
+}
+
 std::string MoveUtils::to_algebraic(Move m, const Position& pos) {
-    if (m == 0) return "null";
+    if (is_null(m)) return "null";
     
     Square from = from_sq(m);
     Square to = to_sq(m);
     Piece moving_piece = pos.piece_on(from);
     PieceType piece_type = PieceType(moving_piece % 6);
+    Color us = pos.side_to_move();
     
     std::string result;
     
-    // Handle castling
     if (is_castling(m)) {
-        if (to % 8 == 6) { // Kingside (g-file)
-            return "O-O";
-        } else { // Queenside (c-file)
-            return "O-O-O";
+        result = to % 8 == 6 ? "O-O" : "O-O-O";
+    } else {
+        // Piece symbol (skip for pawns)
+        if (piece_type != PAWN) {
+            result += piece_letter(piece_type);
+            
+            // Other pieces of the same type that can legally reach the same square
+            Bitboard others = attacks_to(piece_type, to, pos.pieces()) & pos.pieces(us, piece_type)
+                            & ~BitboardUtils::square_bb(from);
+            bool ambiguous = false;
+            bool same_file = false;
+            bool same_rank = false;
+            
+            while (others) {
+                Square sq = BitboardUtils::pop_lsb(others);
+                if (!pos.is_legal(make_move(sq, to))) continue;
+                
+                ambiguous = true;
+                same_file |= sq % 8 == from % 8;
+                same_rank |= sq / 8 == from / 8;
+            }
+            
+            if (ambiguous) {
+                if (!same_file) {
+                    result += char('a' + (from % 8));
+                } else if (!same_rank) {
+                    result += char('1' + (from / 8));
+                } else {
+                    result += char('a' + (from % 8));
+                    result += char('1' + (from / 8));
+                }
+            }
+        }
+        
+        // Capture symbol
+        if (is_capture(m, pos)) {
+            if (piece_type == PAWN) {
+                result += char('a' + (from % 8));
+            }
+            result += 'x';
+        }
+        
+        // Destination square
+        result += char('a' + (to % 8));
+        result += char('1' + (to / 8));
+        
+        // Promotion
+        if (is_promotion(m)) {
+            result += '=';
+            result += piece_letter(promotion_type(m));
         }
     }
     
-    // Piece symbol (skip for pawns)
-    if (piece_type != PAWN) {
-        switch (piece_type) {
-            case KING: result += 'K'; break;
-            case QUEEN: result += 'Q'; break;
-            case ROOK: result += 'R'; break;
-            case BISHOP: result += 'B'; break;
-            case KNIGHT: result += 'N'; break;
-            default: break;
+    // Check and checkmate; only a checking move is played to look for replies
+    if (pos.gives_check(m)) {
+        Position after = pos;
+        after.do_move(m);
+        
+        bool has_reply = false;
+        for (Move reply : MoveGenerator::generate_evasions(after)) {
+            if (after.is_legal(reply)) {
+                has_reply = true;
+                break;
+            }
+        }
+        result += has_reply ? '+' : '#';
+    }
+    
+    return result;
+}
+
+// Parses standard algebraic notation against the position. Candidate origin
+// squares come from the attack tables, so no move list is built. Returns
+// the null move when the text is not exactly one legal move.
+Move MoveUtils::from_san(std::string_view san, const Position& pos) {
+    // Strip check, mate and annotation suffixes
+    while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?')) {
+        san.remove_suffix(1);
+    }
+    if (san.size() < 2) return null_move();
+    
+    Color us = pos.side_to_move();
+    Color them = Color(us ^ 1);
+    Square king_sq = pos.king_square(us);
+    Bitboard occupied = pos.pieces();
+    
+    // Castling
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+        bool kingside = san.size() == 3;
+        Square rook_sq = kingside ? king_sq + 3 : king_sq - 4;
+        Square step = kingside ? 1 : -1;
+        int right = us == WHITE ? (kingside ? WHITE_OO : WHITE_OOO) : (kingside ? BLACK_OO : BLACK_OOO);
+        
+        if (!(pos.castling() & right)) return null_move();
+        if (king_sq != (us == WHITE ? E1 : E8)) return null_move();
+        if (pos.piece_on(rook_sq) != (us == WHITE ? W_ROOK : B_ROOK)) return null_move();
+        for (Square sq = king_sq + step; sq != rook_sq; sq += step) {
+            if (occupied & BitboardUtils::square_bb(sq)) return null_move();
         }
+        
+        Move m = make_castling_move(king_sq, king_sq + 2 * step);
+        return pos.is_legal(m) ? m : null_move();
     }
     
-    // Check for ambiguity (simplified - would need move generation for full accuracy)
-    // For now, just add file/rank disambiguation when needed
-    bool needs_file_disambiguation = false;
-    bool needs_rank_disambiguation = false;
+    PieceType piece_type = piece_from_letter(san[0]);
+    size_t start = 0;
+    if (piece_type == PIECE_TYPE_NB) {
+        piece_type = PAWN;
+    } else {
+        start = 1;
+    }
     
-    // Add disambiguation if needed
-    if (needs_file_disambiguation) {
-        result += char('a' + (from % 8));
-    } else if (needs_rank_disambiguation) {
-        result += char('1' + (from / 8));
+    // Promotion, as "e8=Q" or "e8Q"
+    PieceType promotion = PIECE_TYPE_NB;
+    if (piece_type == PAWN) {
+        PieceType pt = piece_from_letter(san.back());
+        if (pt != PIECE_TYPE_NB && pt != KING) {
+            promotion = pt;
+            san.remove_suffix(1);
+            if (!san.empty() && san.back() == '=') san.remove_suffix(1);
+        }
     }
     
-    // Capture symbol
-    if (is_capture(m)) {
-        if (piece_type == PAWN && !needs_file_disambiguation) {
-            result += char('a' + (from % 8));
+    if (san.size() < start + 2) return null_move();
+    
+    int to_file = san[san.size() - 2] - 'a';
+    int to_rank = san[san.size() - 1] - '1';
+    if (to_file < 0 || to_file >= 8 || to_rank < 0 || to_rank >= 8) return null_move();
+    Square to = to_rank * 8 + to_file;
+    
+    // Disambiguation and capture marks between the piece and the destination
+    int from_file = -1;
+    int from_rank = -1;
+    for (size_t i = start; i < san.size() - 2; i++) {
+        char c = san[i];
+        if (c >= 'a' && c <= 'h') {
+            from_file = c - 'a';
+        } else if (c >= '1' && c <= '8') {
+            from_rank = c - '1';
+        } else if (c != 'x' && c != '-') {
+            return null_move();
         }
-        result += 'x';
     }
     
-    // Destination square
-    result += char('a' + (to % 8));
-    result += char('1' + (to / 8));
+    if (pos.pieces(us) & BitboardUtils::square_bb(to)) return null_move();
     
-    // Promotion
-    if (is_promotion(m)) {
-        result += '=';
-        PieceType pt = promotion_type(m);
-        switch (pt) {
-            case QUEEN: result += 'Q'; break;
-            case ROOK: result += 'R'; break;
-            case BISHOP: result += 'B'; break;
-            case KNIGHT: result += 'N'; break;
-            default: break;
+    Bitboard candidates;
+    bool en_passant = false;
+    
+    if (piece_type == PAWN) {
+        int push = us == WHITE ? 8 : -8;
+        
+        if (from_file >= 0 && from_file != to_file) {
+            candidates = BitboardUtils::get_pawn_attacks(to, them) & pos.pieces(us, PAWN);
+            en_passant = to == pos.en_passant_square();
+            if (!en_passant && pos.piece_on(to) == NO_PIECE) return null_move();
+        } else {
+            Square single = to - push;
+            if (single < A1 || single > H8 || (occupied & BitboardUtils::square_bb(to))) return null_move();
+            
+            if (pos.piece_on(single) != NO_PIECE) {
+                candidates = BitboardUtils::square_bb(single) & pos.pieces(us, PAWN);
+            } else if (to_rank == (us == WHITE ? 3 : 4)) {
+                candidates = BitboardUtils::square_bb(single - push) & pos.pieces(us, PAWN);
+            } else {
+                candidates = 0ULL;
+            }
+        }
+        
+        // A missing promotion piece means a queen
+        if ((to_rank == 0 || to_rank == 7) && promotion == PIECE_TYPE_NB) {
+            promotion = QUEEN;
         }
+    } else {
+        candidates = attacks_to(piece_type, to, occupied) & pos.pieces(us, piece_type);
     }
     
-    // Check/checkmate symbols would require position analysis
-    // result += '+' for check, '#' for checkmate
+    Move found = null_move();
     
-    return result;
-}
-
-bool MoveUtils::is_quiet(Move m) {
-    return !is_capture(m) && !is_promotion(m);
-}
-
-bool MoveUtils::is_tactical(Move m) {
-    return is_capture(m) || is_promotion(m);
-}
-
-Move MoveUtils::null_move() {
-    return 0;
-}
-
-bool MoveUtils::is_null(Move m) {
-    return m == 0;
+    while (candidates) {
+        Square from = BitboardUtils::pop_lsb(candidates);
+        if (from_file >= 0 && from % 8 != from_file) continue;
+        if (from_rank >= 0 && from / 8 != from_rank) continue;
+        
+        Move m = en_passant ? make_en_passant_move(from, to) : make_move(from, to, promotion);
+        if (!pos.is_legal(m)) continue;
+        
+        // Ambiguous
+        if (!is_null(found)) return null_move();
+        found = m;
+    }
+    
+    return found;
 }
 
 // Move scoring for move ordering
@@ -233,7 +338,7 @@ int MoveUtils::get_move_score(Move m, const Position& pos) {
     int score = 0;
     
     // Captures: MVV-LVA (Most Valuable Victim - Least Valuable Attacker)
-    if (is_capture(m)) {
+    if (is_capture(m, pos)) {
         Square from = from_sq(m);
         Square to = to_sq(m);
         Piece victim = pos.piece_on(to);
@@ -277,16 +382,74 @@ int MoveUtils::get_piece_value(PieceType pt) {
     return piece_values[pt];
 }
 
-bool MoveUtils::operator<(const Move& a, const Move& b) {
-    return a < b;
-}
-
-bool MoveUtils::operator==(const Move& a, const Move& b) {
-    return a == b;
-}
-
-bool MoveUtils::operator!=(const Move& a, const Move& b) {
-    return a != b;
+// Static exchange evaluation: material outcome of the capture sequence on the
+// destination square, with both sides always recapturing with their least
+// valuable attacker and free to stop when recapturing loses
+int MoveUtils::see(Move m, const Position& pos) {
+    if (is_castling(m)) return 0;
+    
+    Square from = from_sq(m);
+    Square to = to_sq(m);
+    Color side = Color((pos.piece_on(from) < B_PAWN ? WHITE : BLACK) ^ 1);
+    Bitboard occupied = pos.pieces() ^ BitboardUtils::square_bb(from);
+    
+    int gain[32];
+    int depth = 0;
+    
+    Piece victim = pos.piece_on(to);
+    gain[0] = victim != NO_PIECE ? get_piece_value(PieceType(victim % 6)) : 0;
+    PieceType on_square = PieceType(pos.piece_on(from) % 6);
+    
+    if (is_en_passant(m)) {
+        gain[0] = get_piece_value(PAWN);
+        occupied ^= BitboardUtils::square_bb(side == BLACK ? to - 8 : to + 8);
+    }
+    
+    if (is_promotion(m)) {
+        on_square = promotion_type(m);
+        gain[0] += get_piece_value(on_square) - get_piece_value(PAWN);
+    }
+    
+    Bitboard rook_likes = pos.pieces(ROOK) | pos.pieces(QUEEN);
+    Bitboard bishop_likes = pos.pieces(BISHOP) | pos.pieces(QUEEN);
+    Bitboard attackers = pos.attackers_to(to, occupied) & occupied;
+    
+    while (depth < 31) {
+        Bitboard ours = attackers & pos.pieces(side);
+        if (!ours) break;
+        
+        // Least valuable attacker recaptures
+        PieceType pt = PAWN;
+        Bitboard candidates = 0ULL;
+        for (; pt <= KING; pt = PieceType(pt + 1)) {
+            candidates = ours & pos.pieces(pt);
+            if (candidates) break;
+        }
+        
+        // The king cannot recapture onto a defended square
+        if (pt == KING && (attackers & pos.pieces(Color(side ^ 1)))) break;
+        
+        depth++;
+        gain[depth] = get_piece_value(on_square) - gain[depth - 1];
+        if (std::max(-gain[depth - 1], gain[depth]) < 0) break;
+        
+        occupied ^= BitboardUtils::square_bb(BitboardUtils::lsb(candidates));
+        
+        // Sliders lined up behind the capturer join in
+        attackers |= (BitboardUtils::get_rook_attacks(to, occupied) & rook_likes)
+                   | (BitboardUtils::get_bishop_attacks(to, occupied) & bishop_likes);
+        attackers &= occupied;
+        
+        on_square = pt;
+        side = Color(side ^ 1);
+    }
+    
+    while (depth > 0) {
+        gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+        depth--;
+    }
+    
+    return gain[0];
 }
 
 // Debug function to print move details
@@ -295,7 +458,6 @@ std::string MoveUtils::debug_string(Move m) {
     ss << "Move: " << to_string(m);
     ss << " [from=" << from_sq(m) << ", to=" << to_sq(m) << "]";
     
-    if (is_capture(m)) ss << " CAPTURE";
     if (is_castling(m)) ss << " CASTLING";
     if (is_en_passant(m)) ss << " EN_PASSANT";
     if (is_promotion(m)) {
@@ -1,36 +1,54 @@
 // ===== MOVE UTILITIES =====
 #include "position.hpp"
 
+// Move encoding (16 bits):
+// bits 0-5: from square
+// bits 6-11: to square
+// bits 12-13: promotion piece type (KNIGHT..QUEEN, stored minus KNIGHT)
+// bits 14-15: move type
+// Whether a move captures is not stored; it is derived from the position.
+enum MoveType {
+    NORMAL = 0,
+    PROMOTION = 1 << 14,
+    EN_PASSANT = 2 << 14,
+    CASTLING = 3 << 14
+};
+
 class MoveUtils {
 public:
-    static Move make_castling_move(Square from, Square to);
-    static Move make_en_passant_move(Square from, Square to);
-    static Move make_capture_move(Square from, Square to, PieceType promotion = PIECE_TYPE_NB);
-    static Move make_promotion_move(Square from, Square to, PieceType promotion, bool is_capture = false);
+    static constexpr Move make_move(Square from, Square to, PieceType promotion = PIECE_TYPE_NB) {
+        return promotion == PIECE_TYPE_NB
+            ? Move(from | (to << 6))
+            : Move(from | (to << 6) | ((promotion - KNIGHT) << 12) | PROMOTION);
+    }
+    static constexpr Move make_castling_move(Square from, Square to) { return Move(from | (to << 6) | CASTLING); }
+    static constexpr Move make_en_passant_move(Square from, Square to) { return Move(from | (to << 6) | EN_PASSANT); }
+    static constexpr Move make_promotion_move(Square from, Square to, PieceType promotion) { return make_move(from, to, promotion); }
+    
+    static constexpr Square from_sq(Move m) { return m & 0x3F; }
+    static constexpr Square to_sq(Move m) { return (m >> 6) & 0x3F; }
+    static constexpr MoveType type_of(Move m) { return MoveType(m & (3 << 14)); }
+    static constexpr PieceType promotion_type(Move m) { return PieceType(((m >> 12) & 0x3) + KNIGHT); }
+    static constexpr bool is_promotion(Move m) { return type_of(m) == PROMOTION; }
+    static constexpr bool is_castling(Move m) { return type_of(m) == CASTLING; }
+    static constexpr bool is_en_passant(Move m) { return type_of(m) == EN_PASSANT; }
+    static constexpr Move null_move() { return 0; }
+    static constexpr bool is_null(Move m) { return m == 0; }
     
-    static bool is_capture(Move m);
-    static bool is_quiet(Move m);
-    static bool is_tactical(Move m);
-    static Move null_move();
-    static bool is_null(Move m);
+    static bool is_capture(Move m, const Position& pos) {
+        return is_en_passant(m) || (!is_castling(m) && pos.piece_on(to_sq(m)) != NO_PIECE);
+    }
+    static bool is_quiet(Move m, const Position& pos) { return !is_capture(m, pos) && !is_promotion(m); }
+    static bool is_tactical(Move m, const Position& pos) { return is_capture(m, pos) || is_promotion(m); }
     
     static Move from_string(const std::string& move_str);
+    static Move from_string(const std::string& move_str, const Position& pos);
+    static std::string to_string(Move m);
     static std::string to_algebraic(Move m, const Position& pos);
+    static Move from_san(std::string_view san, const Position& pos);
     static std::string debug_string(Move m);
     
     static int get_move_score(Move m, const Position& pos);
+    static int see(Move m, const Position& pos);
     static int get_piece_value(PieceType pt);
-    
-    // Operators for move comparison
-    static bool operator<(const Move& a, const Move& b);
-    static bool operator==(const Move& a, const Move& b);
-    static bool operator!=(const Move& a, const Move& b);
-    static Move make_move(Square from, Square to, PieceType promotion = PIECE_TYPE_NB);
-    static Square from_sq(Move m) { return m & 0x3F; }
-    static Square to_sq(Move m) { return (m >> 6) & 0x3F; }
-    static PieceType promotion_type(Move m) { return PieceType((m >> 12) & 0x7); }
-    static bool is_promotion(Move m) { return m & (0x7 << 12); }
-    static bool is_castling(Move m) { return m & (1 << 15); }
-    static bool is_en_passant(Move m) { return m & (1 << 16); }
-    static std::string to_string(Move m);
 };
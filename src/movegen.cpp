@@ -0,0 +1,347 @@
+#include "movegen.hpp"
+#include "move_utils.hpp"
+#include "bitboard_utils.hpp"
+
+namespace {
+    constexpr Bitboard FILE_A_BB = 0x0101010101010101ULL;
+    constexpr Bitboard FILE_H_BB = FILE_A_BB << 7;
+    constexpr Bitboard RANK_2_BB = 0xFFULL << 8;
+    constexpr Bitboard RANK_3_BB = 0xFFULL << 16;
+    constexpr Bitboard RANK_6_BB = 0xFFULL << 40;
+    constexpr Bitboard RANK_7_BB = 0xFFULL << 48;
+    
+    // The set moved by one step in a direction, dropping squares that
+    // would wrap around the board edge
+    template <int Direction>
+    constexpr Bitboard shift(Bitboard b) {
+        if constexpr (Direction == 8) return b << 8;
+        if constexpr (Direction == -8) return b >> 8;
+        if constexpr (Direction == 9) return (b & ~FILE_H_BB) << 9;
+        if constexpr (Direction == 7) return (b & ~FILE_A_BB) << 7;
+        if constexpr (Direction == -7) return (b & ~FILE_H_BB) >> 7;
+        if constexpr (Direction == -9) return (b & ~FILE_A_BB) >> 9;
+        return 0;
+    }
+    
+    Bitboard piece_attacks(PieceType pt, Square sq, Bitboard occupied) {
+        switch (pt) {
+            case KNIGHT: return BitboardUtils::get_knight_attacks(sq);
+            case BISHOP: return BitboardUtils::get_bishop_attacks(sq, occupied);
+            case ROOK: return BitboardUtils::get_rook_attacks(sq, occupied);
+            case QUEEN: return BitboardUtils::get_queen_attacks(sq, occupied);
+            case KING: return BitboardUtils::get_king_attacks(sq);
+            default: return 0ULL;
+        }
+    }
+}
+
+std::vector<Move> MoveGenerator::generate_moves(const Position& pos) {
+    return generate_for_side<ALL>(pos);
+}
+
+// Captures and all promotions
+std::vector<Move> MoveGenerator::generate_captures(const Position& pos) {
+    return generate_for_side<CAPTURES>(pos);
+}
+
+// Non-captures other than promotions, castling included
+std::vector<Move> MoveGenerator::generate_quiet_moves(const Position& pos) {
+    return generate_for_side<QUIETS>(pos);
+}
+
+// Moves out of check. King moves are fully legal; captures of the checker
+// and interpositions are pseudo-legal and may still be pinned.
+std::vector<Move> MoveGenerator::generate_evasions(const Position& pos) {
+    return generate_for_side<EVASIONS>(pos);
+}
+
+template <MoveGenerator::GenType Type>
+std::vector<Move> MoveGenerator::generate_for_side(const Position& pos) {
+    std::vector<Move> moves;
+    moves.reserve(Type == EVASIONS ? 32 : 64);
+    
+    if (pos.side_to_move() == WHITE) {
+        generate<WHITE, Type>(pos, moves);
+    } else {
+        generate<BLACK, Type>(pos, moves);
+    }
+    
+    return moves;
+}
+
+template <Color Us, MoveGenerator::GenType Type>
+void MoveGenerator::generate(const Position& pos, std::vector<Move>& moves) {
+    constexpr Color Them = Us == WHITE ? BLACK : WHITE;
+    
+    Square king_sq = pos.king_square(Us);
+    Bitboard occupied = pos.pieces();
+    
+    // Destination squares of the pieces other than the king
+    Bitboard targets;
+    
+    if constexpr (Type == EVASIONS) {
+        // King steps are tested with the king lifted off the board so that
+        // a slider cannot be escaped by stepping back along its own line
+        Bitboard without_king = occupied ^ BitboardUtils::square_bb(king_sq);
+        Bitboard king_targets = BitboardUtils::get_king_attacks(king_sq) & ~pos.pieces(Us);
+        
+        while (king_targets) {
+            Square to = BitboardUtils::pop_lsb(king_targets);
+            if (pos.attackers_to(to, without_king) & pos.pieces(Them)) continue;
+            
+            moves.push_back(MoveUtils::make_move(king_sq, to));
+        }
+        
+        // Double check: only the king can move
+        Bitboard checkers = pos.checkers();
+        if (BitboardUtils::popcount(checkers) > 1) return;
+        
+        // Capture the checker or interpose
+        targets = checkers | BitboardUtils::between_squares(king_sq, BitboardUtils::lsb(checkers));
+    } else {
+        targets = Type == CAPTURES ? pos.pieces(Them)
+                : Type == QUIETS   ? ~occupied
+                                   : ~pos.pieces(Us);
+    }
+    
+    generate_pawn_moves<Us, Type>(pos, moves, targets);
+    generate_piece_moves<KNIGHT>(pos, moves, Us, targets);
+    generate_piece_moves<BISHOP>(pos, moves, Us, targets);
+    generate_piece_moves<ROOK>(pos, moves, Us, targets);
+    generate_piece_moves<QUEEN>(pos, moves, Us, targets);
+    
+    if constexpr (Type != EVASIONS) {
+        Bitboard king_targets = BitboardUtils::get_king_attacks(king_sq) & targets;
+        while (king_targets) {
+            moves.push_back(MoveUtils::make_move(king_sq, BitboardUtils::pop_lsb(king_targets)));
+        }
+    }
+    
+    if constexpr (Type == QUIETS || Type == ALL) {
+        generate_castling_moves<Us>(pos, moves);
+    }
+}
+
+// Pawn moves, produced for all pawns at once by shifting the pawn set:
+// the origin of every target square is a fixed offset away. With
+// EVASIONS, targets holds the checker and the squares that block it.
+template <Color Us, MoveGenerator::GenType Type>
+void MoveGenerator::generate_pawn_moves(const Position& pos, std::vector<Move>& moves, Bitboard targets) {
+    constexpr Color Them = Us == WHITE ? BLACK : WHITE;
+    constexpr int Up = Us == WHITE ? 8 : -8;
+    constexpr int UpLeft = Us == WHITE ? 7 : -9;
+    constexpr int UpRight = Us == WHITE ? 9 : -7;
+    constexpr Bitboard Rank3 = Us == WHITE ? RANK_3_BB : RANK_6_BB;
+    constexpr Bitboard Rank7 = Us == WHITE ? RANK_7_BB : RANK_2_BB;
+    
+    Bitboard empty = ~pos.pieces();
+    Bitboard enemies = Type == EVASIONS ? pos.pieces(Them) & targets : pos.pieces(Them);
+    Bitboard pawns = pos.pieces(Us, PAWN) & ~Rank7;
+    Bitboard promoting = pos.pieces(Us, PAWN) & Rank7;
+    
+    auto add_moves = [&moves](Bitboard to_squares, int offset) {
+        while (to_squares) {
+            Square to = BitboardUtils::pop_lsb(to_squares);
+            moves.push_back(MoveUtils::make_move(to - offset, to));
+        }
+    };
+    
+    auto add_promotions = [&moves](Bitboard to_squares, int offset) {
+        while (to_squares) {
+            Square to = BitboardUtils::pop_lsb(to_squares);
+            for (PieceType pt : {QUEEN, KNIGHT, ROOK, BISHOP}) {
+                moves.push_back(MoveUtils::make_promotion_move(to - offset, to, pt));
+            }
+        }
+    };
+    
+    // Single and double pushes
+    if constexpr (Type != CAPTURES) {
+        Bitboard single = shift<Up>(pawns) & empty;
+        Bitboard twice = shift<Up>(single & Rank3) & empty;
+        
+        if constexpr (Type == EVASIONS) {
+            single &= targets;
+            twice &= targets;
+        }
+        
+        add_moves(single, Up);
+        add_moves(twice, Up + Up);
+    }
+    
+    // Promotions, which count as captures even when pushed
+    if constexpr (Type != QUIETS) {
+        Bitboard push_targets = Type == EVASIONS ? empty & targets : empty;
+        add_promotions(shift<Up>(promoting) & push_targets, Up);
+        add_promotions(shift<UpLeft>(promoting) & enemies, UpLeft);
+        add_promotions(shift<UpRight>(promoting) & enemies, UpRight);
+    }
+    
+    if constexpr (Type != QUIETS) {
+        add_moves(shift<UpLeft>(pawns) & enemies, UpLeft);
+        add_moves(shift<UpRight>(pawns) & enemies, UpRight);
+        
+        // En passant; out of check only when the pushed pawn is the checker
+        Square ep_sq = pos.en_passant_square();
+        if (ep_sq < SQUARE_NB && (Type != EVASIONS || (targets & BitboardUtils::square_bb(ep_sq - Up)))) {
+            Bitboard capturers = pawns & BitboardUtils::get_pawn_attacks(ep_sq, Them);
+            while (capturers) {
+                moves.push_back(MoveUtils::make_en_passant_move(BitboardUtils::pop_lsb(capturers), ep_sq));
+            }
+        }
+    }
+}
+
+template <PieceType Pt>
+void MoveGenerator::generate_piece_moves(const Position& pos, std::vector<Move>& moves, Color us, Bitboard targets) {
+    Bitboard pieces = pos.pieces(us, Pt);
+    Bitboard occupied = pos.pieces();
+    
+    while (pieces) {
+        Square from = BitboardUtils::pop_lsb(pieces);
+        Bitboard attacks = Pt == KNIGHT ? BitboardUtils::get_knight_attacks(from)
+                         : Pt == BISHOP ? BitboardUtils::get_bishop_attacks(from, occupied)
+                         : Pt == ROOK   ? BitboardUtils::get_rook_attacks(from, occupied)
+                                        : BitboardUtils::get_queen_attacks(from, occupied);
+        
+        attacks &= targets;
+        while (attacks) {
+            moves.push_back(MoveUtils::make_move(from, BitboardUtils::pop_lsb(attacks)));
+        }
+    }
+}
+
+// Castling with the squares between king and rook empty. Whether the king
+// passes through check is left to Position::is_legal.
+template <Color Us>
+void MoveGenerator::generate_castling_moves(const Position& pos, std::vector<Move>& moves) {
+    constexpr int KingSide = Us == WHITE ? WHITE_OO : BLACK_OO;
+    constexpr int QueenSide = Us == WHITE ? WHITE_OOO : BLACK_OOO;
+    constexpr Square KingFrom = Us == WHITE ? E1 : E8;
+    constexpr Bitboard KingSidePath = Us == WHITE ? 0x60ULL : 0x60ULL << 56;        // f, g
+    constexpr Bitboard QueenSidePath = Us == WHITE ? 0x0EULL : 0x0EULL << 56;       // b, c, d
+    
+    Bitboard occupied = pos.pieces();
+    
+    if ((pos.castling() & KingSide) && !(occupied & KingSidePath)) {
+        moves.push_back(MoveUtils::make_castling_move(KingFrom, KingFrom + 2));
+    }
+    if ((pos.castling() & QueenSide) && !(occupied & QueenSidePath)) {
+        moves.push_back(MoveUtils::make_castling_move(KingFrom, KingFrom - 2));
+    }
+}
+
+// Quiet (non-capture, non-promotion) moves that give direct or discovered
+// check, for the first ply of quiescence search. Castling is not included.
+std::vector<Move> MoveGenerator::generate_quiet_checks(const Position& pos) {
+    std::vector<Move> moves;
+    
+    Color us = pos.side_to_move();
+    Position::CheckInfo ci = pos.check_info();
+    Square king_sq = ci.king_sq;
+    Bitboard occupied = pos.pieces();
+    Bitboard empty = ~occupied;
+    Bitboard discoverers = ci.discoverers;
+    Bitboard rook_likes = pos.pieces(us, ROOK) | pos.pieces(us, QUEEN);
+    Bitboard bishop_likes = pos.pieces(us, BISHOP) | pos.pieces(us, QUEEN);
+    
+    // A discovering piece checks unless it stays on the line it was blocking
+    auto opens_line = [&](Square from, Square to) {
+        Bitboard after = (occupied ^ BitboardUtils::square_bb(from)) | BitboardUtils::square_bb(to);
+        Bitboard sliders = ~BitboardUtils::square_bb(from);
+        return (BitboardUtils::get_rook_attacks(king_sq, after) & rook_likes & sliders)
+             | (BitboardUtils::get_bishop_attacks(king_sq, after) & bishop_likes & sliders);
+    };
+    
+    // Pawn pushes
+    Bitboard pawns = pos.pieces(us, PAWN);
+    Bitboard pawn_checks = ci.check_squares[PAWN];
+    int push = us == WHITE ? 8 : -8;
+    int start_rank = us == WHITE ? 1 : 6;
+    
+    while (pawns) {
+        Square from = BitboardUtils::pop_lsb(pawns);
+        Square to = from + push;
+        
+        if (!(empty & BitboardUtils::square_bb(to)) || to / 8 == 0 || to / 8 == 7) continue;
+        
+        bool discovered = (discoverers & BitboardUtils::square_bb(from)) && opens_line(from, to);
+        if ((pawn_checks & BitboardUtils::square_bb(to)) || discovered) {
+            moves.push_back(MoveUtils::make_move(from, to));
+        }
+        
+        Square double_to = to + push;
+        if (from / 8 == start_rank && (empty & BitboardUtils::square_bb(double_to))) {
+            discovered = (discoverers & BitboardUtils::square_bb(from)) && opens_line(from, double_to);
+            if ((pawn_checks & BitboardUtils::square_bb(double_to)) || discovered) {
+                moves.push_back(MoveUtils::make_move(from, double_to));
+            }
+        }
+    }
+    
+    // Pieces, including king moves that uncover a check
+    for (PieceType pt : {KNIGHT, BISHOP, ROOK, QUEEN, KING}) {
+        Bitboard pieces = pos.pieces(us, pt);
+        Bitboard direct = ci.check_squares[pt];
+        
+        while (pieces) {
+            Square from = BitboardUtils::pop_lsb(pieces);
+            Bitboard targets = piece_attacks(pt, from, occupied) & empty;
+            
+            if (!(discoverers & BitboardUtils::square_bb(from))) {
+                targets &= direct;
+            }
+            
+            while (targets) {
+                Square to = BitboardUtils::pop_lsb(targets);
+                if ((direct & BitboardUtils::square_bb(to)) || opens_line(from, to)) {
+                    moves.push_back(MoveUtils::make_move(from, to));
+                }
+            }
+        }
+    }
+    
+    return moves;
+}
+
+// All checking moves: the quiet checks plus every capture, promotion or
+// castling move that checks
+std::vector<Move> MoveGenerator::generate_checks(const Position& pos) {
+    std::vector<Move> moves = generate_quiet_checks(pos);
+    Position::CheckInfo ci = pos.check_info();
+    
+    std::vector<Move> candidates = generate_captures(pos);
+    if (pos.side_to_move() == WHITE) {
+        generate_castling_moves<WHITE>(pos, candidates);
+    } else {
+        generate_castling_moves<BLACK>(pos, candidates);
+    }
+    
+    for (Move m : candidates) {
+        if (pos.gives_check(m, ci)) moves.push_back(m);
+    }
+    
+    return moves;
+}
+
+uint64_t MoveGenerator::perft(Position& pos, int depth) {
+    if (depth <= 0) return 1;
+    
+    std::vector<Move> moves = pos.in_check() ? generate_evasions(pos) : generate_moves(pos);
+    uint64_t nodes = 0;
+    
+    for (Move m : moves) {
+        if (!pos.is_legal(m)) continue;
+        
+        if (depth == 1) {
+            nodes++;
+            continue;
+        }
+        
+        pos.do_move(m);
+        nodes += perft(pos, depth - 1);
+        pos.undo_move(m);
+    }
+    
+    return nodes;
+}
@@ -4,9 +4,28 @@ public:
     static std::vector<Move> generate_moves(const Position& pos);
     static std::vector<Move> generate_captures(const Position& pos);
     static std::vector<Move> generate_quiet_moves(const Position& pos);
+    static std::vector<Move> generate_evasions(const Position& pos);
+    static std::vector<Move> generate_quiet_checks(const Position& pos);
+    static std::vector<Move> generate_checks(const Position& pos);
+    
+    // Leaf nodes of the legal move tree to the given depth
+    static uint64_t perft(Position& pos, int depth);
     
 private:
-    static void generate_pawn_moves(const Position& pos, std::vector<Move>& moves);
-    static void generate_piece_moves(const Position& pos, std::vector<Move>& moves, PieceType pt);
+    // What a generator produces: captures and promotions, the remaining
+    // moves, moves out of check, or all pseudo-legal moves
+    enum GenType { CAPTURES, QUIETS, EVASIONS, ALL };
+    
+    // Specialised on the side to move and the generation type, so that the
+    // per-node code has no branches on either
+    template <GenType Type>
+    static std::vector<Move> generate_for_side(const Position& pos);
+    template <Color Us, GenType Type>
+    static void generate(const Position& pos, std::vector<Move>& moves);
+    template <Color Us, GenType Type>
+    static void generate_pawn_moves(const Position& pos, std::vector<Move>& moves, Bitboard targets);
+    template <PieceType Pt>
+    static void generate_piece_moves(const Position& pos, std::vector<Move>& moves, Color us, Bitboard targets);
+    template <Color Us>
     static void generate_castling_moves(const Position& pos, std::vector<Move>& moves);
 };
\ No newline at end of file
@@ -0,0 +1,309 @@
+#include "nexus_api.h"
+#include "bitboard_utils.hpp"
+#include "position.hpp"
+#include "move_utils.hpp"
+#include "movegen.hpp"
+#include "eval.hpp"
+#include "search.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+
+struct nx_position {
+    Position pos;
+    std::vector<Move> moves;   // made with nx_do_move, for nx_undo_move
+};
+
+struct nx_engine {
+    explicit nx_engine(size_t hash_mb) : search(hash_mb) {}
+    
+    SearchEngine search;
+    std::vector<nx_move> pv;   // of the last info handed out
+};
+
+namespace {
+    constexpr Bitboard BACK_RANKS = 0xFF000000000000FFULL;
+    
+    std::once_flag tables_once;
+    
+    // No exception may leave the library; running out of memory is
+    // reported as a status instead
+    template<typename Body>
+    nx_status guarded(Body body) {
+        try {
+            return body();
+        } catch (const std::bad_alloc&) {
+            return NX_OUT_OF_MEMORY;
+        }
+    }
+    
+    // What movegen needs to stay within the board and find both kings
+    bool is_playable(const Position& pos) {
+        if (pos.count(W_KING) != 1 || pos.count(B_KING) != 1) return false;
+        if (pos.pieces(PAWN) & BACK_RANKS) return false;
+        
+        Color us = pos.side_to_move();
+        Square their_king = pos.king_square(Color(us ^ 1));
+        return !(pos.attackers_to(their_king, pos.pieces()) & pos.pieces(us));
+    }
+    
+    nx_status parse_fen(const char* fen, Position& pos) {
+        if (fen && (!pos.set_fen(fen) || !is_playable(pos))) return NX_INVALID_FEN;
+        return NX_OK;
+    }
+    
+    template<typename Visit>
+    void for_each_legal(const Position& pos, Visit visit) {
+        for (Move m : pos.in_check() ? MoveGenerator::generate_evasions(pos) : MoveGenerator::generate_moves(pos)) {
+            if (pos.is_legal(m)) visit(m);
+        }
+    }
+    
+    bool is_legal_move(const Position& pos, Move move) {
+        bool found = false;
+        for_each_legal(pos, [&](Move m) { found |= m == move; });
+        return found;
+    }
+    
+    size_t copy_string(const std::string& text, char* buffer, size_t size) {
+        if (buffer && size > 0) {
+            size_t n = std::min(text.size(), size - 1);
+            std::memcpy(buffer, text.data(), n);
+            buffer[n] = '\0';
+        }
+        return text.size();
+    }
+    
+    void fill_info(nx_engine* engine, const SearchEngine::SearchResult& result, nx_search_info* info) {
+        engine->pv.assign(result.pv.begin(), result.pv.end());
+        
+        info->best_move = result.best_move;
+        info->depth = result.depth;
+        info->seldepth = result.seldepth;
+        info->score = result.score;
+        info->mate = result.score >= SCORE_MATE_IN_MAX_PLY ? (SCORE_MATE - result.score + 1) / 2
+                   : result.score <= -SCORE_MATE_IN_MAX_PLY ? -(SCORE_MATE + result.score) / 2
+                   : 0;
+        info->nodes = uint64_t(result.nodes);
+        info->time_ms = result.time_ms;
+        info->pv = engine->pv.data();
+        info->pv_length = engine->pv.size();
+    }
+}
+
+int nx_api_version(void) {
+    return NX_API_VERSION;
+}
+
+void nx_init(void) {
+    std::call_once(tables_once, BitboardUtils::init);
+}
+
+nx_status nx_position_new(const char* fen, nx_position** position) {
+    if (!position) return NX_INVALID_ARGUMENT;
+    nx_init();
+    
+    return guarded([&] {
+        std::unique_ptr<nx_position> created(new nx_position);
+        
+        nx_status status = parse_fen(fen, created->pos);
+        if (status == NX_OK) *position = created.release();
+        return status;
+    });
+}
+
+nx_status nx_position_clone(const nx_position* position, nx_position** copy) {
+    if (!position || !copy) return NX_INVALID_ARGUMENT;
+    
+    return guarded([&] {
+        *copy = new nx_position(*position);
+        return NX_OK;
+    });
+}
+
+void nx_position_free(nx_position* position) {
+    delete position;
+}
+
+nx_status nx_position_set_fen(nx_position* position, const char* fen) {
+    if (!position || !fen) return NX_INVALID_ARGUMENT;
+    
+    return guarded([&] {
+        Position parsed;
+        nx_status status = parse_fen(fen, parsed);
+        if (status != NX_OK) return status;
+        
+        position->pos = std::move(parsed);
+        position->moves.clear();
+        return NX_OK;
+    });
+}
+
+size_t nx_position_fen(const nx_position* position, char* buffer, size_t size) {
+    if (!position) return 0;
+    
+    try {
+        return copy_string(position->pos.fen(), buffer, size);
+    } catch (const std::bad_alloc&) {
+        return copy_string("", buffer, size);
+    }
+}
+
+int nx_position_side_to_move(const nx_position* position) {
+    return position->pos.side_to_move();
+}
+
+int nx_position_in_check(const nx_position* position) {
+    return position->pos.in_check();
+}
+
+uint64_t nx_position_key(const nx_position* position) {
+    return position->pos.key();
+}
+
+nx_status nx_position_state(const nx_position* position, nx_game_state* state) {
+    if (!position || !state) return NX_INVALID_ARGUMENT;
+    const Position& pos = position->pos;
+    
+    return guarded([&] {
+        bool has_move = false;
+        for_each_legal(pos, [&](Move) { has_move = true; });
+        
+        if (!has_move) {
+            *state = pos.in_check() ? NX_CHECKMATE : NX_STALEMATE;
+        } else if (pos.halfmove_count() >= 100) {
+            *state = NX_FIFTY_MOVES;
+        } else {
+            *state = pos.is_repetition() ? NX_REPETITION : NX_ONGOING;
+        }
+        return NX_OK;
+    });
+}
+
+int nx_position_evaluate(const nx_position* position) {
+    return Evaluator::evaluate(position->pos);
+}
+
+nx_status nx_legal_moves(const nx_position* position, nx_move* moves, size_t capacity, size_t* count) {
+    if (!position || !count || (!moves && capacity > 0)) return NX_INVALID_ARGUMENT;
+    
+    return guarded([&] {
+        size_t found = 0;
+        for_each_legal(position->pos, [&](Move m) {
+            if (found < capacity) moves[found] = m;
+            found++;
+        });
+        
+        *count = found;
+        return NX_OK;
+    });
+}
+
+int nx_is_legal(const nx_position* position, nx_move move) {
+    if (!position) return 0;
+    
+    try {
+        return is_legal_move(position->pos, move);
+    } catch (const std::bad_alloc&) {
+        return 0;
+    }
+}
+
+nx_status nx_move_from_uci(const nx_position* position, const char* uci, nx_move* move) {
+    if (!position || !uci || !move) return NX_INVALID_ARGUMENT;
+    
+    size_t length = std::strlen(uci);
+    if (length < 4 || length > 5) return NX_ILLEGAL_MOVE;
+    
+    return guarded([&] {
+        Move m = MoveUtils::from_string(std::string(uci, length), position->pos);
+        if (MoveUtils::is_null(m) || !is_legal_move(position->pos, m)) return NX_ILLEGAL_MOVE;
+        
+        *move = m;
+        return NX_OK;
+    });
+}
+
+size_t nx_move_to_uci(nx_move move, char* buffer, size_t size) {
+    return copy_string(MoveUtils::to_string(move), buffer, size);
+}
+
+nx_status nx_do_move(nx_position* position, nx_move move) {
+    if (!position) return NX_INVALID_ARGUMENT;
+    
+    // Position::do_move only allocates before it changes anything, and the
+    // history has room reserved, so a failure leaves the position as it was
+    return guarded([&] {
+        if (!is_legal_move(position->pos, move)) return NX_ILLEGAL_MOVE;
+        
+        position->moves.reserve(position->moves.size() + 1);
+        position->pos.do_move(move);
+        position->moves.push_back(move);
+        return NX_OK;
+    });
+}
+
+nx_status nx_undo_move(nx_position* position) {
+    if (!position) return NX_INVALID_ARGUMENT;
+    if (position->moves.empty()) return NX_NO_MOVE_TO_UNDO;
+    
+    position->pos.undo_move(position->moves.back());
+    position->moves.pop_back();
+    return NX_OK;
+}
+
+nx_status nx_engine_new(size_t hash_mb, nx_engine** engine) {
+    if (!engine) return NX_INVALID_ARGUMENT;
+    nx_init();
+    
+    return guarded([&] {
+        *engine = new nx_engine(hash_mb ? hash_mb : 16);
+        return NX_OK;
+    });
+}
+
+void nx_engine_free(nx_engine* engine) {
+    delete engine;
+}
+
+void nx_engine_clear(nx_engine* engine) {
+    engine->search.clear();
+}
+
+// Unset limits are unbounded; with none at all the search runs until stopped
+nx_status nx_search(nx_engine* engine, const nx_position* position, const nx_search_limits* limits,
+                    nx_iteration_callback callback, void* user_data, nx_search_info* result) {
+    if (!engine || !position || !limits || !result) return NX_INVALID_ARGUMENT;
+    
+    // A stop sent from now on ends this search, even while it sets itself up
+    engine->search.clear_stop();
+    
+    return guarded([&] {
+        SearchEngine::SearchInfo info;
+        info.max_depth = limits->max_depth > 0 ? limits->max_depth : MAX_PLY;
+        info.max_time_ms = limits->max_time_ms > 0 ? limits->max_time_ms : INT_MAX;
+        info.max_nodes = limits->max_nodes > 0 ? limits->max_nodes : INT_MAX;
+        info.infinite = limits->max_depth <= 0 && limits->max_time_ms <= 0 && limits->max_nodes <= 0;
+        
+        if (callback) {
+            info.on_iteration = [&](const SearchEngine::SearchResult& iteration) {
+                nx_search_info reported;
+                fill_info(engine, iteration, &reported);
+                if (callback(&reported, user_data)) engine->search.stop_search();
+            };
+        }
+        
+        engine->search.search(position->pos, info);
+        
+        fill_info(engine, engine->search.last_result(), result);
+        return NX_OK;
+    });
+}
+
+void nx_engine_stop(nx_engine* engine) {
+    engine->search.stop_search();
+}
@@ -0,0 +1,172 @@
+// ===== C API =====
+// Embeds the engine in another process: positions from FEN, legal moves
+// into caller buffers, making and unmaking moves, evaluation and bounded
+// searches, with no UCI text in between.
+//
+// The header is plain C and self-contained. Build the library from every
+// engine source but main.cpp, compiled with -fPIC -fvisibility=hidden:
+//   static: ar rcs libnexus.a *.o
+//   shared: g++ -shared -o libnexus.so *.o -pthread -Wl,--version-script=nexus.map
+// where nexus.map is "{ global: nx_*; local: *; };", so that the shared
+// library exports the nx_ functions and none of the C++ inside.
+//
+// Threads: the tables are built once, on the first call that needs them,
+// and are read-only afterwards. Every other piece of state lives in an
+// nx_position or nx_engine, so any number of threads can work at once as
+// long as each object is used by one thread at a time. nx_engine_stop is
+// the exception and may be called from any thread.
+//
+// Errors: no C++ exception leaves the library. Functions returning
+// nx_status report running out of memory as NX_OUT_OF_MEMORY and leave
+// their arguments unchanged.
+#ifndef NEXUS_API_H
+#define NEXUS_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define NX_API __attribute__((visibility("default")))
+#else
+#define NX_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Raised whenever a function or struct changes incompatibly
+#define NX_API_VERSION 1
+
+// Longest possible FEN, with its terminating zero
+#define NX_FEN_MAX 128
+
+// Enough room for the legal moves of any position
+#define NX_MAX_MOVES 256
+
+typedef struct nx_position nx_position;
+typedef struct nx_engine nx_engine;
+
+// from | to << 6 | promotion | kind << 14, as in the engine; 0 is no move
+typedef uint16_t nx_move;
+
+typedef enum {
+    NX_OK = 0,
+    NX_INVALID_ARGUMENT,
+    NX_INVALID_FEN,
+    NX_ILLEGAL_MOVE,
+    NX_NO_MOVE_TO_UNDO,
+    NX_OUT_OF_MEMORY
+} nx_status;
+
+typedef enum {
+    NX_ONGOING = 0,
+    NX_CHECKMATE,
+    NX_STALEMATE,
+    NX_FIFTY_MOVES,
+    NX_REPETITION        // the position occurred before since the last capture or pawn move
+} nx_game_state;
+
+// The version the library was built with, to compare with NX_API_VERSION
+NX_API int nx_api_version(void);
+
+// Builds the attack tables and hash keys. Called by every function that
+// needs them, so calling it up front only moves the cost out of the
+// first request.
+NX_API void nx_init(void);
+
+// ----- Positions -----
+
+// The starting position when fen is NULL; NX_INVALID_FEN unless the FEN
+// parses, has one king a side and the side not to move is not in check
+NX_API nx_status nx_position_new(const char* fen, nx_position** position);
+NX_API nx_status nx_position_clone(const nx_position* position, nx_position** copy);
+NX_API void nx_position_free(nx_position* position);
+
+// Replaces the position and clears its move history; unchanged on error
+NX_API nx_status nx_position_set_fen(nx_position* position, const char* fen);
+
+// Writes at most size bytes including the terminating zero, like
+// snprintf, and returns the length of the whole FEN; 0 when memory runs out
+NX_API size_t nx_position_fen(const nx_position* position, char* buffer, size_t size);
+
+// 0 for white, 1 for black
+NX_API int nx_position_side_to_move(const nx_position* position);
+NX_API int nx_position_in_check(const nx_position* position);
+NX_API uint64_t nx_position_key(const nx_position* position);
+NX_API nx_status nx_position_state(const nx_position* position, nx_game_state* state);
+
+// Centipawns from the side to move's point of view
+NX_API int nx_position_evaluate(const nx_position* position);
+
+// ----- Moves -----
+
+// Writes up to capacity legal moves and sets count to how many there are,
+// which may be more than capacity; NX_MAX_MOVES always suffices. moves may
+// be NULL only when capacity is 0.
+NX_API nx_status nx_legal_moves(const nx_position* position, nx_move* moves, size_t capacity, size_t* count);
+
+// 0 as well when the position is NULL or memory runs out
+NX_API int nx_is_legal(const nx_position* position, nx_move move);
+
+// Coordinate notation such as "e2e4" or "e7e8q"; NX_ILLEGAL_MOVE unless
+// it names a legal move of the position
+NX_API nx_status nx_move_from_uci(const nx_position* position, const char* uci, nx_move* move);
+
+// Same contract as nx_position_fen; at most 6 bytes are ever needed
+NX_API size_t nx_move_to_uci(nx_move move, char* buffer, size_t size);
+
+// Checks legality first and leaves the position unchanged if illegal
+NX_API nx_status nx_do_move(nx_position* position, nx_move move);
+
+// Takes back the last move made with nx_do_move
+NX_API nx_status nx_undo_move(nx_position* position);
+
+// ----- Search -----
+
+typedef struct {
+    int max_depth;       // 0 for no limit
+    int max_time_ms;     // 0 for no limit
+    int max_nodes;       // 0 for no limit
+} nx_search_limits;
+
+typedef struct {
+    nx_move best_move;
+    int depth;
+    int seldepth;
+    int score;           // centipawns from the side to move's point of view
+    int mate;            // moves to mate, negative when mated, 0 if no mate was found
+    uint64_t nodes;
+    int time_ms;
+    const nx_move* pv;   // owned by the engine, valid until the next call on it
+    size_t pv_length;
+} nx_search_info;
+
+// Called after every completed iteration on the searching thread; a
+// non-zero return stops the search
+typedef int (*nx_iteration_callback)(const nx_search_info* info, void* user_data);
+
+// A search with its own transposition table of hash_mb megabytes, 16
+// when hash_mb is 0
+NX_API nx_status nx_engine_new(size_t hash_mb, nx_engine** engine);
+NX_API void nx_engine_free(nx_engine* engine);
+
+// Forgets the table and move ordering statistics, as for a new game
+NX_API void nx_engine_clear(nx_engine* engine);
+
+// Searches until a limit is reached or the search is stopped, then fills
+// result with the last completed iteration; the callback may be NULL.
+// best_move is 0 when the side to move has no legal move.
+NX_API nx_status nx_search(nx_engine* engine, const nx_position* position, const nx_search_limits* limits,
+                           nx_iteration_callback callback, void* user_data, nx_search_info* result);
+
+// Ends the search of the nx_search call in progress soon after, even if
+// that call is still setting up; a stop while no call is in progress is
+// ignored
+NX_API void nx_engine_stop(nx_engine* engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NEXUS_API_H
@@ -0,0 +1,130 @@
+#include "packed_position.hpp"
+#include "bitboard_utils.hpp"
+
+PackedPosition PackedPosition::pack(const Position& pos, Score score, GameOutcome result) {
+    PackedPosition packed = {};
+    packed.occupied = pos.pieces();
+    
+    Bitboard occupied = packed.occupied;
+    for (int i = 0; occupied; i++) {
+        Square sq = BitboardUtils::pop_lsb(occupied);
+        packed.pieces[i / 2] |= uint8_t(pos.piece_on(sq) << (4 * (i & 1)));
+    }
+    
+    packed.score = int16_t(std::clamp(score, -SCORE_MATE, SCORE_MATE));
+    packed.result = result;
+    packed.flags = uint8_t((pos.side_to_move() == BLACK) | (pos.castling() << 1));
+    packed.ep_square = uint8_t(pos.en_passant_square() < SQUARE_NB ? pos.en_passant_square() : SQUARE_NB);
+    packed.halfmove_clock = uint8_t(std::min(pos.halfmove_count(), 255));
+    packed.fullmove_number = uint16_t(std::min(pos.fullmove_count(), 65535));
+    return packed;
+}
+
+std::string PackedPosition::fen() const {
+    static const char piece_chars[] = "PNBRQKpnbrqk";
+    
+    Piece board[SQUARE_NB];
+    std::fill(board, board + SQUARE_NB, NO_PIECE);
+    
+    Bitboard bb = occupied;
+    for (int i = 0; bb && i < 32; i++) {
+        Square sq = BitboardUtils::pop_lsb(bb);
+        board[sq] = Piece((pieces[i / 2] >> (4 * (i & 1))) & 0xF);
+    }
+    
+    std::string result;
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            Piece piece = board[rank * 8 + file];
+            if (piece >= NO_PIECE) {
+                empty++;
+                continue;
+            }
+            if (empty) result += char('0' + empty);
+            empty = 0;
+            result += piece_chars[piece];
+        }
+        if (empty) result += char('0' + empty);
+        if (rank > 0) result += '/';
+    }
+    
+    result += (flags & 1) ? " b " : " w ";
+    
+    // Castling bits in Position's order: K, Q, k, q
+    int castling = flags >> 1;
+    size_t before = result.size();
+    for (int i = 0; i < 4; i++) {
+        if (castling & (1 << i)) result += "KQkq"[i];
+    }
+    if (result.size() == before) result += '-';
+    
+    if (ep_square < SQUARE_NB) {
+        result += ' ';
+        result += char('a' + ep_square % 8);
+        result += char('1' + ep_square / 8);
+    } else {
+        result += " -";
+    }
+    
+    result += ' ' + std::to_string(halfmove_clock) + ' ' + std::to_string(fullmove_number);
+    return result;
+}
+
+bool PackedPosition::unpack(Position& pos) const {
+    return pos.set_fen(fen());
+}
+
+PackedWriter::~PackedWriter() {
+    close();
+}
+
+bool PackedWriter::open(const std::string& path, bool append) {
+    close();
+    file = std::fopen(path.c_str(), append ? "ab" : "wb");
+    if (file) std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    return file != nullptr;
+}
+
+void PackedWriter::close() {
+    if (file) std::fclose(file);
+    file = nullptr;
+}
+
+bool PackedWriter::write(const std::vector<PackedPosition>& records) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!file) return false;
+    
+    size_t n = std::fwrite(records.data(), sizeof(PackedPosition), records.size(), file);
+    count += n;
+    return n == records.size();
+}
+
+PackedReader::~PackedReader() {
+    close();
+}
+
+bool PackedReader::open(const std::string& path) {
+    close();
+    file = std::fopen(path.c_str(), "rb");
+    buffer.resize(BUFFER_RECORDS);
+    position = filled = 0;
+    return file != nullptr;
+}
+
+void PackedReader::close() {
+    if (file) std::fclose(file);
+    file = nullptr;
+}
+
+bool PackedReader::next(PackedPosition& record) {
+    if (position == filled) {
+        if (!file) return false;
+        filled = std::fread(buffer.data(), sizeof(PackedPosition), buffer.size(), file);
+        position = 0;
+        if (filled == 0) return false;
+    }
+    
+    record = buffer[position++];
+    return true;
+}
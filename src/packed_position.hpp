@@ -0,0 +1,61 @@
+// ===== PACKED POSITIONS =====
+#include <cstdio>
+#include <mutex>
+
+enum GameOutcome : uint8_t { BLACK_WINS, DRAWN, WHITE_WINS };
+
+// One training sample in 32 bytes: the occupancy, then one nibble per
+// occupied square in a1..h8 order (at most 32 pieces), then the state.
+// The score is from the side to move's point of view, the result from
+// white's. Records have no file header, so files can be concatenated.
+struct PackedPosition {
+    uint64_t occupied;
+    uint8_t pieces[16];
+    int16_t score;
+    uint8_t result;         // GameOutcome
+    uint8_t flags;          // bit 0: black to move, bits 1-4: castling rights
+    uint8_t ep_square;      // SQUARE_NB when there is none
+    uint8_t halfmove_clock;
+    uint16_t fullmove_number;
+    
+    static PackedPosition pack(const Position& pos, Score score, GameOutcome result);
+    bool unpack(Position& pos) const;
+    std::string fen() const;
+};
+
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition should stay 32 bytes");
+
+// Appends records from any number of threads; each call writes a whole
+// batch so the records of one game stay together
+class PackedWriter {
+public:
+    ~PackedWriter();
+    
+    bool open(const std::string& path, bool append = false);
+    void close();
+    bool write(const std::vector<PackedPosition>& records);
+    uint64_t written() const { return count; }
+    
+private:
+    std::FILE* file = nullptr;
+    std::mutex mutex;
+    uint64_t count = 0;
+};
+
+// Streams records from a file through a fixed buffer
+class PackedReader {
+public:
+    ~PackedReader();
+    
+    bool open(const std::string& path);
+    void close();
+    bool next(PackedPosition& record);
+    
+private:
+    static constexpr size_t BUFFER_RECORDS = 1 << 15;
+    
+    std::FILE* file = nullptr;
+    std::vector<PackedPosition> buffer;
+    size_t position = 0;
+    size_t filled = 0;
+};
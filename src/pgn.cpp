@@ -0,0 +1,189 @@
+#include "pgn.hpp"
+#include "move_utils.hpp"
+#include <cstring>
+
+PGNReader::PGNReader(std::FILE* file)
+    : file(file), buffer(BUFFER_SIZE), begin(0), end(0), buffer_offset(0) {
+}
+
+// Moves the unread tail to the front of the buffer and reads more after it
+bool PGNReader::refill() {
+    if (begin < end) {
+        std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+    }
+    buffer_offset += begin;
+    end -= begin;
+    begin = 0;
+    
+    size_t read = std::fread(buffer.data() + end, 1, buffer.size() - end, file);
+    end += read;
+    return read > 0;
+}
+
+int PGNReader::peek() {
+    if (begin == end && !refill()) return EOF;
+    return (unsigned char)buffer[begin];
+}
+
+int PGNReader::get() {
+    if (begin == end && !refill()) return EOF;
+    return (unsigned char)buffer[begin++];
+}
+
+void PGNReader::skip_whitespace() {
+    int c;
+    while ((c = peek()) != EOF && (c == ' ' || c == '\t' || c == '\r' || c == '\n')) {
+        begin++;
+    }
+}
+
+void PGNReader::skip_until(char terminator) {
+    int c;
+    while ((c = get()) != EOF && c != terminator) {
+    }
+}
+
+// Recursive annotation variations, which may contain comments and further variations
+void PGNReader::skip_variation() {
+    int depth = 1;
+    int c;
+    
+    while (depth > 0 && (c = get()) != EOF) {
+        if (c == '(') depth++;
+        else if (c == ')') depth--;
+        else if (c == '{') skip_until('}');
+        else if (c == ';') skip_until('\n');
+    }
+}
+
+// [Name "Value"] -- only the FEN tag matters for replaying
+void PGNReader::read_tag() {
+    get(); // '['
+    skip_whitespace();
+    
+    size_t length = 0;
+    int c;
+    while ((c = peek()) != EOF && c != ' ' && c != '"' && c != ']') {
+        if (length < MAX_TOKEN) token[length++] = char(c);
+        begin++;
+    }
+    bool is_fen = std::string_view(token, length) == "FEN";
+    
+    while ((c = get()) != EOF && c != '"' && c != ']') {
+    }
+    
+    if (c == '"') {
+        if (is_fen) fen.clear();
+        
+        while ((c = get()) != EOF && c != '"') {
+            if (c == '\\') c = get();
+            if (is_fen && c != EOF) fen += char(c);
+        }
+        skip_until(']');
+    }
+}
+
+// Reads a movetext token into the token buffer and returns its length
+size_t PGNReader::read_token() {
+    size_t length = 0;
+    int c;
+    
+    while ((c = peek()) != EOF && !std::strchr(" \t\r\n{}()[];", c)) {
+        if (length < MAX_TOKEN) token[length++] = char(c);
+        begin++;
+    }
+    
+    token[length] = '\0';
+    return length;
+}
+
+bool PGNReader::parse_result(std::string_view text, GameResult& result) {
+    if (text == "1-0") result = WHITE_WINS;
+    else if (text == "0-1") result = BLACK_WINS;
+    else if (text == "1/2-1/2") result = DRAWN;
+    else if (text == "*") result = NO_RESULT;
+    else return false;
+    return true;
+}
+
+bool PGNReader::next_game(Game& game) {
+    game.result = NO_RESULT;
+    game.valid = true;
+    game.moves.clear();
+    game.keys.clear();
+    fen.clear();
+    
+    skip_whitespace();
+    if (peek() == EOF) return false;
+    
+    game.offset = offset();
+    
+    // Tag pair section
+    int c;
+    while ((c = peek()) == '[') {
+        read_tag();
+        skip_whitespace();
+    }
+    
+    if (fen.empty()) {
+        pos = start_position;
+    } else {
+        game.valid = pos.set_fen(fen);
+    }
+    game.keys.push_back(pos.key());
+    
+    // Movetext, up to the termination marker or the next game's tags
+    while (true) {
+        skip_whitespace();
+        c = peek();
+        
+        if (c == EOF || c == '[') break;
+        
+        if (c == '{') {
+            skip_until('}');
+            continue;
+        }
+        if (c == ';' || c == '%') {
+            skip_until('\n');
+            continue;
+        }
+        if (c == '(') {
+            begin++;
+            skip_variation();
+            continue;
+        }
+        if (c == ')' || c == '}' || c == ']') {
+            begin++;
+            continue;
+        }
+        
+        size_t length = read_token();
+        std::string_view text(token, length);
+        
+        if (parse_result(text, game.result)) break;
+        
+        // Numeric annotation glyphs
+        if (text[0] == '$') continue;
+        
+        // Move numbers, possibly glued to the move as in "12.e4" or "12...Nf6"
+        size_t i = 0;
+        while (i < text.size() && text[i] >= '0' && text[i] <= '9') i++;
+        if (i < text.size() && text[i] == '.') {
+            while (i < text.size() && text[i] == '.') i++;
+            text.remove_prefix(i);
+        }
+        if (text.empty() || !game.valid) continue;
+        
+        Move m = MoveUtils::from_san(text, pos);
+        if (MoveUtils::is_null(m)) {
+            game.valid = false;
+            continue;
+        }
+        
+        pos.do_move(m);
+        game.moves.push_back(m);
+        game.keys.push_back(pos.key());
+    }
+    
+    return true;
+}
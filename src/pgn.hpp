@@ -0,0 +1,51 @@
+// ===== PGN READER =====
+#include <cstdio>
+
+// Streams games out of a PGN file and replays them move by move. The
+// reader keeps one buffer, one Position and the caller's Game between
+// games, so once these have grown no allocation happens per move.
+class PGNReader {
+public:
+    enum GameResult { BLACK_WINS = -1, DRAWN = 0, WHITE_WINS = 1, NO_RESULT = 2 };
+    
+    struct Game {
+        uint64_t offset = 0;          // file offset of the game's first byte
+        GameResult result = NO_RESULT;
+        bool valid = true;            // false once a move failed to parse
+        std::vector<Move> moves;
+        std::vector<uint64_t> keys;   // key before each move, then of the final position
+    };
+    
+    explicit PGNReader(std::FILE* file);
+    
+    // Reads the next game; returns false at the end of the input
+    bool next_game(Game& game);
+    
+private:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+    static constexpr size_t MAX_TOKEN = 255;
+    
+    std::FILE* file;
+    std::vector<char> buffer;
+    size_t begin;
+    size_t end;
+    uint64_t buffer_offset;
+    
+    Position start_position;
+    Position pos;
+    std::string fen;
+    char token[MAX_TOKEN + 1];
+    
+    bool refill();
+    int peek();
+    int get();
+    uint64_t offset() const { return buffer_offset + begin; }
+    
+    void skip_whitespace();
+    void skip_until(char terminator);
+    void skip_variation();
+    void read_tag();
+    size_t read_token();
+    
+    static bool parse_result(std::string_view text, GameResult& result);
+};
@@ -1,8 +1,10 @@
 #include "position.hpp"
 #include "bitboard_utils.hpp"
-#include <sstream>
+#include "profiler.hpp"
 #include <cctype>
+#include <mutex>
 #include <random>
+#include <algorithm>
 
 // Zobrist hash keys for position hashing
 namespace {
@@ -11,12 +13,10 @@ namespace {
     uint64_t ep_keys[SQUARE_NB];
     uint64_t side_key;
     
-    bool zobrist_initialized = false;
+    std::once_flag zobrist_once;
     
-    void init_zobrist() {
-        if (zobrist_initialized) return;
-        
-        std::mt19937_64 rng(12345); // Fixed seed for reproducibility
+    void fill_zobrist() {
+        std::mt19937_64 rng(ZOBRIST_SEED); // Fixed seed for reproducibility
         
         // Initialize piece keys
         for (int piece = 0; piece < PIECE_NB; piece++) {
@@ -36,16 +36,14 @@ namespace {
         }
         
         side_key = rng();
-        zobrist_initialized = true;
+    }
+    
+    // Positions may be created on several threads at once
+    void init_zobrist() {
+        std::call_once(zobrist_once, fill_zobrist);
     }
 }
 
-// Castling rights constants
-constexpr int WHITE_OO = 1;
-constexpr int WHITE_OOO = 2;
-constexpr int BLACK_OO = 4;
-constexpr int BLACK_OOO = 8;
-
 Position::Position() {
     init_zobrist();
     set_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
@@ -56,32 +54,63 @@ Position::Position(const std::string& fen) {
     set_fen(fen);
 }
 
-void Position::set_fen(const std::string& fen) {
-    // Clear the board
-    for (int i = 0; i < SQUARE_NB; i++) {
-        board[i] = NO_PIECE;
+namespace {
+    // Splits off the next space-separated field without copying
+    std::string_view next_field(std::string_view& str) {
+        size_t start = str.find_first_not_of(" \t");
+        if (start == std::string_view::npos) {
+            str = std::string_view();
+            return str;
+        }
+        
+        size_t end = str.find_first_of(" \t", start);
+        if (end == std::string_view::npos) end = str.size();
+        
+        std::string_view field = str.substr(start, end - start);
+        str.remove_prefix(end);
+        return field;
     }
     
-    for (int c = 0; c < COLOR_NB; c++) {
-        by_color[c] = 0ULL;
+    // Move counters are optional (EPD has none), so anything that is not a
+    // plain number leaves the default in place
+    int parse_counter(std::string_view field, int default_value) {
+        if (field.empty()) return default_value;
+        
+        int value = 0;
+        for (char c : field) {
+            if (c < '0' || c > '9') return default_value;
+            value = value * 10 + (c - '0');
+        }
+        return value;
     }
-    
-    for (int pt = 0; pt < PIECE_TYPE_NB; pt++) {
-        by_type[pt] = 0ULL;
+}
+
+// Parses FEN (or the first four fields of an EPD line) in place, without
+// allocating. Returns false when the board field is malformed.
+bool Position::set_fen(std::string_view fen) {
+    // Clear the board
+    for (int i = 0; i < SQUARE_NB; i++) {
+        board[i] = NO_PIECE;
     }
     
-    std::istringstream ss(fen);
-    std::string board_str, side_str, castling_str, ep_str, halfmove_str, fullmove_str;
+    previous_states.clear();
     
-    ss >> board_str >> side_str >> castling_str >> ep_str >> halfmove_str >> fullmove_str;
+    std::string_view board_str = next_field(fen);
+    std::string_view side_str = next_field(fen);
+    std::string_view castling_str = next_field(fen);
+    std::string_view ep_str = next_field(fen);
+    std::string_view halfmove_str = next_field(fen);
+    std::string_view fullmove_str = next_field(fen);
     
     // Parse board position
+    bool valid = true;
     int rank = 7, file = 0;
     for (char c : board_str) {
         if (c == '/') {
+            valid &= file == 8;
             rank--;
             file = 0;
-        } else if (std::isdigit(c)) {
+        } else if (c >= '1' && c <= '8') {
             file += c - '0';
         } else {
             Piece piece = NO_PIECE;
@@ -94,16 +123,25 @@ void Position::set_fen(const std::string& fen) {
                 case 'k': piece = std::isupper(c) ? W_KING : B_KING; break;
             }
             
-            if (piece != NO_PIECE) {
-                Square sq = rank * 8 + file;
-                board[sq] = piece;
-                file++;
+            if (piece == NO_PIECE || rank < 0 || file >= 8) {
+                valid = false;
+                break;
             }
+            
+            Square sq = rank * 8 + file;
+            board[sq] = piece;
+            file++;
+        }
+        
+        if (rank < 0 || file > 8) {
+            valid = false;
+            break;
         }
     }
+    valid &= rank == 0 && file == 8;
     
     // Parse side to move
-    stm = (side_str == "w") ? WHITE : BLACK;
+    stm = (side_str == "b") ? BLACK : WHITE;
     
     // Parse castling rights
     castling_rights = 0;
@@ -118,7 +156,7 @@ void Position::set_fen(const std::string& fen) {
     
     // Parse en passant square
     ep_square = SQUARE_NB;
-    if (ep_str != "-" && ep_str.length() == 2) {
+    if (ep_str.length() == 2) {
         int file = ep_str[0] - 'a';
         int rank = ep_str[1] - '1';
         if (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
@@ -127,11 +165,16 @@ void Position::set_fen(const std::string& fen) {
     }
     
     // Parse move counters
-    halfmove_clock = halfmove_str.empty() ? 0 : std::stoi(halfmove_str);
-    fullmove_number = fullmove_str.empty() ? 1 : std::stoi(fullmove_str);
+    halfmove_clock = parse_counter(halfmove_str, 0);
+    fullmove_number = parse_counter(fullmove_str, 1);
     
     update_bitboards();
     calculate_hash();
+    
+    valid &= BitboardUtils::popcount(pieces(WHITE, KING)) == 1
+          && BitboardUtils::popcount(pieces(BLACK, KING)) == 1;
+    
+    return valid;
 }
 
 std::string Position::fen() const {
@@ -231,12 +274,18 @@ void Position::update_bitboards() {
 
 void Position::calculate_hash() {
     hash_key = 0ULL;
+    material_hash = 0ULL;
+    
+    for (int pc = 0; pc < PIECE_NB; pc++) {
+        piece_counts[pc] = 0;
+    }
     
     // Hash pieces
     for (Square sq = A1; sq <= H8; ++sq) {
         Piece piece = board[sq];
         if (piece != NO_PIECE) {
             hash_key ^= piece_keys[piece][sq];
+            add_material(piece);
         }
     }
     
@@ -254,9 +303,36 @@ void Position::calculate_hash() {
     }
 }
 
+// The material key has the piece key of (piece, n) for the n-th piece of
+// each kind, so a capture or promotion changes it by one or two keys
+void Position::add_material(Piece pc) {
+    material_hash ^= piece_keys[pc][piece_counts[pc]++];
+}
+
+void Position::remove_material(Piece pc) {
+    material_hash ^= piece_keys[pc][--piece_counts[pc]];
+}
+
+Square Position::king_square(Color c) const {
+    return BitboardUtils::lsb(pieces(c, KING));
+}
+
 bool Position::in_check() const {
-    Square king_sq = BitboardUtils::lsb(pieces(stm, KING));
-    return is_attacked_by(king_sq, Color(stm ^ 1));
+    return is_attacked_by(king_square(stm), Color(stm ^ 1));
+}
+
+Bitboard Position::checkers() const {
+    return attackers_to(king_square(stm), pieces()) & pieces(Color(stm ^ 1));
+}
+
+// All pieces of both colors attacking a square, given an occupancy for the sliders
+Bitboard Position::attackers_to(Square s, Bitboard occupied) const {
+    return (BitboardUtils::get_pawn_attacks(s, BLACK) & pieces(WHITE, PAWN))
+         | (BitboardUtils::get_pawn_attacks(s, WHITE) & pieces(BLACK, PAWN))
+         | (BitboardUtils::get_knight_attacks(s) & by_type[KNIGHT])
+         | (BitboardUtils::get_king_attacks(s) & by_type[KING])
+         | (BitboardUtils::get_rook_attacks(s, occupied) & (by_type[ROOK] | by_type[QUEEN]))
+         | (BitboardUtils::get_bishop_attacks(s, occupied) & (by_type[BISHOP] | by_type[QUEEN]));
 }
 
 bool Position::is_attacked_by(Square sq, Color attacking_color) const {
@@ -292,9 +368,11 @@ bool Position::is_attacked_by(Square sq, Color attacking_color) const {
 }
 
 void Position::do_move(Move m) {
+    ScopedTimer timer(PROFILE_DO_MOVE);
+    
     // Store previous state for undo
     previous_states.push_back({
-        ep_square, castling_rights, halfmove_clock, hash_key, board[MoveUtils::to_sq(m)]
+        ep_square, castling_rights, halfmove_clock, hash_key, material_hash, board[MoveUtils::to_sq(m)]
     });
     
     Square from = MoveUtils::from_sq(m);
@@ -309,6 +387,7 @@ void Position::do_move(Move m) {
     // Update hash for captured piece
     if (captured_piece != NO_PIECE) {
         hash_key ^= piece_keys[captured_piece][to];
+        remove_material(captured_piece);
     }
     
     // Move the piece
@@ -324,6 +403,8 @@ void Position::do_move(Move m) {
         // Update hash for promotion
         hash_key ^= piece_keys[moving_piece][to];
         hash_key ^= piece_keys[promotion_piece][to];
+        remove_material(moving_piece);
+        add_material(promotion_piece);
     }
     
     if (MoveUtils::is_castling(m)) {
@@ -356,6 +437,7 @@ void Position::do_move(Move m) {
         Piece captured_pawn = board[captured_pawn_sq];
         board[captured_pawn_sq] = NO_PIECE;
         hash_key ^= piece_keys[captured_pawn][captured_pawn_sq];
+        remove_material(captured_pawn);
     }
     
     // Update castling rights
@@ -375,7 +457,9 @@ void Position::do_move(Move m) {
     hash_key ^= castling_keys[castling_rights];
     
     // Update en passant square
-    hash_key ^= ep_keys[ep_square];
+    if (ep_square < SQUARE_NB) {
+        hash_key ^= ep_keys[ep_square];
+    }
     ep_square = SQUARE_NB;
     
     if ((moving_piece == W_PAWN || moving_piece == B_PAWN) && abs(to - from) == 16) {
@@ -405,6 +489,8 @@ void Position::do_move(Move m) {
 }
 
 void Position::undo_move(Move m) {
+    ScopedTimer timer(PROFILE_UNDO_MOVE);
+    
     if (previous_states.empty()) return;
     
     auto& prev_state = previous_states.back();
@@ -418,13 +504,20 @@ void Position::undo_move(Move m) {
     
     // Handle promotion undo
     if (MoveUtils::is_promotion(m)) {
+        piece_counts[moving_piece]--;
         moving_piece = (stm == WHITE) ? W_PAWN : B_PAWN;
+        piece_counts[moving_piece]++;
     }
     
     // Move piece back
     board[from] = moving_piece;
     board[to] = prev_state.captured_piece;
     
+    // Counts only; the material key is restored with the others below
+    if (prev_state.captured_piece != NO_PIECE) {
+        piece_counts[prev_state.captured_piece]++;
+    }
+    
     // Handle special moves
     if (MoveUtils::is_castling(m)) {
         if (to == G1) { // White kingside
@@ -445,6 +538,7 @@ void Position::undo_move(Move m) {
     if (MoveUtils::is_en_passant(m)) {
         Square captured_pawn_sq = stm == WHITE ? (to - 8) : (to + 8);
         board[captured_pawn_sq] = (stm == WHITE) ? B_PAWN : W_PAWN;
+        piece_counts[stm == WHITE ? B_PAWN : W_PAWN]++;
     }
     
     // Restore previous state
@@ -452,6 +546,7 @@ void Position::undo_move(Move m) {
     castling_rights = prev_state.castling_rights;
     halfmove_clock = prev_state.halfmove_clock;
     hash_key = prev_state.hash_key;
+    material_hash = prev_state.material_hash;
     
     if (stm == BLACK) {
         fullmove_number--;
@@ -461,6 +556,125 @@ void Position::undo_move(Move m) {
     update_bitboards();
 }
 
+// Has the current position occurred before since the last irreversible move?
+// Only positions with the same side to move are compared.
+bool Position::is_repetition() const {
+    int n = int(previous_states.size());
+    int limit = std::min(halfmove_clock, n);
+    
+    for (int i = 2; i <= limit; i += 2) {
+        if (previous_states[n - i].hash_key == hash_key) return true;
+    }
+    
+    return false;
+}
+
+void Position::do_null_move() {
+    previous_states.push_back({
+        ep_square, castling_rights, halfmove_clock, hash_key, material_hash, NO_PIECE
+    });
+    
+    if (ep_square < SQUARE_NB) {
+        hash_key ^= ep_keys[ep_square];
+        ep_square = SQUARE_NB;
+    }
+    
+    halfmove_clock++;
+    hash_key ^= side_key;
+    stm = Color(stm ^ 1);
+}
+
+void Position::undo_null_move() {
+    if (previous_states.empty()) return;
+    
+    auto& prev_state = previous_states.back();
+    
+    stm = Color(stm ^ 1);
+    ep_square = prev_state.ep_square;
+    halfmove_clock = prev_state.halfmove_clock;
+    hash_key = prev_state.hash_key;
+    
+    previous_states.pop_back();
+}
+
+bool Position::has_non_pawn_material(Color c) const {
+    return pieces(c) & ~pieces(PAWN) & ~pieces(KING);
+}
+
+Position::CheckInfo Position::check_info() const {
+    CheckInfo ci;
+    Color them = Color(stm ^ 1);
+    Square king_sq = king_square(them);
+    Bitboard occupied = pieces();
+    
+    ci.king_sq = king_sq;
+    ci.check_squares[PAWN] = BitboardUtils::get_pawn_attacks(king_sq, them);
+    ci.check_squares[KNIGHT] = BitboardUtils::get_knight_attacks(king_sq);
+    ci.check_squares[BISHOP] = BitboardUtils::get_bishop_attacks(king_sq, occupied);
+    ci.check_squares[ROOK] = BitboardUtils::get_rook_attacks(king_sq, occupied);
+    ci.check_squares[QUEEN] = ci.check_squares[BISHOP] | ci.check_squares[ROOK];
+    ci.check_squares[KING] = 0ULL;
+    
+    // Our sliders that would see the king with one of our own pieces removed
+    Bitboard snipers = (BitboardUtils::get_rook_attacks(king_sq, 0ULL) & (pieces(stm, ROOK) | pieces(stm, QUEEN)))
+                     | (BitboardUtils::get_bishop_attacks(king_sq, 0ULL) & (pieces(stm, BISHOP) | pieces(stm, QUEEN)));
+    ci.discoverers = 0ULL;
+    
+    while (snipers) {
+        Bitboard line = BitboardUtils::between_squares(king_sq, BitboardUtils::pop_lsb(snipers)) & occupied;
+        if (line && !(line & (line - 1)) && (line & pieces(stm))) {
+            ci.discoverers |= line;
+        }
+    }
+    
+    return ci;
+}
+
+// A normal move checks directly when it lands on a check square of its
+// piece: the moved piece, still on its origin, cannot be in the way of a
+// line through its destination. Promotions, en passant and castling look
+// at the board after the move.
+bool Position::gives_check(Move m, const CheckInfo& ci) const {
+    Square from = MoveUtils::from_sq(m);
+    Square to = MoveUtils::to_sq(m);
+    Bitboard king_bb = BitboardUtils::square_bb(ci.king_sq);
+    
+    if (MoveUtils::is_castling(m)) {
+        Square rook_from = to > from ? from + 3 : from - 4;
+        Square rook_to = to > from ? from + 1 : from - 1;
+        Bitboard occupied = (pieces() ^ BitboardUtils::square_bb(from) ^ BitboardUtils::square_bb(rook_from))
+                          | BitboardUtils::square_bb(to) | BitboardUtils::square_bb(rook_to);
+        return BitboardUtils::get_rook_attacks(rook_to, occupied) & king_bb;
+    }
+    
+    Bitboard occupied = (pieces() ^ BitboardUtils::square_bb(from)) | BitboardUtils::square_bb(to);
+    
+    if (MoveUtils::is_promotion(m)) {
+        Bitboard attacks = 0ULL;
+        switch (MoveUtils::promotion_type(m)) {
+            case KNIGHT: attacks = BitboardUtils::get_knight_attacks(to); break;
+            case BISHOP: attacks = BitboardUtils::get_bishop_attacks(to, occupied); break;
+            case ROOK: attacks = BitboardUtils::get_rook_attacks(to, occupied); break;
+            default: attacks = BitboardUtils::get_queen_attacks(to, occupied); break;
+        }
+        if (attacks & king_bb) return true;
+    } else if (ci.check_squares[board[from] % 6] & BitboardUtils::square_bb(to)) {
+        return true;
+    }
+    
+    // Discovered check, by leaving a line to the king or by removing the
+    // pawn taken en passant from one
+    if (!(ci.discoverers & BitboardUtils::square_bb(from)) && !MoveUtils::is_en_passant(m)) return false;
+    
+    if (MoveUtils::is_en_passant(m)) {
+        occupied ^= BitboardUtils::square_bb(to + (stm == WHITE ? -8 : 8));
+    }
+    
+    Bitboard sliders = pieces(stm) & ~BitboardUtils::square_bb(to);
+    return (BitboardUtils::get_rook_attacks(ci.king_sq, occupied) & sliders & (pieces(ROOK) | pieces(QUEEN)))
+         | (BitboardUtils::get_bishop_attacks(ci.king_sq, occupied) & sliders & (pieces(BISHOP) | pieces(QUEEN)));
+}
+
 bool Position::is_legal(Move m) const {
     // Quick check for basic validity
     Square from = MoveUtils::from_sq(m);
@@ -474,12 +688,29 @@ bool Position::is_legal(Move m) const {
     Color piece_color = (moving_piece < B_PAWN) ? WHITE : BLACK;
     if (piece_color != stm) return false;
     
-    // Check if move leaves king in check
-    Position temp = *this;
-    temp.do_move(m);
+    Color them = Color(stm ^ 1);
+    
+    // The king may not castle out of, through or into check
+    if (MoveUtils::is_castling(m)) {
+        int step = to > from ? 1 : -1;
+        for (Square s = from; s != to + step; s += step) {
+            if (is_attacked_by(s, them)) return false;
+        }
+        return true;
+    }
+    
+    // Check if move leaves king in check, using the occupancy after the move
+    // instead of copying the position and making it
+    Bitboard occupied = (pieces() ^ BitboardUtils::square_bb(from)) | BitboardUtils::square_bb(to);
+    Bitboard captured = BitboardUtils::square_bb(to);
+    
+    if (MoveUtils::is_en_passant(m)) {
+        Square captured_pawn_sq = stm == WHITE ? (to - 8) : (to + 8);
+        occupied ^= BitboardUtils::square_bb(captured_pawn_sq);
+        captured |= BitboardUtils::square_bb(captured_pawn_sq);
+    }
+    
+    Square king_sq = (moving_piece == W_KING || moving_piece == B_KING) ? to : king_square(stm);
     
-    return !temp.is_attacked_by(
-        BitboardUtils::lsb(temp.pieces(stm, KING)), 
-        Color(stm ^ 1)
-    );
+    return !(attackers_to(king_sq, occupied) & pieces(them) & ~captured);
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 // ===== POSITION CLASS =====
 #include <vector>
+#include <string_view>
 
 class Position {
 public:
@@ -12,24 +13,56 @@ public:
     Bitboard pieces(Color c) const { return by_color[c]; }
     Bitboard pieces(PieceType pt) const { return by_type[pt]; }
     Bitboard pieces(Color c, PieceType pt) const { return by_color[c] & by_type[pt]; }
+    Bitboard pieces() const { return by_color[WHITE] | by_color[BLACK]; }
+    Square king_square(Color c) const;
+    Square en_passant_square() const { return ep_square; }
+    int halfmove_count() const { return halfmove_clock; }
+    int fullmove_count() const { return fullmove_number; }
+    int castling() const { return castling_rights; }
     
     // Position manipulation
     void do_move(Move m);
     void undo_move(Move m);
-    void set_fen(const std::string& fen);
+    void do_null_move();
+    void undo_null_move();
+    bool set_fen(std::string_view fen);
     std::string fen() const;
     
     // Game state
     bool in_check() const;
+    Bitboard checkers() const;
+    Bitboard attackers_to(Square s, Bitboard occupied) const;
     bool is_legal(Move m) const;
+    bool is_repetition() const;
+    bool has_non_pawn_material(Color c) const;
     uint64_t key() const { return hash_key; }
     
+    // Hash of the piece counts alone, kept up to date by do_move
+    uint64_t material_key() const { return material_hash; }
+    int count(Piece pc) const { return piece_counts[pc]; }
+    
+    // What a move of the side to move needs in order to check the enemy
+    // king: the squares each piece type checks it from, and our pieces
+    // that are the only blocker between it and one of our sliders
+    struct CheckInfo {
+        Square king_sq;
+        Bitboard check_squares[PIECE_TYPE_NB];
+        Bitboard discoverers;
+    };
+    
+    CheckInfo check_info() const;
+    
+    // Whether a pseudo-legal move checks the enemy king, without making it
+    bool gives_check(Move m, const CheckInfo& ci) const;
+    bool gives_check(Move m) const { return gives_check(m, check_info()); }
+    
 private:
     struct UndoInfo {
         Square ep_square;
         int castling_rights;
         int halfmove_clock;
         uint64_t hash_key;
+        uint64_t material_hash;
         Piece captured_piece;
     };
 
@@ -42,11 +75,15 @@ private:
     int halfmove_clock;
     int fullmove_number;
     uint64_t hash_key;
+    uint64_t material_hash;
+    int piece_counts[PIECE_NB];
     std::vector<UndoInfo> previous_states;
     bool is_attacked_by(Square sq, Color attacking_color) const;
     
     void update_bitboards();
     void calculate_hash();
+    void add_material(Piece pc);
+    void remove_material(Piece pc);
 
 };
 
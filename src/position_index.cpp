@@ -0,0 +1,299 @@
+#include "position_index.hpp"
+#include "move_utils.hpp"
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    constexpr char INDEX_MAGIC[8] = {'N', 'X', 'P', 'O', 'S', 'I', 'D', 'X'};
+    constexpr size_t MERGE_BUFFER_RECORDS = 1 << 16;
+    
+    bool record_less(const IndexRecord& a, const IndexRecord& b) {
+        return a.key < b.key || (a.key == b.key && a.game < b.game);
+    }
+    
+    // Buffered sequential reader over one sorted run
+    struct RunReader {
+        std::FILE* file;
+        std::vector<IndexRecord> buffer;
+        size_t next = 0;
+        size_t size = 0;
+        
+        bool advance() {
+            if (++next < size) return true;
+            size = std::fread(buffer.data(), sizeof(IndexRecord), buffer.size(), file);
+            next = 0;
+            return size > 0;
+        }
+        
+        const IndexRecord& current() const { return buffer[next]; }
+    };
+}
+
+PositionIndexBuilder::PositionIndexBuilder(const std::string& path, size_t memory_mb)
+    : path(path), max_records(std::max<size_t>(1, memory_mb * 1024 * 1024 / sizeof(IndexRecord))) {
+    records.reserve(std::min<size_t>(max_records, 1 << 20));
+}
+
+void PositionIndexBuilder::add_game(const PGNReader::Game& game) {
+    uint32_t id = uint32_t(game_offsets.size());
+    game_offsets.push_back(game.offset);
+    
+    for (size_t i = 0; i < game.keys.size(); i++) {
+        Move next = i < game.moves.size() ? game.moves[i] : MoveUtils::null_move();
+        records.push_back({game.keys[i], id, next, int8_t(game.result), 0});
+        
+        if (records.size() >= max_records) flush_run();
+    }
+}
+
+bool PositionIndexBuilder::flush_run() {
+    if (records.empty()) return true;
+    
+    std::sort(records.begin(), records.end(), record_less);
+    
+    std::string run_path = path + ".run" + std::to_string(run_paths.size());
+    std::FILE* run = std::fopen(run_path.c_str(), "wb");
+    if (!run) return false;
+    
+    bool ok = std::fwrite(records.data(), sizeof(IndexRecord), records.size(), run) == records.size();
+    ok &= std::fclose(run) == 0;
+    
+    run_paths.push_back(run_path);
+    records.clear();
+    return ok;
+}
+
+bool PositionIndexBuilder::finish() {
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out) return false;
+    
+    bool ok = true;
+    std::vector<std::FILE*> runs;
+    
+    // Everything fit in memory: no runs needed
+    if (run_paths.empty()) {
+        std::sort(records.begin(), records.end(), record_less);
+    } else {
+        ok &= flush_run();
+        for (const std::string& run_path : run_paths) {
+            std::FILE* run = std::fopen(run_path.c_str(), "rb");
+            if (!run) ok = false;
+            else runs.push_back(run);
+        }
+    }
+    
+    ok = ok && write_index(out, runs);
+    ok &= std::fclose(out) == 0;
+    
+    for (std::FILE* run : runs) {
+        std::fclose(run);
+    }
+    for (const std::string& run_path : run_paths) {
+        std::remove(run_path.c_str());
+    }
+    run_paths.clear();
+    records.clear();
+    
+    return ok;
+}
+
+// Writes the header, the records (from memory, or merged from the runs),
+// the block keys and the game offsets
+bool PositionIndexBuilder::write_index(std::FILE* out, const std::vector<std::FILE*>& runs) {
+    IndexHeader header = {};
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = PositionIndex::VERSION;
+    header.block_records = PositionIndex::BLOCK_RECORDS;
+    header.game_count = game_offsets.size();
+    
+    bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1;
+    std::vector<uint64_t> block_keys;
+    
+    auto emit = [&](const IndexRecord& record) {
+        if (header.record_count % PositionIndex::BLOCK_RECORDS == 0) {
+            block_keys.push_back(record.key);
+        }
+        header.record_count++;
+        ok &= std::fwrite(&record, sizeof(record), 1, out) == 1;
+    };
+    
+    if (runs.empty()) {
+        for (const IndexRecord& record : records) {
+            emit(record);
+        }
+    } else {
+        // K-way merge of the sorted runs
+        std::vector<RunReader> readers(runs.size());
+        auto greater = [&](size_t a, size_t b) {
+            return record_less(readers[b].current(), readers[a].current());
+        };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+        
+        for (size_t i = 0; i < runs.size(); i++) {
+            readers[i].file = runs[i];
+            readers[i].buffer.resize(MERGE_BUFFER_RECORDS);
+            readers[i].next = 0;
+            readers[i].size = 0;
+            if (readers[i].advance()) heap.push(i);
+        }
+        
+        while (!heap.empty()) {
+            size_t i = heap.top();
+            heap.pop();
+            emit(readers[i].current());
+            if (readers[i].advance()) heap.push(i);
+        }
+    }
+    
+    header.block_count = block_keys.size();
+    ok &= std::fwrite(block_keys.data(), sizeof(uint64_t), block_keys.size(), out) == block_keys.size();
+    ok &= std::fwrite(game_offsets.data(), sizeof(uint64_t), game_offsets.size(), out) == game_offsets.size();
+    
+    // Now that the counts are known
+    ok &= std::fseek(out, 0, SEEK_SET) == 0;
+    ok &= std::fwrite(&header, sizeof(header), 1, out) == 1;
+    
+    return ok;
+}
+
+PositionIndex::PositionIndex()
+    : data(nullptr), length(0), header(nullptr), records(nullptr), block_keys(nullptr), game_offsets(nullptr) {
+}
+
+PositionIndex::~PositionIndex() {
+    close();
+}
+
+bool PositionIndex::open(const std::string& path) {
+    close();
+    
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(IndexHeader)) {
+        ::close(fd);
+        return false;
+    }
+    
+    length = size_t(st.st_size);
+    data = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    
+    if (data == MAP_FAILED) {
+        data = nullptr;
+        return false;
+    }
+    
+    // Lookups are random: don't read ahead
+    madvise(data, length, MADV_RANDOM);
+    
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    header = reinterpret_cast<const IndexHeader*>(bytes);
+    
+    size_t expected = sizeof(IndexHeader) + header->record_count * sizeof(IndexRecord)
+                    + (header->block_count + header->game_count) * sizeof(uint64_t);
+    
+    if (std::memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0
+        || header->version != VERSION || header->block_records != BLOCK_RECORDS || length != expected) {
+        close();
+        return false;
+    }
+    
+    records = reinterpret_cast<const IndexRecord*>(bytes + sizeof(IndexHeader));
+    block_keys = reinterpret_cast<const uint64_t*>(records + header->record_count);
+    game_offsets = block_keys + header->block_count;
+    
+    return true;
+}
+
+void PositionIndex::close() {
+    if (data) munmap(data, length);
+    
+    data = nullptr;
+    length = 0;
+    header = nullptr;
+    records = nullptr;
+    block_keys = nullptr;
+    game_offsets = nullptr;
+}
+
+// The records of one key, located through the block keys first
+std::pair<const IndexRecord*, const IndexRecord*> PositionIndex::find(uint64_t key) const {
+    if (!header || header->record_count == 0) return {nullptr, nullptr};
+    
+    const uint64_t* blocks_end = block_keys + header->block_count;
+    
+    // A run of equal keys can start in the block before the first one starting with the key
+    size_t first_block = std::lower_bound(block_keys, blocks_end, key) - block_keys;
+    if (first_block > 0) first_block--;
+    size_t last_block = std::upper_bound(block_keys, blocks_end, key) - block_keys;
+    
+    const IndexRecord* lo = records + first_block * BLOCK_RECORDS;
+    const IndexRecord* hi = records + std::min<uint64_t>(uint64_t(last_block) * BLOCK_RECORDS, header->record_count);
+    
+    auto key_less = [](const IndexRecord& r, uint64_t k) { return r.key < k; };
+    auto less_key = [](uint64_t k, const IndexRecord& r) { return k < r.key; };
+    
+    lo = std::lower_bound(lo, hi, key, key_less);
+    hi = std::upper_bound(lo, hi, key, less_key);
+    return {lo, hi};
+}
+
+PositionIndex::Stats PositionIndex::stats(uint64_t key) const {
+    Stats stats;
+    auto [lo, hi] = find(key);
+    
+    uint32_t last_game = UINT32_MAX;
+    
+    for (const IndexRecord* r = lo; r != hi; r++) {
+        // Games that pass through the position twice count once
+        if (r->game != last_game) {
+            last_game = r->game;
+            stats.games++;
+            stats.white_wins += r->result == PGNReader::WHITE_WINS;
+            stats.draws += r->result == PGNReader::DRAWN;
+            stats.black_wins += r->result == PGNReader::BLACK_WINS;
+        }
+        
+        if (MoveUtils::is_null(r->next_move)) continue;
+        
+        auto it = std::find_if(stats.moves.begin(), stats.moves.end(),
+                               [&](const MoveStats& ms) { return ms.move == r->next_move; });
+        if (it == stats.moves.end()) {
+            stats.moves.push_back({r->next_move, 0, 0, 0, 0});
+            it = stats.moves.end() - 1;
+        }
+        
+        it->count++;
+        it->white_wins += r->result == PGNReader::WHITE_WINS;
+        it->draws += r->result == PGNReader::DRAWN;
+        it->black_wins += r->result == PGNReader::BLACK_WINS;
+    }
+    
+    std::sort(stats.moves.begin(), stats.moves.end(),
+              [](const MoveStats& a, const MoveStats& b) { return a.count > b.count; });
+    
+    return stats;
+}
+
+// File offsets of up to max_games games that reached the position
+std::vector<uint64_t> PositionIndex::games(uint64_t key, size_t max_games) const {
+    std::vector<uint64_t> offsets;
+    auto [lo, hi] = find(key);
+    
+    uint32_t last_game = UINT32_MAX;
+    
+    for (const IndexRecord* r = lo; r != hi && offsets.size() < max_games; r++) {
+        if (r->game == last_game) continue;
+        last_game = r->game;
+        offsets.push_back(game_offsets[r->game]);
+    }
+    
+    return offsets;
+}
@@ -0,0 +1,90 @@
+// ===== POSITION INDEX =====
+#include "pgn.hpp"
+
+// On-disk map from Position::key() to the games that reached the position.
+// File layout: IndexHeader, IndexRecord[record_count] sorted by (key, game),
+// the first key of every block of BLOCK_RECORDS records, and the file
+// offset of every game. Queries mmap the file and touch one block-key page
+// and one or two record pages.
+
+struct IndexRecord {
+    uint64_t key;
+    uint32_t game;      // index into the game offset table
+    Move next_move;     // move played from the position, null at the end of the game
+    int8_t result;      // PGNReader::GameResult
+    uint8_t reserved;
+};
+
+static_assert(sizeof(IndexRecord) == 16, "IndexRecord should stay 16 bytes");
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_records;
+    uint64_t record_count;
+    uint64_t block_count;
+    uint64_t game_count;
+};
+
+// Collects records in memory, spills sorted runs to disk when the memory
+// budget is used up and merges the runs into the final file
+class PositionIndexBuilder {
+public:
+    PositionIndexBuilder(const std::string& path, size_t memory_mb);
+    
+    void add_game(const PGNReader::Game& game);
+    bool finish();
+    
+    uint64_t games() const { return game_offsets.size(); }
+    
+private:
+    std::string path;
+    size_t max_records;
+    std::vector<IndexRecord> records;
+    std::vector<uint64_t> game_offsets;
+    std::vector<std::string> run_paths;
+    
+    bool flush_run();
+    bool write_index(std::FILE* out, const std::vector<std::FILE*>& runs);
+};
+
+class PositionIndex {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t BLOCK_RECORDS = 256; // one 4 KB page
+    
+    struct MoveStats {
+        Move move;
+        uint32_t count;
+        uint32_t white_wins;
+        uint32_t draws;
+        uint32_t black_wins;
+    };
+    
+    struct Stats {
+        uint32_t games = 0;
+        uint32_t white_wins = 0;
+        uint32_t draws = 0;
+        uint32_t black_wins = 0;
+        std::vector<MoveStats> moves;
+    };
+    
+    PositionIndex();
+    ~PositionIndex();
+    
+    bool open(const std::string& path);
+    void close();
+    
+    Stats stats(uint64_t key) const;
+    std::vector<uint64_t> games(uint64_t key, size_t max_games) const;
+    
+private:
+    void* data;
+    size_t length;
+    const IndexHeader* header;
+    const IndexRecord* records;
+    const uint64_t* block_keys;
+    const uint64_t* game_offsets;
+    
+    std::pair<const IndexRecord*, const IndexRecord*> find(uint64_t key) const;
+};
@@ -0,0 +1,61 @@
+#include "profiler.hpp"
+#include <cstring>
+#include <algorithm>
+
+thread_local ProfileBuckets ProfileBuckets::local;
+
+void ProfileBuckets::clear() {
+    std::memset(this, 0, sizeof(ProfileBuckets));
+}
+
+const char* ProfileBuckets::site_name(ProfileSite site) {
+    static const char* names[PROFILE_SITE_NB] = {
+        "movegen", "do_move", "undo_move", "evaluate", "tt_probe", "tt_store", "order_moves"
+    };
+    return names[site];
+}
+
+// Cycles one ScopedTimer adds, measured once with empty timed scopes
+double ProfileBuckets::timer_overhead() {
+    static const double overhead = [] {
+        constexpr int SAMPLES = 100000;
+        ProfileBuckets saved = local;
+        
+        uint64_t start = now();
+        for (int i = 0; i < SAMPLES; i++) {
+            ScopedTimer timer(PROFILE_MOVEGEN);
+        }
+        uint64_t elapsed = now() - start;
+        
+        local = saved;
+        return double(elapsed) / SAMPLES;
+    }();
+    return overhead;
+}
+
+// Share of the search spent in each site, plus the timers' own cost
+void ProfileBuckets::write_info(std::ostream& out) const {
+    uint64_t timed = 0;
+    uint64_t calls_total = 0;
+    for (int s = 0; s < PROFILE_SITE_NB; s++) {
+        timed += cycles[s];
+        calls_total += calls[s];
+    }
+    
+    double total = double(std::max<uint64_t>(total_cycles, 1));
+    
+    out << "info string profile cycles " << total_cycles;
+    for (int s = 0; s < PROFILE_SITE_NB; s++) {
+        out << ' ' << site_name(ProfileSite(s)) << ' ' << 100.0 * cycles[s] / total << '%';
+    }
+    out << " other " << 100.0 * (total_cycles > timed ? total_cycles - timed : 0) / total << '%' << "\n";
+    
+    out << "info string profile calls";
+    for (int s = 0; s < PROFILE_SITE_NB; s++) {
+        out << ' ' << site_name(ProfileSite(s)) << ' ' << calls[s]
+            << " (" << (calls[s] ? cycles[s] / calls[s] : 0) << " cycles)";
+    }
+    out << "\n";
+    
+    out << "info string profile overhead " << 100.0 * calls_total * timer_overhead() / total << '%' << std::endl;
+}
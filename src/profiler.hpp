@@ -0,0 +1,72 @@
+// ===== PROFILER =====
+#include <cstdint>
+#include <ostream>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// Build with -DSEARCH_PROFILE to time the hot paths below. Without it
+// ScopedTimer is empty and compiles away.
+#ifdef SEARCH_PROFILE
+constexpr bool SEARCH_PROFILE_ENABLED = true;
+#else
+constexpr bool SEARCH_PROFILE_ENABLED = false;
+#endif
+
+enum ProfileSite {
+    PROFILE_MOVEGEN,
+    PROFILE_DO_MOVE,
+    PROFILE_UNDO_MOVE,
+    PROFILE_EVALUATE,
+    PROFILE_TT_PROBE,
+    PROFILE_TT_STORE,
+    PROFILE_ORDER_MOVES,
+    PROFILE_SITE_NB
+};
+
+// Cycle totals of one thread. Each thread only ever writes its own
+// thread-local copy, aligned so no two threads share a cache line.
+struct alignas(64) ProfileBuckets {
+    uint64_t cycles[PROFILE_SITE_NB];
+    uint64_t calls[PROFILE_SITE_NB];
+    uint64_t total_cycles;
+    
+    static thread_local ProfileBuckets local;
+    
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(_M_X64)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+    
+    void clear();
+    void write_info(std::ostream& out) const;
+    
+    static const char* site_name(ProfileSite site);
+    static double timer_overhead();
+};
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(ProfileSite site) : site(site) {
+        if constexpr (SEARCH_PROFILE_ENABLED) start = ProfileBuckets::now();
+    }
+    
+    ~ScopedTimer() {
+        if constexpr (SEARCH_PROFILE_ENABLED) {
+            ProfileBuckets::local.cycles[site] += ProfileBuckets::now() - start;
+            ProfileBuckets::local.calls[site]++;
+        }
+    }
+    
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+    
+private:
+    ProfileSite site;
+    uint64_t start = 0;
+};
@@ -0,0 +1,699 @@
+#include "search.hpp"
+#include "movegen.hpp"
+#include "move_utils.hpp"
+#include "eval.hpp"
+#include "search_stats.hpp"
+#include "search_trace.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+
+namespace {
+    // Mate scores are stored relative to the node, not the root
+    Score score_to_tt(Score score, int ply) {
+        if (score >= SCORE_MATE_IN_MAX_PLY) return score + ply;
+        if (score <= -SCORE_MATE_IN_MAX_PLY) return score - ply;
+        return score;
+    }
+    
+    Score score_from_tt(Score score, int ply) {
+        if (score >= SCORE_MATE_IN_MAX_PLY) return score - ply;
+        if (score <= -SCORE_MATE_IN_MAX_PLY) return score + ply;
+        return score;
+    }
+    
+    // Generation and evaluation are timed here, at their only callers
+    Score evaluate(const Position& pos) {
+        ScopedTimer timer(PROFILE_EVALUATE);
+        return Evaluator::evaluate(pos);
+    }
+    
+    // Pseudo-legal moves, or evasions when in check
+    std::vector<Move> generate_moves(const Position& pos) {
+        ScopedTimer timer(PROFILE_MOVEGEN);
+        return pos.in_check() ? MoveGenerator::generate_evasions(pos) : MoveGenerator::generate_moves(pos);
+    }
+    
+    std::vector<Move> generate_tactical_moves(const Position& pos, bool quiet_checks) {
+        ScopedTimer timer(PROFILE_MOVEGEN);
+        std::vector<Move> moves = MoveGenerator::generate_captures(pos);
+        if (quiet_checks) {
+            std::vector<Move> checks = MoveGenerator::generate_quiet_checks(pos);
+            moves.insert(moves.end(), checks.begin(), checks.end());
+        }
+        return moves;
+    }
+}
+
+SearchEngine::SearchEngine() : SearchEngine(16) {}
+
+SearchEngine::SearchEngine(size_t hash_mb)
+    : SearchEngine(std::make_unique<TranspositionTable>(hash_mb), nullptr, 0) {}
+
+SearchEngine::SearchEngine(TranspositionTable& shared_tt, uint64_t tag)
+    : SearchEngine(nullptr, &shared_tt, tag) {}
+
+SearchEngine::SearchEngine(std::unique_ptr<TranspositionTable> table, TranspositionTable* shared, uint64_t tag)
+    : own_tt(std::move(table)), tt(shared ? shared : own_tt.get()), tt_tag(tag),
+      stop_flag(false), nodes_searched(0), qnodes_searched(0),
+      tt_probes(0), tt_hits(0), next_limit_check(0), root_depth(0), seldepth(0),
+      metrics(nullptr), metrics_thread(0), next_metrics_update(0),
+      pv_index(0) {
+    stats.clear();
+    profile.clear();
+    clear();
+}
+
+// Forget everything learned from previous searches. A shared table is
+// left alone, since other engines are still using it.
+void SearchEngine::clear() {
+    if (own_tt) own_tt->clear();
+    
+    for (int ply = 0; ply < MAX_PLY; ply++) {
+        killers[ply][0] = killers[ply][1] = MoveUtils::null_move();
+    }
+    
+    for (int c = 0; c < COLOR_NB; c++) {
+        for (int from = 0; from < SQUARE_NB; from++) {
+            for (int to = 0; to < SQUARE_NB; to++) {
+                history[c][from][to] = 0;
+            }
+        }
+    }
+}
+
+void SearchEngine::set_metrics(MetricsPublisher* publisher, int thread_index) {
+    metrics = publisher;
+    metrics_thread = thread_index;
+}
+
+Move SearchEngine::search(const Position& root_pos, const SearchInfo& info) {
+    Position pos = root_pos;
+    
+    limits = info;
+    start_time = std::chrono::steady_clock::now();
+    nodes_searched = 0;
+    qnodes_searched = 0;
+    tt_probes = 0;
+    tt_hits = 0;
+    next_limit_check = 0;
+    root_depth = 0;
+    seldepth = 0;
+    next_metrics_update = 0;
+    result = SearchResult();
+    
+    if constexpr (SEARCH_STATS_ENABLED) SearchStats::local.clear();
+    if constexpr (SEARCH_PROFILE_ENABLED) ProfileBuckets::local.clear();
+    uint64_t start_cycles = ProfileBuckets::now();
+    
+    for (int ply = 0; ply < MAX_PLY; ply++) {
+        killers[ply][0] = killers[ply][1] = MoveUtils::null_move();
+    }
+    
+    // Legal root moves, ordered once up front and then by each iteration
+    std::vector<Move> moves = generate_moves(pos);
+    std::vector<Move> legal;
+    for (Move m : moves) {
+        if (!pos.is_legal(m)) continue;
+        if (!info.search_moves.empty()
+            && std::find(info.search_moves.begin(), info.search_moves.end(), m) == info.search_moves.end()) {
+            continue;
+        }
+        legal.push_back(m);
+    }
+    
+    if (legal.empty()) {
+        root_moves.clear();
+        result.score = pos.in_check() ? -SCORE_MATE : 0;
+    } else {
+        TTEntry entry;
+        order_moves(pos, legal, tt->probe(tt_key(pos), entry) ? entry.best_move : MoveUtils::null_move());
+        
+        root_moves.assign(legal.size(), RootMove());
+        for (size_t i = 0; i < legal.size(); i++) {
+            root_moves[i].move = legal[i];
+        }
+        result.best_move = legal[0];
+        
+        if (metrics) publish_metrics(true);
+        
+        int max_depth = std::min(limits.max_depth, MAX_PLY - 1);
+        
+        for (int depth = 1; depth <= max_depth; depth++) {
+            root_depth = depth;
+            Score score = search_root(pos, depth);
+            
+            // An interrupted iteration is discarded
+            if (stop_flag) break;
+            
+            result.best_move = root_moves[0].move;
+            result.score = score;
+            result.depth = depth;
+            result.seldepth = seldepth;
+            result.pv = root_moves[0].pv;
+            
+            result.lines.clear();
+            if (limits.multi_pv > 1) {
+                for (size_t i = 0; i < std::min(size_t(limits.multi_pv), root_moves.size()); i++) {
+                    result.lines.push_back({root_moves[i].score, root_moves[i].depth, root_moves[i].pv});
+                }
+            }
+            result.nodes = nodes_searched;
+            result.qnodes = qnodes_searched;
+            result.tt_probes = tt_probes;
+            result.tt_hits = tt_hits;
+            result.time_ms = elapsed_ms();
+            
+            if (limits.on_iteration) limits.on_iteration(result);
+            
+            // Don't start an iteration that is unlikely to finish
+            if (!limits.infinite && elapsed_ms() >= limits.max_time_ms / 2) break;
+        }
+    }
+    
+    // A stop only ever ends the search it reached
+    stop_flag = false;
+    
+    result.nodes = nodes_searched;
+    result.qnodes = qnodes_searched;
+    result.tt_probes = tt_probes;
+    result.tt_hits = tt_hits;
+    result.time_ms = elapsed_ms();
+    
+    if (metrics) publish_metrics(false);
+    
+    if constexpr (SEARCH_STATS_ENABLED) stats = SearchStats::local;
+    if constexpr (SEARCH_PROFILE_ENABLED) {
+        ProfileBuckets::local.total_cycles = ProfileBuckets::now() - start_cycles;
+        profile = ProfileBuckets::local;
+    }
+    
+    return result.best_move;
+}
+
+// One pass over the root moves per MultiPV line. A line searches the moves
+// not on an earlier line with a full window, so its best move is the next
+// best of the position; history and the table carry over between lines.
+Score SearchEngine::search_root(Position& pos, int depth) {
+    size_t lines = prepare_root_moves();
+    
+    for (pv_index = 0; pv_index < lines; pv_index++) {
+        if (!search_root_line(pos, depth)) return 0;
+    }
+    
+    return finish_root_iteration(pos, depth, lines);
+}
+
+// False when the search was stopped
+bool SearchEngine::search_root_line(Position& pos, int depth) {
+    nodes_searched++;
+    SearchStats::node(depth);
+    pv_length[0] = 0;
+    
+    Score alpha = -SCORE_INFINITE;
+    Score beta = SCORE_INFINITE;
+    Score best_score = -SCORE_INFINITE;
+    
+    for (size_t i = pv_index; i < root_moves.size(); i++) {
+        Move m = root_moves[i].move;
+        
+        pos.do_move(m);
+        
+        Score score;
+        if (i == pv_index) {
+            score = -search(pos, depth - 1, 1, -beta, -alpha);
+        } else {
+            score = -search(pos, depth - 1, 1, -alpha - 1, -alpha);
+            if (score > alpha) {
+                score = -search(pos, depth - 1, 1, -beta, -alpha);
+            }
+        }
+        
+        pos.undo_move(m);
+        
+        if (stop_flag) return false;
+        
+        if (score > best_score) {
+            best_score = score;
+            alpha = score;
+            record_root_move(root_moves[i], score, depth);
+        }
+    }
+    
+    sort_root_moves(pv_index, root_moves.size());
+    return true;
+}
+
+// Clears the scores of the previous iteration; returns the number of lines
+size_t SearchEngine::prepare_root_moves() {
+    for (RootMove& rm : root_moves) {
+        rm.score = -SCORE_INFINITE;
+    }
+    return std::min(size_t(std::max(1, limits.multi_pv)), root_moves.size());
+}
+
+void SearchEngine::record_root_move(RootMove& rm, Score score, int depth) {
+    update_pv(0, rm.move);
+    rm.score = score;
+    rm.depth = depth;
+    rm.pv.assign(pv_table[0], pv_table[0] + pv_length[0]);
+}
+
+// Best first. Moves that failed low keep -SCORE_INFINITE, so they stay in
+// the order of the previous iteration behind the ones that were scored.
+void SearchEngine::sort_root_moves(size_t first, size_t last) {
+    std::stable_sort(root_moves.begin() + first, root_moves.begin() + last,
+                     [](const RootMove& a, const RootMove& b) { return a.score > b.score; });
+}
+
+Score SearchEngine::finish_root_iteration(const Position& pos, int depth, size_t lines) {
+    sort_root_moves(0, lines);
+    
+    const RootMove& best = root_moves[0];
+    tt->store(tt_key(pos), score_to_tt(best.score, 0), best.move, depth, EXACT);
+    
+    return best.score;
+}
+
+// Entry points of a node. With tracing compiled in they record the node
+// once its body has returned; otherwise they reduce to the body.
+Score SearchEngine::search(Position& pos, int depth, int ply, Score alpha, Score beta) {
+    if constexpr (!SEARCH_TRACE_ENABLED) return search_node(pos, depth, ply, alpha, beta);
+    
+    SearchTrace::enter(ply);
+    Score score = search_node(pos, depth, ply, alpha, beta);
+    if (stop_flag) SearchTrace::flag(ply, TraceRecord::STOPPED);
+    SearchTrace::leave(tt_key(pos), ply, depth, alpha, beta, score);
+    return score;
+}
+
+Score SearchEngine::quiescence_search(Position& pos, int ply, Score alpha, Score beta, int depth) {
+    if constexpr (!SEARCH_TRACE_ENABLED) return quiescence_node(pos, ply, alpha, beta, depth);
+    
+    SearchTrace::enter(ply);
+    Score score = quiescence_node(pos, ply, alpha, beta, depth);
+    if (stop_flag) SearchTrace::flag(ply, TraceRecord::STOPPED);
+    SearchTrace::leave(tt_key(pos), ply, depth, alpha, beta, score);
+    return score;
+}
+
+Score SearchEngine::search_node(Position& pos, int depth, int ply, Score alpha, Score beta) {
+    pv_length[ply] = ply;
+    seldepth = std::max(seldepth, ply);
+    
+    bool in_check = pos.in_check();
+    
+    // Check extension
+    if (in_check) {
+        depth++;
+        SearchStats::event(SearchStats::CHECK_EXTENSION);
+        SearchTrace::flag(ply, TraceRecord::IN_CHECK);
+    }
+    
+    // The same node continues in quiescence
+    if (depth <= 0) return quiescence_node(pos, ply, alpha, beta);
+    
+    nodes_searched++;
+    SearchStats::node(depth);
+    check_limits();
+    if (stop_flag) return 0;
+    
+    if (is_draw(pos)) return 0;
+    if (ply >= MAX_PLY - 1) return in_check ? 0 : evaluate(pos);
+    
+    // Mate distance pruning
+    alpha = std::max(alpha, -SCORE_MATE + ply);
+    beta = std::min(beta, SCORE_MATE - ply - 1);
+    if (alpha >= beta) {
+        SearchStats::event(SearchStats::MATE_DISTANCE_CUTOFF);
+        SearchTrace::flag(ply, TraceRecord::PRUNED);
+        return alpha;
+    }
+    
+    bool pv_node = beta - alpha > 1;
+    
+    TTEntry entry;
+    Move tt_move = MoveUtils::null_move();
+    if (probe_tt(pos, entry)) {
+        tt_move = entry.best_move;
+        Score tt_score = score_from_tt(entry.score, ply);
+        
+        if (!pv_node && entry.depth >= depth
+            && (entry.flag == EXACT
+                || (entry.flag == LOWER_BOUND && tt_score >= beta)
+                || (entry.flag == UPPER_BOUND && tt_score <= alpha))) {
+            SearchStats::event(SearchStats::TT_CUTOFF);
+            SearchTrace::flag(ply, TraceRecord::TT_CUTOFF);
+            return tt_score;
+        }
+    }
+    
+    if (!pv_node && !in_check) {
+        Score static_eval = evaluate(pos);
+        
+        // Reverse futility pruning: far enough above beta at low depth. The
+        // static eval is only a guess here, so the node fails high by beta
+        // rather than carrying the guess up the tree as a bound.
+        if (depth <= 3 && std::abs(beta) < SCORE_MATE_IN_MAX_PLY
+            && static_eval - FUTILITY_MARGIN * depth >= beta) {
+            SearchStats::event(SearchStats::RFP_CUTOFF);
+            SearchTrace::flag(ply, TraceRecord::PRUNED);
+            return beta;
+        }
+        
+        // Null move pruning, unless only pawns are left (zugzwang)
+        if (depth >= 3 && static_eval >= beta && pos.has_non_pawn_material(pos.side_to_move())) {
+            int reduction = 3 + depth / 6;
+            SearchStats::event(SearchStats::NULL_MOVE_TRY);
+            
+            pos.do_null_move();
+            Score score = -search(pos, depth - 1 - reduction, ply + 1, -beta, -beta + 1);
+            pos.undo_null_move();
+            
+            if (stop_flag) return 0;
+            if (score >= beta) {
+                SearchStats::event(SearchStats::NULL_MOVE_CUTOFF);
+                SearchTrace::flag(ply, TraceRecord::PRUNED);
+                return score >= SCORE_MATE_IN_MAX_PLY ? beta : score;
+            }
+        }
+    }
+    
+    std::vector<Move> moves = generate_moves(pos);
+    order_moves(pos, moves, tt_move, ply);
+    
+    Score original_alpha = alpha;
+    Score best_score = -SCORE_INFINITE;
+    Move best_move = MoveUtils::null_move();
+    int legal_moves = 0;
+    
+    Position::CheckInfo ci = pos.check_info();
+    
+    for (Move m : moves) {
+        if (!pos.is_legal(m)) continue;
+        legal_moves++;
+        
+        bool quiet = MoveUtils::is_quiet(m, pos);
+        bool checking = quiet && pos.gives_check(m, ci);
+        
+        pos.do_move(m);
+        
+        Score score;
+        if (legal_moves == 1) {
+            score = -search(pos, depth - 1, ply + 1, -beta, -alpha);
+        } else {
+            // Late move reductions for quiet moves that neither escape nor give check
+            int reduction = 0;
+            if (depth >= 3 && legal_moves > 3 && quiet && !in_check && !checking) {
+                reduction = 1 + (legal_moves > 8) + (depth >= 8) - pv_node;
+                if (reduction > 0) SearchStats::event(SearchStats::LMR_REDUCTION);
+            }
+            
+            score = -search(pos, depth - 1 - reduction, ply + 1, -alpha - 1, -alpha);
+            
+            if (score > alpha && reduction > 0) {
+                SearchStats::event(SearchStats::LMR_RESEARCH);
+                score = -search(pos, depth - 1, ply + 1, -alpha - 1, -alpha);
+            }
+            
+            if (score > alpha && score < beta) {
+                SearchStats::event(SearchStats::PVS_RESEARCH);
+                score = -search(pos, depth - 1, ply + 1, -beta, -alpha);
+            }
+        }
+        
+        pos.undo_move(m);
+        
+        if (stop_flag) return 0;
+        
+        if (score > best_score) {
+            best_score = score;
+            
+            if (score > alpha) {
+                best_move = m;
+                update_pv(ply, m);
+                
+                if (score >= beta) {
+                    if (quiet) update_quiet_stats(pos, m, depth, ply);
+                    SearchStats::cutoff(legal_moves - 1);
+                    break;
+                }
+                
+                alpha = score;
+            }
+        }
+    }
+    
+    SearchTrace::moves(ply, best_move, legal_moves);
+    
+    if (legal_moves == 0) {
+        return in_check ? -SCORE_MATE + ply : 0;
+    }
+    
+    int flag = best_score >= beta ? LOWER_BOUND : (best_score > original_alpha ? EXACT : UPPER_BOUND);
+    SearchStats::node_type(flag == EXACT ? SearchStats::PV_NODE
+                           : flag == LOWER_BOUND ? SearchStats::CUT_NODE : SearchStats::ALL_NODE);
+    tt->store(tt_key(pos), score_to_tt(best_score, ply), best_move, depth, flag);
+    
+    return best_score;
+}
+
+Score SearchEngine::quiescence_node(Position& pos, int ply, Score alpha, Score beta, int depth) {
+    SearchTrace::flag(ply, TraceRecord::QUIESCENCE);
+    nodes_searched++;
+    qnodes_searched++;
+    SearchStats::qnode(ply);
+    seldepth = std::max(seldepth, ply);
+    
+    if (ply >= MAX_PLY) return evaluate(pos);
+    if (is_draw(pos)) return 0;
+    
+    bool in_check = pos.in_check();
+    if (in_check) SearchTrace::flag(ply, TraceRecord::IN_CHECK);
+    
+    // Entries from the checks stage also answer the captures-only stage
+    int tt_depth = (in_check || depth >= DEPTH_QS_CHECKS) ? DEPTH_QS_CHECKS : DEPTH_QS_NO_CHECKS;
+    
+    TTEntry entry;
+    Move tt_move = MoveUtils::null_move();
+    if (probe_tt(pos, entry)) {
+        tt_move = entry.best_move;
+        Score tt_score = score_from_tt(entry.score, ply);
+        
+        if (entry.depth >= tt_depth
+            && (entry.flag == EXACT
+                || (entry.flag == LOWER_BOUND && tt_score >= beta)
+                || (entry.flag == UPPER_BOUND && tt_score <= alpha))) {
+            SearchStats::event(SearchStats::QS_TT_CUTOFF);
+            SearchTrace::flag(ply, TraceRecord::TT_CUTOFF);
+            return tt_score;
+        }
+    }
+    
+    Score stand_pat = -SCORE_INFINITE;
+    Score best_score = -SCORE_INFINITE;
+    std::vector<Move> moves;
+    
+    if (in_check) {
+        // No stand pat when in check: every evasion is searched
+        moves = generate_moves(pos);
+    } else {
+        stand_pat = evaluate(pos);
+        
+        if (stand_pat >= beta) {
+            SearchStats::event(SearchStats::STAND_PAT_CUTOFF);
+            SearchTrace::flag(ply, TraceRecord::PRUNED);
+            tt->store(tt_key(pos), score_to_tt(stand_pat, ply), MoveUtils::null_move(), tt_depth, LOWER_BOUND);
+            return stand_pat;
+        }
+        
+        if (stand_pat > alpha) alpha = stand_pat;
+        best_score = stand_pat;
+        
+        moves = generate_tactical_moves(pos, depth >= DEPTH_QS_CHECKS);
+    }
+    
+    order_moves(pos, moves, tt_move);
+    
+    Move best_move = MoveUtils::null_move();
+    int legal_moves = 0;
+    
+    for (Move m : moves) {
+        if (!pos.is_legal(m)) continue;
+        legal_moves++;
+        
+        if (!in_check) {
+            // Delta pruning: even winning the victim outright cannot raise alpha
+            if (MoveUtils::is_capture(m, pos) && !MoveUtils::is_promotion(m)) {
+                Piece victim = pos.piece_on(MoveUtils::to_sq(m));
+                Score gain = MoveUtils::is_en_passant(m) || victim == NO_PIECE
+                           ? MoveUtils::get_piece_value(PAWN)
+                           : MoveUtils::get_piece_value(PieceType(victim % 6));
+                
+                if (stand_pat + gain + DELTA_MARGIN <= alpha) {
+                    SearchStats::event(SearchStats::DELTA_PRUNE);
+                    best_score = std::max(best_score, stand_pat + gain + DELTA_MARGIN);
+                    continue;
+                }
+            }
+            
+            // SEE pruning: skip captures and checks that lose material
+            if (MoveUtils::see(m, pos) < 0) {
+                SearchStats::event(SearchStats::SEE_PRUNE);
+                continue;
+            }
+        }
+        
+        pos.do_move(m);
+        Score score = -quiescence_search(pos, ply + 1, -beta, -alpha, depth - 1);
+        pos.undo_move(m);
+        
+        if (stop_flag) return 0;
+        
+        if (score > best_score) {
+            best_score = score;
+            
+            if (score > alpha) {
+                best_move = m;
+                if (score >= beta) break;
+                alpha = score;
+            }
+        }
+    }
+    
+    SearchTrace::moves(ply, best_move, legal_moves);
+    
+    if (in_check && legal_moves == 0) {
+        return -SCORE_MATE + ply;
+    }
+    
+    int flag = best_score >= beta ? LOWER_BOUND : (best_move ? EXACT : UPPER_BOUND);
+    tt->store(tt_key(pos), score_to_tt(best_score, ply), best_move, tt_depth, flag);
+    
+    return best_score;
+}
+
+bool SearchEngine::is_draw(const Position& pos) {
+    return pos.halfmove_count() >= 100 || pos.is_repetition();
+}
+
+bool SearchEngine::probe_tt(const Position& pos, TTEntry& entry) {
+    tt_probes++;
+    bool hit = tt->probe(tt_key(pos), entry);
+    tt_hits += hit;
+    SearchStats::tt_probe(hit);
+    return hit;
+}
+
+// TT move first, then captures and promotions by MVV-LVA, then killers,
+// then quiet moves by history
+void SearchEngine::order_moves(const Position& pos, std::vector<Move>& moves, Move tt_move, int ply) {
+    constexpr int TT_MOVE_SCORE = 1 << 30;
+    constexpr int TACTICAL_SCORE = 1 << 24;
+    constexpr int KILLER_SCORE = TACTICAL_SCORE - 2;
+    
+    ScopedTimer timer(PROFILE_ORDER_MOVES);
+    
+    int scores[256];
+    int count = std::min(int(moves.size()), 256);
+    Color us = pos.side_to_move();
+    
+    for (int i = 0; i < count; i++) {
+        Move m = moves[i];
+        
+        if (m == tt_move) {
+            scores[i] = TT_MOVE_SCORE;
+        } else if (MoveUtils::is_tactical(m, pos)) {
+            scores[i] = TACTICAL_SCORE + MoveUtils::get_move_score(m, pos);
+        } else if (ply < MAX_PLY && m == killers[ply][0]) {
+            scores[i] = KILLER_SCORE;
+        } else if (ply < MAX_PLY && m == killers[ply][1]) {
+            scores[i] = KILLER_SCORE - 1;
+        } else {
+            scores[i] = history[us][MoveUtils::from_sq(m)][MoveUtils::to_sq(m)];
+        }
+    }
+    
+    // Insertion sort: lists are short and mostly need only a few swaps
+    for (int i = 1; i < count; i++) {
+        int score = scores[i];
+        Move m = moves[i];
+        int j = i - 1;
+        
+        while (j >= 0 && scores[j] < score) {
+            scores[j + 1] = scores[j];
+            moves[j + 1] = moves[j];
+            j--;
+        }
+        
+        scores[j + 1] = score;
+        moves[j + 1] = m;
+    }
+}
+
+void SearchEngine::update_pv(int ply, Move m) {
+    pv_table[ply][ply] = m;
+    
+    for (int i = ply + 1; i < pv_length[ply + 1]; i++) {
+        pv_table[ply][i] = pv_table[ply + 1][i];
+    }
+    
+    pv_length[ply] = std::max(pv_length[ply + 1], ply + 1);
+}
+
+void SearchEngine::update_quiet_stats(const Position& pos, Move m, int depth, int ply) {
+    if (killers[ply][0] != m) {
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = m;
+    }
+    
+    int& entry = history[pos.side_to_move()][MoveUtils::from_sq(m)][MoveUtils::to_sq(m)];
+    entry += depth * depth;
+    
+    // Keep history scores below the killer and capture bands
+    if (entry >= HISTORY_MAX) {
+        for (int c = 0; c < COLOR_NB; c++) {
+            for (int from = 0; from < SQUARE_NB; from++) {
+                for (int to = 0; to < SQUARE_NB; to++) {
+                    history[c][from][to] /= 2;
+                }
+            }
+        }
+    }
+}
+
+void SearchEngine::check_limits() {
+    if (!limits.infinite && nodes_searched >= limits.max_nodes) {
+        stop_flag = true;
+        return;
+    }
+    
+    // Reading the clock is comparatively expensive
+    if (nodes_searched < next_limit_check) return;
+    next_limit_check = nodes_searched + 1024;
+    
+    int elapsed = elapsed_ms();
+    
+    if (metrics && elapsed >= next_metrics_update) publish_metrics(true);
+    
+    if (!limits.infinite && elapsed >= limits.max_time_ms) {
+        stop_flag = true;
+    }
+}
+
+// Every thread fills its own node slot; thread 0 also publishes the totals
+void SearchEngine::publish_metrics(bool searching) {
+    int elapsed = elapsed_ms();
+    next_metrics_update = elapsed + METRICS_INTERVAL_MS;
+    
+    metrics->publish_thread(metrics_thread, nodes_searched);
+    if (metrics_thread == 0) {
+        metrics->publish(root_depth, seldepth, tt->hashfull(), searching, elapsed);
+    }
+}
+
+int SearchEngine::elapsed_ms() const {
+    auto elapsed = std::chrono::steady_clock::now() - start_time;
+    return int(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+}
@@ -1,28 +1,163 @@
 // ===== SEARCH ENGINE =====
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+
 class SearchEngine {
 public:
     SearchEngine();
+    explicit SearchEngine(size_t hash_mb);
+    
+    // Searches with a table owned elsewhere. A non-zero tag is mixed into
+    // every key, so engines with different tags keep their entries apart.
+    SearchEngine(TranspositionTable& shared_tt, uint64_t tag = 0);
+    
+    // One of the best lines of a MultiPV search
+    struct PVLine {
+        Score score = 0;
+        int depth = 0;
+        std::vector<Move> pv;
+    };
+    
+    // Outcome of the last completed iteration
+    struct SearchResult {
+        Move best_move = 0;
+        Score score = 0;
+        int depth = 0;
+        int seldepth = 0;
+        int nodes = 0;
+        int qnodes = 0;
+        int tt_probes = 0;
+        int tt_hits = 0;
+        int time_ms = 0;
+        std::vector<Move> pv;
+        
+        // With MultiPV, the best lines in order, the first being pv
+        std::vector<PVLine> lines;
+    };
     
     struct SearchInfo {
         int max_depth = 64;
         int max_time_ms = 5000;
         int max_nodes = 1000000;
         bool infinite = false;
+        
+        // "go mate N": look for a forced mate in N moves instead
+        int mate = 0;
+        
+        // Root moves to consider; all legal moves when empty
+        std::vector<Move> search_moves;
+        
+        // Number of best lines to search and report
+        int multi_pv = 1;
+        
+        // Called after every completed iteration, e.g. to print UCI info
+        std::function<void(const SearchResult&)> on_iteration;
     };
     
     Move search(const Position& pos, const SearchInfo& info);
+    
+    // Ends the search in progress, or the next one if it has not started
+    // yet. A caller starting a search on another thread first calls
+    // clear_stop(), so that an earlier stop is forgotten but none sent
+    // meanwhile is lost.
     void stop_search() { stop_flag = true; }
+    void clear_stop() { stop_flag = false; }
+    void clear();
+    
+    // Report progress to a shared-memory metrics page, in the given thread slot
+    void set_metrics(MetricsPublisher* publisher, int thread_index = 0);
+    
+    const SearchResult& last_result() const { return result; }
+    TranspositionTable& table() { return *tt; }
+    int nodes() const { return nodes_searched; }
+    int qsearch_nodes() const { return qnodes_searched; }
+    
+    // Counters of the last search; all zero unless built with SEARCH_STATS
+    const SearchStats& search_stats() const { return stats; }
+    
+    // Hot-path timings of the last search; all zero unless built with SEARCH_PROFILE
+    const ProfileBuckets& profile_buckets() const { return profile; }
     
 private:
-    TranspositionTable tt;
-    bool stop_flag;
+    // Quiescence depths: quiet checks are generated only at the first ply
+    static constexpr int DEPTH_QS_CHECKS = 0;
+    static constexpr int DEPTH_QS_NO_CHECKS = -1;
+    
+    // Margin on top of the captured piece for delta pruning
+    static constexpr Score DELTA_MARGIN = 200;
+    
+    // Per-depth margin for reverse futility pruning
+    static constexpr Score FUTILITY_MARGIN = 120;
+    
+    // History scores are halved once one reaches this value
+    static constexpr int HISTORY_MAX = 1 << 20;
+    
+    // Minimum time between two updates of the metrics page
+    static constexpr int METRICS_INTERVAL_MS = 5;
+    
+    std::unique_ptr<TranspositionTable> own_tt;
+    TranspositionTable* tt;
+    uint64_t tt_tag;
+    std::atomic<bool> stop_flag;
     int nodes_searched;
+    int qnodes_searched;
+    int tt_probes;
+    int tt_hits;
+    int next_limit_check;
+    int root_depth;
+    int seldepth;
+    
+    MetricsPublisher* metrics;
+    int metrics_thread;
+    int next_metrics_update;
+    
+    SearchInfo limits;
+    SearchResult result;
+    SearchStats stats;
+    ProfileBuckets profile;
+    std::chrono::steady_clock::time_point start_time;
+    
+    // A legal root move and its result in the current search
+    struct RootMove {
+        Move move = 0;
+        Score score = -SCORE_INFINITE;
+        int depth = 0;
+        std::vector<Move> pv;
+    };
+    
+    // Best first after every iteration; the moves before pv_index already
+    // have their line in the current one
+    std::vector<RootMove> root_moves;
+    size_t pv_index;
+    Move pv_table[MAX_PLY][MAX_PLY];
+    int pv_length[MAX_PLY];
+    Move killers[MAX_PLY][2];
+    int history[COLOR_NB][SQUARE_NB][SQUARE_NB];
+    
+    SearchEngine(std::unique_ptr<TranspositionTable> table, TranspositionTable* shared, uint64_t tag);
+    
+    uint64_t tt_key(const Position& pos) const { return pos.key() ^ tt_tag; }
     
     Score search_root(Position& pos, int depth);
+    bool search_root_line(Position& pos, int depth);
+    size_t prepare_root_moves();
+    void record_root_move(RootMove& rm, Score score, int depth);
+    void sort_root_moves(size_t first, size_t last);
+    Score finish_root_iteration(const Position& pos, int depth, size_t lines);
     Score search(Position& pos, int depth, int ply, Score alpha, Score beta);
-    Score quiescence_search(Position& pos, int ply, Score alpha, Score beta);
+    Score quiescence_search(Position& pos, int ply, Score alpha, Score beta, int depth = DEPTH_QS_CHECKS);
+    Score search_node(Position& pos, int depth, int ply, Score alpha, Score beta);
+    Score quiescence_node(Position& pos, int ply, Score alpha, Score beta, int depth = DEPTH_QS_CHECKS);
+    bool probe_tt(const Position& pos, TTEntry& entry);
     
-    void order_moves(const Position& pos, std::vector<Move>& moves, Move tt_move);
+    void order_moves(const Position& pos, std::vector<Move>& moves, Move tt_move, int ply = MAX_PLY);
+    void update_pv(int ply, Move m);
+    void update_quiet_stats(const Position& pos, Move m, int depth, int ply);
+    void check_limits();
+    void publish_metrics(bool searching);
+    int elapsed_ms() const;
     bool is_draw(const Position& pos);
 };
 
@@ -0,0 +1,86 @@
+#include "search_stats.hpp"
+#include <cstring>
+
+thread_local SearchStats SearchStats::local;
+
+void SearchStats::clear() {
+    std::memset(this, 0, sizeof(SearchStats));
+}
+
+const char* SearchStats::event_name(Event e) {
+    static const char* names[EVENT_NB] = {
+        "tt_cutoff", "qs_tt_cutoff", "stand_pat_cutoff", "mate_distance_cutoff",
+        "rfp_cutoff", "null_move_try", "null_move_cutoff", "delta_prune",
+        "see_prune", "check_extension", "lmr_reduction", "lmr_research", "pvs_research"
+    };
+    return names[e];
+}
+
+namespace {
+    double ratio(uint64_t part, uint64_t total) {
+        return total ? double(part) / total : 0.0;
+    }
+    
+    // Histograms are printed up to their last non-empty bucket
+    int used_buckets(const uint64_t* counts, int size) {
+        while (size > 0 && counts[size - 1] == 0) size--;
+        return size;
+    }
+}
+
+// One "info string" line per group, readable in any UCI GUI log
+void SearchStats::write_info(std::ostream& out) const {
+    uint64_t cutoff_total = 0;
+    for (int i = 0; i < MOVE_INDEX_NB; i++) cutoff_total += cutoffs[i];
+    
+    out << "info string stats nodes " << nodes << " qnodes " << qnodes
+        << " qshare " << ratio(qnodes, nodes + qnodes)
+        << " pv " << node_types[PV_NODE] << " cut " << node_types[CUT_NODE]
+        << " all " << node_types[ALL_NODE] << "\n";
+    
+    out << "info string stats tt probes " << tt_probes << " hits " << tt_hits
+        << " hitrate " << ratio(tt_hits, tt_probes)
+        << " cutoffs " << events[TT_CUTOFF] + events[QS_TT_CUTOFF]
+        << " cutrate " << ratio(events[TT_CUTOFF] + events[QS_TT_CUTOFF], tt_probes) << "\n";
+    
+    out << "info string stats cutoffs " << cutoff_total
+        << " first " << ratio(cutoffs[0], cutoff_total) << " by_index";
+    for (int i = 0, n = used_buckets(cutoffs, MOVE_INDEX_NB); i < n; i++) out << ' ' << cutoffs[i];
+    out << "\n";
+    
+    out << "info string stats events";
+    for (int e = 0; e < EVENT_NB; e++) out << ' ' << event_name(Event(e)) << ' ' << events[e];
+    out << "\n";
+    
+    out << "info string stats depth_nodes";
+    for (int i = 0, n = used_buckets(nodes_by_depth, DEPTH_NB); i < n; i++) out << ' ' << nodes_by_depth[i];
+    out << "\n";
+    
+    out << "info string stats qply_nodes";
+    for (int i = 0, n = used_buckets(qnodes_by_ply, MAX_PLY); i < n; i++) out << ' ' << qnodes_by_ply[i];
+    out << std::endl;
+}
+
+void SearchStats::write_json(std::ostream& out) const {
+    auto write_array = [&](const char* name, const uint64_t* counts, int size) {
+        out << ",\"" << name << "\":[";
+        for (int i = 0, n = used_buckets(counts, size); i < n; i++) out << (i ? "," : "") << counts[i];
+        out << "]";
+    };
+    
+    out << "{\"nodes\":" << nodes << ",\"qnodes\":" << qnodes
+        << ",\"node_types\":{\"pv\":" << node_types[PV_NODE]
+        << ",\"cut\":" << node_types[CUT_NODE] << ",\"all\":" << node_types[ALL_NODE] << "}"
+        << ",\"tt_probes\":" << tt_probes << ",\"tt_hits\":" << tt_hits;
+    
+    out << ",\"events\":{";
+    for (int e = 0; e < EVENT_NB; e++) {
+        out << (e ? "," : "") << "\"" << event_name(Event(e)) << "\":" << events[e];
+    }
+    out << "}";
+    
+    write_array("cutoffs_by_move", cutoffs, MOVE_INDEX_NB);
+    write_array("nodes_by_depth", nodes_by_depth, DEPTH_NB);
+    write_array("qnodes_by_ply", qnodes_by_ply, MAX_PLY);
+    out << "}" << std::endl;
+}
@@ -0,0 +1,92 @@
+// ===== SEARCH STATISTICS =====
+#include <cstdint>
+#include <ostream>
+
+// Build with -DSEARCH_STATS to collect the counters below. Without it every
+// recording call is an empty inline function and compiles away.
+#ifdef SEARCH_STATS
+constexpr bool SEARCH_STATS_ENABLED = true;
+#else
+constexpr bool SEARCH_STATS_ENABLED = false;
+#endif
+
+struct SearchStats {
+    // Classified by outcome: exact score, fail high or fail low
+    enum NodeType { PV_NODE, CUT_NODE, ALL_NODE, NODE_TYPE_NB };
+    
+    enum Event {
+        TT_CUTOFF,
+        QS_TT_CUTOFF,
+        STAND_PAT_CUTOFF,
+        MATE_DISTANCE_CUTOFF,
+        RFP_CUTOFF,
+        NULL_MOVE_TRY,
+        NULL_MOVE_CUTOFF,
+        DELTA_PRUNE,
+        SEE_PRUNE,
+        CHECK_EXTENSION,
+        LMR_REDUCTION,
+        LMR_RESEARCH,
+        PVS_RESEARCH,
+        EVENT_NB
+    };
+    
+    // Cutoffs by later moves all land in the last bucket
+    static constexpr int MOVE_INDEX_NB = 32;
+    static constexpr int DEPTH_NB = 64;
+    
+    uint64_t node_types[NODE_TYPE_NB];
+    uint64_t cutoffs[MOVE_INDEX_NB];
+    uint64_t events[EVENT_NB];
+    uint64_t tt_probes;
+    uint64_t tt_hits;
+    uint64_t nodes;
+    uint64_t qnodes;
+    uint64_t nodes_by_depth[DEPTH_NB];
+    uint64_t qnodes_by_ply[MAX_PLY];
+    
+    // Counters of the calling thread
+    static thread_local SearchStats local;
+    
+    static void node(int depth) {
+        if constexpr (SEARCH_STATS_ENABLED) {
+            local.nodes++;
+            local.nodes_by_depth[depth < DEPTH_NB ? depth : DEPTH_NB - 1]++;
+        }
+    }
+    
+    static void qnode(int ply) {
+        if constexpr (SEARCH_STATS_ENABLED) {
+            local.qnodes++;
+            local.qnodes_by_ply[ply < MAX_PLY ? ply : MAX_PLY - 1]++;
+        }
+    }
+    
+    static void node_type(NodeType type) {
+        if constexpr (SEARCH_STATS_ENABLED) local.node_types[type]++;
+    }
+    
+    // move_index counts legal moves searched before the cutoff, from 0
+    static void cutoff(int move_index) {
+        if constexpr (SEARCH_STATS_ENABLED) {
+            local.cutoffs[move_index < MOVE_INDEX_NB ? move_index : MOVE_INDEX_NB - 1]++;
+        }
+    }
+    
+    static void tt_probe(bool hit) {
+        if constexpr (SEARCH_STATS_ENABLED) {
+            local.tt_probes++;
+            local.tt_hits += hit;
+        }
+    }
+    
+    static void event(Event e) {
+        if constexpr (SEARCH_STATS_ENABLED) local.events[e]++;
+    }
+    
+    void clear();
+    void write_info(std::ostream& out) const;
+    void write_json(std::ostream& out) const;
+    
+    static const char* event_name(Event e);
+};
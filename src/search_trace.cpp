@@ -0,0 +1,231 @@
+#include "search_trace.hpp"
+#include "move_utils.hpp"
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+thread_local SearchTrace SearchTrace::local;
+
+SearchTrace::~SearchTrace() {
+    close();
+}
+
+bool SearchTrace::open(const std::string& path, size_t capacity) {
+    close();
+    
+    capacity = std::bit_ceil(std::max<size_t>(capacity, 1));
+    size_t size = sizeof(TraceHeader) + capacity * sizeof(TraceRecord);
+    
+    fd = ::open(path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    
+    if (ftruncate(fd, off_t(size)) != 0) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    
+    header = static_cast<TraceHeader*>(memory);
+    header->magic = TRACE_MAGIC;
+    header->version = TRACE_VERSION;
+    header->record_size = sizeof(TraceRecord);
+    header->capacity = capacity;
+    header->written = 0;
+    
+    records = reinterpret_cast<TraceRecord*>(header + 1);
+    mask = capacity - 1;
+    mapped_size = size;
+    return true;
+}
+
+void SearchTrace::close() {
+    if (!header) return;
+    
+    uint64_t written = header->written;
+    uint64_t capacity = header->capacity;
+    munmap(header, mapped_size);
+    
+    if (written < capacity) {
+        [[maybe_unused]] int result = ftruncate(fd, off_t(sizeof(TraceHeader) + written * sizeof(TraceRecord)));
+    }
+    ::close(fd);
+    
+    header = nullptr;
+    records = nullptr;
+    fd = -1;
+}
+
+void SearchTrace::write(uint64_t key, int ply, int depth, Score alpha, Score beta, Score score) {
+    const Frame& frame = frames[ply];
+    TraceRecord& r = records[header->written++ & mask];
+    
+    r.key = key;
+    r.alpha = int16_t(std::clamp(alpha, -SCORE_INFINITE, SCORE_INFINITE));
+    r.beta = int16_t(std::clamp(beta, -SCORE_INFINITE, SCORE_INFINITE));
+    r.score = int16_t(std::clamp(score, -SCORE_INFINITE, SCORE_INFINITE));
+    r.move = frame.move;
+    r.ply = uint8_t(ply);
+    r.depth = int8_t(std::clamp(depth, -128, 127));
+    r.type = score >= beta ? TraceRecord::CUT_NODE : score <= alpha ? TraceRecord::ALL_NODE : TraceRecord::PV_NODE;
+    r.flags = frame.flags;
+    r.moves = frame.moves;
+}
+
+namespace {
+    // A record waiting for its parent, with the size of its subtree
+    struct PendingNode {
+        uint8_t ply;
+        uint64_t subtree;
+    };
+    
+    struct PlyTotals {
+        uint64_t nodes = 0;
+        uint64_t qnodes = 0;
+        uint64_t expanded = 0;       // nodes with at least one child record
+        uint64_t children = 0;
+        uint64_t cut_nodes = 0;      // failed high after searching moves
+        uint64_t first_move_cuts = 0;
+        uint64_t cut_index_sum = 0;
+    };
+    
+    // A cut node whose cutoff came late, with the nodes spent on the
+    // children searched before the move that failed high
+    struct OrderingFailure {
+        TraceRecord record;
+        uint64_t wasted;
+    };
+    
+    double ratio(uint64_t part, uint64_t total) {
+        return total ? double(part) / total : 0.0;
+    }
+}
+
+bool TraceAnalyzer::run(const std::string& path, const Options& options, std::ostream& out) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(TraceHeader)) {
+        ::close(fd);
+        return false;
+    }
+    
+    void* memory = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) return false;
+    
+    const TraceHeader* header = static_cast<const TraceHeader*>(memory);
+    const TraceRecord* records = reinterpret_cast<const TraceRecord*>(header + 1);
+    uint64_t written = header->written;
+    uint64_t capacity = header->capacity;
+    uint64_t stored = std::min(written, capacity);
+    
+    if (header->magic != TRACE_MAGIC || header->version != TRACE_VERSION
+        || header->record_size != sizeof(TraceRecord) || capacity == 0
+        || sizeof(TraceHeader) + stored * sizeof(TraceRecord) > size_t(st.st_size)) {
+        munmap(memory, size_t(st.st_size));
+        return false;
+    }
+    
+    // Oldest first: after wrapping, the oldest record is the next one to be overwritten
+    uint64_t first = written > capacity ? written % capacity : 0;
+    
+    std::vector<PlyTotals> plies(MAX_PLY + 1);
+    std::vector<PendingNode> pending;
+    std::vector<OrderingFailure> failures;
+    uint64_t orphans = 0;
+    
+    auto worse = [](const OrderingFailure& a, const OrderingFailure& b) { return a.wasted > b.wasted; };
+    
+    for (uint64_t n = 0; n < stored; n++) {
+        const TraceRecord& r = records[(first + n) % capacity];
+        PlyTotals& totals = plies[std::min<int>(r.ply, MAX_PLY)];
+        
+        // Adopt the pending nodes one ply deeper; deeper ones lost their
+        // parent to the ring or to a stopped search
+        uint64_t subtree = 1;
+        uint64_t children = 0;
+        uint64_t last_child = 0;
+        while (!pending.empty() && pending.back().ply > r.ply) {
+            if (pending.back().ply == r.ply + 1) {
+                if (children == 0) last_child = pending.back().subtree;
+                subtree += pending.back().subtree;
+                children++;
+            } else {
+                orphans += pending.back().subtree;
+            }
+            pending.pop_back();
+        }
+        
+        totals.nodes++;
+        if (r.flags & TraceRecord::QUIESCENCE) totals.qnodes++;
+        if (children) {
+            totals.expanded++;
+            totals.children += children;
+        }
+        
+        if (r.type == TraceRecord::CUT_NODE && r.moves > 0 && !(r.flags & TraceRecord::STOPPED)) {
+            totals.cut_nodes++;
+            totals.first_move_cuts += r.moves == 1;
+            totals.cut_index_sum += r.moves - 1;
+            
+            if (r.moves > 1 && options.top > 0) {
+                failures.push_back({r, subtree - 1 - last_child});
+                std::push_heap(failures.begin(), failures.end(), worse);
+                if (failures.size() > size_t(options.top)) {
+                    std::pop_heap(failures.begin(), failures.end(), worse);
+                    failures.pop_back();
+                }
+            }
+        }
+        
+        pending.push_back({r.ply, subtree});
+    }
+    
+    munmap(memory, size_t(st.st_size));
+    
+    out << "records " << stored << " of " << written << " written";
+    if (written > capacity) out << " (oldest dropped)";
+    out << ", orphaned " << orphans << "\n\n";
+    
+    out << "ply      nodes     qnodes  branching   cut nodes  first-move  mean index\n";
+    for (int ply = 0; ply <= MAX_PLY; ply++) {
+        const PlyTotals& t = plies[ply];
+        if (t.nodes == 0) continue;
+        
+        out << std::setw(3) << ply << std::setw(11) << t.nodes << std::setw(11) << t.qnodes
+            << std::fixed << std::setprecision(2)
+            << std::setw(11) << ratio(t.children, t.expanded)
+            << std::setw(12) << t.cut_nodes
+            << std::setw(11) << 100.0 * ratio(t.first_move_cuts, t.cut_nodes) << "%"
+            << std::setw(12) << ratio(t.cut_index_sum, t.cut_nodes) << "\n";
+    }
+    
+    if (!failures.empty()) {
+        std::sort_heap(failures.begin(), failures.end(), worse);
+        
+        out << "\nlate cutoffs, by nodes searched before the move that failed high\n";
+        for (const OrderingFailure& f : failures) {
+            const TraceRecord& r = f.record;
+            out << "ply " << int(r.ply) << " depth " << int(r.depth)
+                << " key " << std::hex << std::setw(16) << std::setfill('0') << r.key
+                << std::dec << std::setfill(' ')
+                << " move " << MoveUtils::to_string(r.move) << " index " << int(r.moves) - 1
+                << " wasted " << f.wasted << " window " << r.alpha << " " << r.beta << "\n";
+        }
+    }
+    
+    return true;
+}
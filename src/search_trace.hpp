@@ -0,0 +1,132 @@
+// ===== SEARCH TRACE =====
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Build with -DSEARCH_TRACE to record the search tree of a thread into a
+// memory-mapped file. Without it every recording call is an empty inline
+// function and compiles away.
+#ifdef SEARCH_TRACE
+constexpr bool SEARCH_TRACE_ENABLED = true;
+#else
+constexpr bool SEARCH_TRACE_ENABLED = false;
+#endif
+
+constexpr uint32_t TRACE_MAGIC = 0x5458454E; // "NEXT"
+constexpr uint32_t TRACE_VERSION = 1;
+
+// One searched node, written when it returns, so that the children of a
+// node always precede it in the trace
+struct TraceRecord {
+    enum NodeType : uint8_t { PV_NODE, CUT_NODE, ALL_NODE };
+    
+    enum Flag : uint8_t {
+        QUIESCENCE = 1,
+        IN_CHECK = 2,
+        TT_CUTOFF = 4,
+        PRUNED = 8,      // cut off before any move: null move, futility, stand pat
+        STOPPED = 16     // interrupted; the score is meaningless
+    };
+    
+    uint64_t key;
+    int16_t alpha;       // window on entry
+    int16_t beta;
+    int16_t score;
+    Move move;           // best move, the one that failed high on a cut node
+    uint8_t ply;
+    int8_t depth;        // zero and below in quiescence
+    uint8_t type;        // by score against the window
+    uint8_t flags;
+    uint8_t moves;       // legal moves searched, saturating
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(TraceRecord) == 24, "trace records are read back from files");
+
+// The file is this header followed by a ring of capacity records; record
+// n of the trace is in slot n % capacity, so once written exceeds the
+// capacity only the most recent records are kept
+struct TraceHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t capacity;
+    uint64_t written;
+};
+
+// Recorder of the calling thread. The search enters a frame per node,
+// marks it as it goes, and the record is written when the node returns.
+class SearchTrace {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = size_t(1) << 22;   // 96 MB
+    
+    static thread_local SearchTrace local;
+    
+    SearchTrace() = default;
+    ~SearchTrace();
+    
+    SearchTrace(const SearchTrace&) = delete;
+    SearchTrace& operator=(const SearchTrace&) = delete;
+    
+    // Starts a new trace file; capacity is rounded up to a power of two
+    bool open(const std::string& path, size_t capacity = DEFAULT_CAPACITY);
+    
+    // A trace that never wrapped is cut to the records written
+    void close();
+    bool is_open() const { return header != nullptr; }
+    
+    static void enter(int ply) {
+        if constexpr (SEARCH_TRACE_ENABLED) {
+            if (local.header) local.frames[ply] = Frame();
+        }
+    }
+    
+    static void flag(int ply, TraceRecord::Flag f) {
+        if constexpr (SEARCH_TRACE_ENABLED) local.frames[ply].flags |= f;
+    }
+    
+    static void moves(int ply, Move best_move, int legal_moves) {
+        if constexpr (SEARCH_TRACE_ENABLED) {
+            local.frames[ply].move = best_move;
+            local.frames[ply].moves = uint8_t(legal_moves < 255 ? legal_moves : 255);
+        }
+    }
+    
+    static void leave(uint64_t key, int ply, int depth, Score alpha, Score beta, Score score) {
+        if constexpr (SEARCH_TRACE_ENABLED) {
+            if (local.header) local.write(key, ply, depth, alpha, beta, score);
+        }
+    }
+    
+private:
+    struct Frame {
+        Move move = 0;
+        uint8_t flags = 0;
+        uint8_t moves = 0;
+    };
+    
+    TraceHeader* header = nullptr;
+    TraceRecord* records = nullptr;
+    size_t mask = 0;
+    size_t mapped_size = 0;
+    int fd = -1;
+    Frame frames[MAX_PLY + 1];
+    
+    void write(uint64_t key, int ply, int depth, Score alpha, Score beta, Score score);
+};
+
+// Offline reader of a trace. The tree is rebuilt from the order of the
+// records: the nodes a record adopts are the pending ones one ply deeper.
+// Reports the nodes and branching factor per ply, how often the first
+// move caused the cutoff, and the cut nodes that searched the most nodes
+// before the move that failed high.
+class TraceAnalyzer {
+public:
+    struct Options {
+        int top = 20;   // ordering failures listed
+    };
+    
+    // False if the file is not a readable trace
+    static bool run(const std::string& path, const Options& options, std::ostream& out);
+};
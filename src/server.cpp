@@ -0,0 +1,392 @@
+#include "server.hpp"
+#include "uci.hpp"
+#include "move_utils.hpp"
+#include <algorithm>
+#include <csignal>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    volatile std::sig_atomic_t interrupted = 0;
+    
+    void on_signal(int) {
+        interrupted = 1;
+    }
+    
+    // Whether a search stopped at the end of its time slice was done anyway
+    bool reached_limit(const SearchEngine::SearchInfo& info, int depth, int elapsed_ms, int nodes) {
+        if (info.infinite) return false;
+        return depth >= std::min(info.max_depth, MAX_PLY - 1) || elapsed_ms >= info.max_time_ms
+               || nodes >= info.max_nodes;
+    }
+}
+
+AnalysisServer::Session::~Session() {
+    if (fd >= 0) close(fd);
+}
+
+// Output from a session that has disconnected is silently dropped
+void AnalysisServer::Session::send(const std::string& line) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    std::string data = line + '\n';
+    
+    for (size_t sent = 0; sent < data.size();) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        sent += size_t(n);
+    }
+}
+
+AnalysisServer::AnalysisServer(const Options& options)
+    : options(options), listen_fd(-1), next_session_id(0), shutting_down(false) {
+    if (options.table_mode != TT_PRIVATE) {
+        shared_tt = std::make_unique<TranspositionTable>(options.hash_mb);
+    }
+}
+
+AnalysisServer::~AnalysisServer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutting_down = true;
+        for (auto& session : sessions) {
+            session->closed = true;
+            if (session->running) session->engine->stop_search();
+        }
+    }
+    work_available.notify_all();
+    
+    for (auto& thread : workers) thread.join();
+    
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(options.socket_path.c_str());
+    }
+}
+
+bool AnalysisServer::run() {
+    if (!open_socket()) return false;
+    
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+    
+    for (int i = 0; i < std::max(1, options.threads); i++) {
+        workers.emplace_back(&AnalysisServer::worker, this);
+    }
+    
+    std::cout << "listening on " << options.socket_path << std::endl;
+    
+    std::vector<pollfd> fds;
+    std::vector<std::shared_ptr<Session>> polled;
+    
+    while (!interrupted) {
+        fds.assign(1, {listen_fd, POLLIN, 0});
+        polled = sessions;
+        for (auto& session : polled) {
+            fds.push_back({session->fd, POLLIN, 0});
+        }
+        
+        int ready = poll(fds.data(), fds.size(), POLL_INTERVAL_MS);
+        preempt_searches();
+        if (ready <= 0) continue;
+        
+        for (size_t i = 0; i < polled.size(); i++) {
+            if (fds[i + 1].revents && !read_session(polled[i])) {
+                close_session(*polled[i]);
+            }
+        }
+        
+        if (fds[0].revents & POLLIN) accept_session();
+        
+        sessions.erase(std::remove_if(sessions.begin(), sessions.end(),
+                                      [](const auto& session) { return session->closed; }),
+                       sessions.end());
+    }
+    
+    return true;
+}
+
+// A stale socket file left behind by a previous server is replaced
+bool AnalysisServer::open_socket() {
+    sockaddr_un address{};
+    if (options.socket_path.empty() || options.socket_path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "invalid socket path: " << options.socket_path << std::endl;
+        return false;
+    }
+    
+    address.sun_family = AF_UNIX;
+    options.socket_path.copy(address.sun_path, options.socket_path.size());
+    
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        std::cerr << "cannot create socket" << std::endl;
+        return false;
+    }
+    
+    unlink(options.socket_path.c_str());
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || listen(listen_fd, SOMAXCONN) != 0) {
+        std::cerr << "cannot listen on " << options.socket_path << std::endl;
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    
+    return true;
+}
+
+void AnalysisServer::accept_session() {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) return;
+    
+    if (int(sessions.size()) >= options.max_sessions) {
+        close(fd);
+        return;
+    }
+    
+    auto session = std::make_shared<Session>();
+    session->fd = fd;
+    session->id = next_session_id++;
+    
+    switch (options.table_mode) {
+    case TT_SHARED:
+        session->engine = std::make_unique<SearchEngine>(*shared_tt);
+        break;
+    case TT_TAGGED:
+        // Odd multiplier, so every session gets a distinct non-zero tag
+        session->engine = std::make_unique<SearchEngine>(*shared_tt, (session->id + 1) * 0x9E3779B97F4A7C15ULL);
+        break;
+    case TT_PRIVATE:
+        session->engine = std::make_unique<SearchEngine>(options.session_hash_mb);
+        break;
+    }
+    
+    sessions.push_back(session);
+}
+
+// Handles every complete line received; false once the client has gone
+bool AnalysisServer::read_session(const std::shared_ptr<Session>& session) {
+    char buffer[4096];
+    ssize_t n = recv(session->fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) return false;
+    
+    session->input.append(buffer, size_t(n));
+    
+    size_t newline;
+    while ((newline = session->input.find('\n')) != std::string::npos) {
+        std::string line = session->input.substr(0, newline);
+        session->input.erase(0, newline + 1);
+        
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        handle_command(session, line);
+        if (session->closed) return false;
+    }
+    
+    return true;
+}
+
+void AnalysisServer::handle_command(const std::shared_ptr<Session>& session, const std::string& line) {
+    std::vector<std::string> tokens = UCIInterface::split_string(line);
+    if (tokens.empty()) return;
+    
+    const std::string& command = tokens[0];
+    
+    if (command == "uci") {
+        session->send("id name Nexus Chess");
+        session->send("id author the Nexus Chess developers");
+        session->send("uciok");
+    } else if (command == "isready") {
+        session->send("readyok");
+    } else if (command == "ucinewgame") {
+        // Tables in use by a search are left alone
+        std::lock_guard<std::mutex> lock(mutex);
+        session->position = Position();
+        if (!session->running && !session->pending) session->engine->clear();
+    } else if (command == "position") {
+        std::string base;
+        std::vector<std::string> moves;
+        if (!UCIInterface::parse_position(tokens, base, moves)) return;
+        
+        Position pos;
+        if (!pos.set_fen(base)) {
+            session->send("info string invalid fen");
+            return;
+        }
+        for (const std::string& move : moves) {
+            Move m = UCIInterface::parse_move(move, pos);
+            if (MoveUtils::is_null(m)) {
+                session->send("info string invalid move " + move);
+                break;
+            }
+            pos.do_move(m);
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        session->position = pos;
+    } else if (command == "go") {
+        handle_go(session, tokens);
+    } else if (command == "stop") {
+        handle_stop(*session);
+    } else if (command == "quit") {
+        close_session(*session);
+    }
+}
+
+// A "go" during a search stops it; the new search is queued behind the
+// other sessions' requests and starts once a worker is free
+void AnalysisServer::handle_go(const std::shared_ptr<Session>& session, const std::vector<std::string>& tokens) {
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    // Sent under the lock, so that no worker can start the new search first
+    if (session->resuming) {
+        session->send("bestmove " + MoveUtils::to_string(session->reported_move));
+        session->resuming = false;
+    }
+    
+    std::vector<std::string> invalid;
+    session->pending_position = session->position;
+    session->pending_info = UCIInterface::parse_go(tokens, session->position.side_to_move(), &invalid);
+    session->pending = true;
+    
+    for (const std::string& value : invalid) {
+        session->send("info string ignoring invalid " + value);
+    }
+    
+    if (session->running) {
+        session->engine->stop_search();
+    } else {
+        schedule(session);
+    }
+}
+
+// A search that has not started yet is cut down to one iteration, so that
+// the client still receives its bestmove; a preempted one answers with
+// the best move it has reported
+void AnalysisServer::handle_stop(Session& session) {
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    if (session.running) {
+        session.stop_requested = true;
+        session.engine->stop_search();
+    }
+    if (session.resuming) {
+        session.send("bestmove " + MoveUtils::to_string(session.reported_move));
+        session.resuming = false;
+        session.pending = false;
+    } else if (session.pending) {
+        session.pending_info.infinite = false;
+        session.pending_info.max_depth = 1;
+    }
+}
+
+void AnalysisServer::close_session(Session& session) {
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    session.closed = true;
+    if (session.running) session.engine->stop_search();
+}
+
+// Searches that have used up their time slice while other sessions wait
+// are stopped; the worker queues them again to go on later
+void AnalysisServer::preempt_searches() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (run_queue.empty()) return;
+    
+    auto slice_end = std::chrono::steady_clock::now() - std::chrono::milliseconds(options.time_slice_ms);
+    for (auto& session : sessions) {
+        if (session->running && !session->preempted && session->slice_start <= slice_end) {
+            session->preempted = true;
+            session->engine->stop_search();
+        }
+    }
+}
+
+// Requires the mutex
+void AnalysisServer::schedule(const std::shared_ptr<Session>& session) {
+    if (session->queued) return;
+    
+    session->queued = true;
+    run_queue.push_back(session);
+    work_available.notify_one();
+}
+
+void AnalysisServer::worker() {
+    std::unique_lock<std::mutex> lock(mutex);
+    
+    while (true) {
+        work_available.wait(lock, [this] { return shutting_down || !run_queue.empty(); });
+        if (shutting_down) return;
+        
+        std::shared_ptr<Session> session = run_queue.front();
+        run_queue.pop_front();
+        session->queued = false;
+        if (session->closed || !session->pending) continue;
+        
+        Position pos = session->pending_position;
+        SearchEngine::SearchInfo info = session->pending_info;
+        bool resumed = session->resuming;
+        session->pending = false;
+        session->resuming = false;
+        session->preempted = false;
+        session->stop_requested = false;
+        session->running = true;
+        session->engine->clear_stop();
+        session->slice_start = std::chrono::steady_clock::now();
+        lock.unlock();
+        
+        Session* s = session.get();
+        if (!resumed) {
+            s->reported_depth = 0;
+            s->reported_move = 0;
+        }
+        
+        info.on_iteration = [this, s](const SearchEngine::SearchResult& result) {
+            // A resumed search first repeats the iterations it has reported
+            if (result.depth > s->reported_depth) {
+                s->reported_depth = result.depth;
+                s->reported_move = result.best_move;
+                s->send(UCIInterface::format_info(result));
+            }
+            
+            // Catches a stop that arrived before the search had started
+            std::lock_guard<std::mutex> guard(mutex);
+            if (s->stop_requested || s->pending || s->closed || s->preempted) s->engine->stop_search();
+        };
+        
+        Move best_move = session->engine->search(pos, info);
+        int depth = session->engine->last_result().depth;
+        int nodes = session->engine->nodes();
+        
+        lock.lock();
+        int elapsed = int(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - session->slice_start).count());
+        
+        // Preempted: the same search goes on from the table when a worker
+        // is free again, with what is left of its limits
+        if (session->preempted && !session->stop_requested && !session->pending && !session->closed
+            && !reached_limit(info, depth, elapsed, nodes)) {
+            if (!info.infinite) {
+                info.max_time_ms -= elapsed;
+                info.max_nodes -= nodes;
+            }
+            session->pending_position = pos;
+            session->pending_info = info;
+            session->pending = true;
+            session->resuming = true;
+            session->running = false;
+            schedule(session);
+            continue;
+        }
+        lock.unlock();
+        
+        // A resumed search cut short answers with the deeper move it reported before
+        if (depth < s->reported_depth) best_move = s->reported_move;
+        session->send("bestmove " + MoveUtils::to_string(best_move));
+        
+        lock.lock();
+        session->running = false;
+        if (session->pending && !session->closed) schedule(session);
+    }
+}
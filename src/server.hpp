@@ -0,0 +1,99 @@
+// ===== ANALYSIS SERVER =====
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Serves UCI-like analysis sessions over a Unix domain socket from a
+// single process. Every connection gets its own Position and SearchEngine;
+// the attack tables, the worker threads and optionally the transposition
+// table are shared by all of them. A search that has run for a time slice
+// while other sessions wait gives up its worker and is queued again.
+class AnalysisServer {
+public:
+    // How sessions use transposition tables: one table for everybody, one
+    // table with a per-session tag mixed into the keys, or a small private
+    // table each
+    enum TableMode { TT_SHARED, TT_TAGGED, TT_PRIVATE };
+    
+    struct Options {
+        std::string socket_path;
+        int threads = 1;
+        size_t hash_mb = 64;
+        TableMode table_mode = TT_TAGGED;
+        size_t session_hash_mb = 1;   // TT_PRIVATE only
+        int max_sessions = 1024;
+        int time_slice_ms = 200;
+    };
+    
+    explicit AnalysisServer(const Options& options);
+    ~AnalysisServer();
+    
+    // Accepts connections until SIGINT or SIGTERM; false if the socket
+    // cannot be set up
+    bool run();
+    
+private:
+    static constexpr int POLL_INTERVAL_MS = 100;
+    
+    struct Session {
+        int fd = -1;
+        uint64_t id = 0;
+        std::string input;
+        std::unique_ptr<SearchEngine> engine;
+        
+        // Protected by the server mutex
+        Position position;
+        Position pending_position;
+        SearchEngine::SearchInfo pending_info;
+        bool pending = false;   // a "go" waits to be started
+        bool resuming = false;  // ...or a preempted search waits to go on
+        bool queued = false;    // the session is in the run queue
+        bool running = false;   // a worker is searching for it
+        bool preempted = false; // its time slice is over
+        bool stop_requested = false;
+        bool closed = false;
+        std::chrono::steady_clock::time_point slice_start;
+        
+        // The deepest iteration reported for the current "go", which a
+        // resumed search only reports beyond. Written by the worker that
+        // runs the session, read by others only while it is not running.
+        int reported_depth = 0;
+        Move reported_move = 0;
+        
+        // Serialises output from the event loop and the workers
+        std::mutex write_mutex;
+        
+        ~Session();
+        void send(const std::string& line);
+    };
+    
+    Options options;
+    std::unique_ptr<TranspositionTable> shared_tt;
+    int listen_fd;
+    uint64_t next_session_id;
+    std::vector<std::shared_ptr<Session>> sessions;
+    
+    // Sessions with a pending search, oldest request first. A session is
+    // in the queue at most once and a search runs for at most a time slice
+    // while others wait, so every session gets a worker in turn no matter
+    // how often it sends "go" or how long it searches.
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::deque<std::shared_ptr<Session>> run_queue;
+    std::vector<std::thread> workers;
+    bool shutting_down;
+    
+    bool open_socket();
+    void accept_session();
+    bool read_session(const std::shared_ptr<Session>& session);
+    void handle_command(const std::shared_ptr<Session>& session, const std::string& line);
+    void handle_go(const std::shared_ptr<Session>& session, const std::vector<std::string>& tokens);
+    void handle_stop(Session& session);
+    void close_session(Session& session);
+    void preempt_searches();
+    void schedule(const std::shared_ptr<Session>& session);
+    void worker();
+};
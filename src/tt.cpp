@@ -0,0 +1,220 @@
+#include "tt.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    // Slots are read and written by several searching threads at once
+    uint64_t load_word(const uint64_t& word) {
+        return std::atomic_ref<uint64_t>(const_cast<uint64_t&>(word)).load(std::memory_order_relaxed);
+    }
+    
+    void store_word(uint64_t& word, uint64_t value) {
+        std::atomic_ref<uint64_t>(word).store(value, std::memory_order_relaxed);
+    }
+    
+    uint64_t pack(const TTEntry& entry) {
+        return uint64_t(uint16_t(entry.score)) | uint64_t(entry.best_move) << 16
+             | uint64_t(uint8_t(entry.depth)) << 32 | uint64_t(entry.flag) << 40
+             | uint64_t(entry.generation) << 48;
+    }
+    
+    // False if the slot holds another position or was torn by a
+    // concurrent write
+    bool read_slot(const TTSlot& slot, uint64_t key, TTEntry& entry) {
+        uint64_t data = load_word(slot.data);
+        if ((load_word(slot.key_xor_data) ^ data) != key) return false;
+        
+        entry.key = key;
+        entry.score = int16_t(uint16_t(data));
+        entry.best_move = Move(data >> 16);
+        entry.depth = int8_t(uint8_t(data >> 32));
+        entry.flag = uint8_t(data >> 40);
+        entry.generation = uint8_t(data >> 48);
+        return true;
+    }
+    
+    void write_slot(TTSlot& slot, const TTEntry& entry) {
+        uint64_t data = pack(entry);
+        store_word(slot.data, data);
+        store_word(slot.key_xor_data, entry.key ^ data);
+    }
+    
+    bool write_all(int fd, const void* data, size_t bytes) {
+        const char* p = static_cast<const char*>(data);
+        while (bytes > 0) {
+            // Linux transfers at most about 2 GB per call
+            ssize_t n = ::write(fd, p, std::min<size_t>(bytes, size_t(1) << 30));
+            if (n <= 0) return false;
+            p += n;
+            bytes -= size_t(n);
+        }
+        return true;
+    }
+}
+
+TranspositionTable::TranspositionTable(size_t mb_size)
+    : table(nullptr), exported(nullptr), generation(1), mapping(nullptr), mapping_size(0) {
+    allocate(mb_size);
+}
+
+TranspositionTable::~TranspositionTable() {
+    release();
+}
+
+void TranspositionTable::resize(size_t mb_size) {
+    release();
+    allocate(mb_size);
+}
+
+void TranspositionTable::allocate(size_t mb_size) {
+    // Round down to a power of two so the index is a mask of the key
+    size_t entries = mb_size * 1024 * 1024 / sizeof(TTSlot);
+    size = 1;
+    while (size * 2 <= entries) {
+        size *= 2;
+    }
+    mask = size - 1;
+    
+    table = new TTSlot[size];
+    clear();
+}
+
+void TranspositionTable::release() {
+    if (mapping) {
+        munmap(mapping, mapping_size);
+    } else {
+        delete[] table;
+    }
+    table = nullptr;
+    mapping = nullptr;
+    mapping_size = 0;
+}
+
+// Written under a temporary name and renamed over the target, so that an
+// interrupted save leaves the previous file intact and a table mapped
+// from the target keeps its pages
+bool TranspositionTable::save(const std::string& path) const {
+    std::string temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    
+    char page[TT_FILE_HEADER_SIZE] = {};
+    TTFileHeader header{TT_FILE_MAGIC, TT_FILE_VERSION, sizeof(TTSlot), generation, size, ZOBRIST_SEED};
+    std::memcpy(page, &header, sizeof(header));
+    
+    bool ok = write_all(fd, page, sizeof(page)) && write_all(fd, table, size * sizeof(TTSlot));
+    ok = ::close(fd) == 0 && ok;
+    
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+// The entry count is compared by dividing the file size, since a corrupt
+// count times the slot size could wrap around to the actual size
+bool TranspositionTable::load(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    
+    TTFileHeader header;
+    struct stat st;
+    bool valid = pread(fd, &header, sizeof(header), 0) == ssize_t(sizeof(header))
+                 && fstat(fd, &st) == 0
+                 && header.magic == TT_FILE_MAGIC && header.version == TT_FILE_VERSION
+                 && header.entry_size == sizeof(TTSlot) && header.zobrist_seed == ZOBRIST_SEED
+                 && std::has_single_bit(header.entries)
+                 && uint64_t(st.st_size) >= TT_FILE_HEADER_SIZE
+                 && header.entries == (uint64_t(st.st_size) - TT_FILE_HEADER_SIZE) / sizeof(TTSlot)
+                 && (uint64_t(st.st_size) - TT_FILE_HEADER_SIZE) % sizeof(TTSlot) == 0;
+    if (!valid) {
+        ::close(fd);
+        return false;
+    }
+    
+    // Private, so stores never reach the file, and without reserving swap
+    // for pages that are only ever read
+    size_t bytes = size_t(st.st_size);
+    void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_NORESERVE, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) return false;
+    
+    // Slots are probed at random, so read-ahead would only fetch pages nobody asked for
+    madvise(memory, bytes, MADV_RANDOM);
+    
+    release();
+    mapping = memory;
+    mapping_size = bytes;
+    table = reinterpret_cast<TTSlot*>(static_cast<char*>(memory) + TT_FILE_HEADER_SIZE);
+    size = size_t(header.entries);
+    mask = size - 1;
+    generation = uint8_t(header.generation + 1);
+    return true;
+}
+
+void TranspositionTable::store(uint64_t key, Score score, Move move, int depth, int flag) {
+    ScopedTimer timer(PROFILE_TT_STORE);
+    
+    TTEntry entry{key, int16_t(score), move, int8_t(depth), uint8_t(flag), generation};
+    if (replace(entry) && exported && depth >= exported->min_depth) {
+        export_entry(entry);
+    }
+}
+
+void TranspositionTable::merge(const TTEntry& entry) {
+    TTEntry merged = entry;
+    merged.generation = generation;
+    replace(merged);
+}
+
+// False when the slot keeps its current entry
+bool TranspositionTable::replace(TTEntry& entry) {
+    TTSlot& slot = table[entry.key & mask];
+    
+    // Same position: keep a deeper result of this generation unless this
+    // one is exact, and keep the old best move when there is no new one
+    TTEntry current;
+    if (read_slot(slot, entry.key, current)) {
+        if (entry.depth < current.depth && entry.flag != EXACT && current.generation == generation) return false;
+        if (entry.best_move == 0) entry.best_move = current.best_move;
+    }
+    
+    write_slot(slot, entry);
+    return true;
+}
+
+void TranspositionTable::export_entry(const TTEntry& entry) {
+    std::lock_guard<std::mutex> lock(exported->mutex);
+    exported->entries.push_back(entry);
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry& entry) {
+    ScopedTimer timer(PROFILE_TT_PROBE);
+    return read_slot(table[key & mask], key, entry);
+}
+
+// A cluster rank may merge entries received from its peers meanwhile
+void TranspositionTable::clear() {
+    for (size_t i = 0; i < size; i++) {
+        store_word(table[i].data, 0);
+        store_word(table[i].key_xor_data, 0);
+    }
+}
+
+// Permille of used entries among the first thousand, as UCI reports it
+int TranspositionTable::hashfull() const {
+    size_t sample = std::min<size_t>(size, 1000);
+    size_t used = 0;
+    for (size_t i = 0; i < sample; i++) {
+        used += load_word(table[i].key_xor_data) != 0;
+    }
+    return int(used * 1000 / sample);
+}
@@ -1,10 +1,55 @@
 // ===== TRANSPOSITION TABLE =====
+#include <atomic>
+#include <mutex>
+#include <string>
+
+enum TTFlag { EXACT, UPPER_BOUND, LOWER_BOUND };
+
+// Packed to 16 bytes so four entries share a cache line
 struct TTEntry {
     uint64_t key;
-    Score score;
+    int16_t score;
     Move best_move;
-    int depth;
-    int flag; // EXACT, UPPER_BOUND, LOWER_BOUND
+    int8_t depth;
+    uint8_t flag; // EXACT, UPPER_BOUND, LOWER_BOUND
+    uint8_t generation;
+};
+
+static_assert(sizeof(TTEntry) == 16, "TTEntry should stay 16 bytes");
+
+// An entry as it is kept in the table: everything but the key packed into
+// one word, and the key xor-ed with that word. Searches on other threads
+// may write a slot while it is read; a slot torn that way no longer
+// matches its key and reads as a miss, so no lock is needed.
+struct TTSlot {
+    uint64_t key_xor_data;
+    uint64_t data;
+};
+
+static_assert(sizeof(TTSlot) == 16, "four slots should share a cache line");
+
+// A saved table is this header followed by the slots as they are in
+// memory. The header fills a page so that the slots can be mapped in
+// place; any change to TTSlot or its packing must bump TT_FILE_VERSION.
+constexpr uint32_t TT_FILE_MAGIC = 0x5454454E; // "NETT"
+constexpr uint32_t TT_FILE_VERSION = 2;
+constexpr size_t TT_FILE_HEADER_SIZE = 4096;
+
+struct TTFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t generation;
+    uint64_t entries;
+    uint64_t zobrist_seed;
+};
+
+// Entries of at least min_depth copied out as they are stored, to be sent
+// to the other processes of a cluster search
+struct TTExport {
+    int min_depth;
+    std::mutex mutex;
+    std::vector<TTEntry> entries;
 };
 
 class TranspositionTable {
@@ -12,13 +57,47 @@ public:
     TranspositionTable(size_t mb_size);
     ~TranspositionTable();
     
+    // Replaces the table with an empty one of the given size
+    void resize(size_t mb_size);
+    
+    // Writes the table to a file; false on any I/O error
+    bool save(const std::string& path) const;
+    
+    // Maps a saved table copy-on-write in place of this one, taking its
+    // size; pages are read from the file as they are first probed. The
+    // restored entries belong to the generation before the current one.
+    // False, leaving the table as it was, if the file is not a table
+    // saved with the same entry layout and Zobrist keys.
+    bool load(const std::string& path);
+    
     void store(uint64_t key, Score score, Move move, int depth, int flag);
+    
+    // Stores an entry received from another table, without exporting it
+    void merge(const TTEntry& entry);
+    void set_export(TTExport* log) { exported = log; }
+    
     bool probe(uint64_t key, TTEntry& entry);
     void clear();
+    int hashfull() const;
+    size_t entry_count() const { return size; }
     
 private:
-    TTEntry* table;
+    TTSlot* table;
     size_t size;
     size_t mask;
+    TTExport* exported;
+    
+    // Stamped on stored entries; a deeper entry of an older one no longer
+    // protects its slot
+    uint8_t generation;
+    
+    // The file mapping behind a loaded table, which is not ours to delete
+    void* mapping;
+    size_t mapping_size;
+    
+    void allocate(size_t mb_size);
+    void release();
+    bool replace(TTEntry& entry);
+    void export_entry(const TTEntry& entry);
 };
 
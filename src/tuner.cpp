@@ -0,0 +1,323 @@
+#include "tuner.hpp"
+#include "eval_params.hpp"
+#include "packed_position.hpp"
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <thread>
+
+namespace {
+    constexpr size_t LOAD_CHUNK = 1 << 20;
+    
+    // Number of tuned weights, one per parameter and phase
+    constexpr int WEIGHT_NB = int(EVAL_PARAM_NB) * int(EVAL_PHASE_NB);
+    
+    constexpr double ADAM_BETA1 = 0.9;
+    constexpr double ADAM_BETA2 = 0.999;
+    constexpr double ADAM_EPSILON = 1e-8;
+    
+    struct ParamGroup {
+        const char* name;
+        int start;
+        int count;
+    };
+    
+    constexpr ParamGroup param_groups[] = {
+        {"Material", PARAM_MATERIAL, 5},
+        {"Piece-square tables: pawn", PARAM_PSQT + PAWN * 64, 64},
+        {"Piece-square tables: knight", PARAM_PSQT + KNIGHT * 64, 64},
+        {"Piece-square tables: bishop", PARAM_PSQT + BISHOP * 64, 64},
+        {"Piece-square tables: rook", PARAM_PSQT + ROOK * 64, 64},
+        {"Piece-square tables: queen", PARAM_PSQT + QUEEN * 64, 64},
+        {"Piece-square tables: king", PARAM_PSQT + KING * 64, 64},
+        {"Mobility", PARAM_MOBILITY, 4},
+        {"King zone attacks", PARAM_KING_ATTACK, 4},
+        {"Pawn shield", PARAM_PAWN_SHIELD, 1},
+        {"Doubled pawns", PARAM_DOUBLED_PAWN, 1},
+        {"Isolated pawns", PARAM_ISOLATED_PAWN, 1},
+        {"Passed pawns by rank", PARAM_PASSED_PAWN, 8},
+        {"Bishop pair", PARAM_BISHOP_PAIR, 1},
+    };
+    
+    // Runs body(thread) on every thread and waits for all of them
+    template<typename F>
+    void parallel(int threads, F&& body) {
+        std::vector<std::thread> pool;
+        for (int t = 1; t < threads; t++) pool.emplace_back(body, t);
+        body(0);
+        for (std::thread& thread : pool) thread.join();
+    }
+}
+
+Tuner::Tuner(const Options& options) : options(options) {
+    this->options.threads = std::max(1, options.threads);
+    
+    for (int p = 0; p < EVAL_PARAM_NB; p++) {
+        params[p][MIDGAME] = EVAL_PARAMS[p][MIDGAME];
+        params[p][ENDGAME] = EVAL_PARAMS[p][ENDGAME];
+    }
+}
+
+size_t Tuner::load(const std::string& path) {
+    PackedReader reader;
+    if (!reader.open(path)) return 0;
+    
+    size_t loaded = 0;
+    std::vector<PackedPosition> chunk;
+    std::vector<std::vector<EvalFeatures>> extracted(options.threads);
+    
+    while (size() < options.max_positions) {
+        chunk.clear();
+        PackedPosition record;
+        while (chunk.size() < LOAD_CHUNK && size() + chunk.size() < options.max_positions && reader.next(record)) {
+            chunk.push_back(record);
+        }
+        if (chunk.empty()) break;
+        
+        // Feature extraction is the slow part; the chunk is split evenly
+        size_t per_thread = (chunk.size() + options.threads - 1) / options.threads;
+        parallel(options.threads, [&](int t) {
+            size_t begin = std::min(chunk.size(), t * per_thread);
+            size_t end = std::min(chunk.size(), begin + per_thread);
+            Position pos;
+            
+            extracted[t].resize(end - begin);
+            for (size_t i = begin; i < end; i++) {
+                if (!chunk[i].unpack(pos)) {
+                    extracted[t][i - begin].terms.clear();
+                    continue;
+                }
+                Evaluator::extract_features(pos, extracted[t][i - begin]);
+            }
+        });
+        
+        for (int t = 0; t < options.threads; t++) {
+            size_t begin = std::min(chunk.size(), t * per_thread);
+            for (size_t i = 0; i < extracted[t].size(); i++) {
+                const PackedPosition& record = chunk[begin + i];
+                if (extracted[t][i].terms.empty()) continue;
+                
+                Score white_score = (record.flags & 1) ? -record.score : record.score;
+                add_position(extracted[t][i], GameOutcome(record.result), white_score);
+                loaded++;
+            }
+        }
+    }
+    
+    return loaded;
+}
+
+void Tuner::add_position(const EvalFeatures& eval, GameOutcome result, Score white_score) {
+    size_t first = features.size();
+    
+    for (const EvalFeatures::Term& term : eval.terms) {
+        int count = term.count;
+        while (count != 0) {
+            int part = std::clamp(count, -COUNT_LIMIT, COUNT_LIMIT);
+            features.push_back(uint16_t((term.param << COUNT_BITS) | (part & ((1 << COUNT_BITS) - 1))));
+            count -= part;
+        }
+    }
+    
+    // Positions with more features than a count can hold are dropped
+    if (features.size() - first > UINT8_MAX) {
+        features.resize(first);
+        return;
+    }
+    
+    feature_counts.push_back(uint8_t(features.size() - first));
+    phases.push_back(uint8_t(eval.phase));
+    results.push_back(uint8_t(result));
+    scores.push_back(int16_t(white_score));
+}
+
+void Tuner::make_slices() {
+    size_t per_thread = (size() + options.threads - 1) / options.threads;
+    
+    slice_positions.assign(1, 0);
+    slice_features.assign(1, 0);
+    
+    size_t offset = 0;
+    for (size_t i = 0; i < size(); i++) {
+        if (i > 0 && i % per_thread == 0) {
+            slice_positions.push_back(i);
+            slice_features.push_back(offset);
+        }
+        offset += feature_counts[i];
+    }
+    
+    slice_positions.push_back(size());
+    slice_features.push_back(offset);
+}
+
+// White's point of view, in centipawns
+double Tuner::evaluate(size_t feature_offset, size_t position) const {
+    double midgame = 0;
+    double endgame = 0;
+    
+    const uint16_t* f = features.data() + feature_offset;
+    for (int i = 0; i < feature_counts[position]; i++) {
+        int param = f[i] >> COUNT_BITS;
+        int count = int8_t(uint8_t(f[i] << (8 - COUNT_BITS))) >> (8 - COUNT_BITS);
+        midgame += params[param][MIDGAME] * count;
+        endgame += params[param][ENDGAME] * count;
+    }
+    
+    int phase = phases[position];
+    return (midgame * phase + endgame * (PHASE_MAX - phase)) / PHASE_MAX;
+}
+
+double Tuner::sigmoid(double k, double score) {
+    return 1.0 / (1.0 + std::pow(10.0, -k * score / 400.0));
+}
+
+double Tuner::target(size_t position) const {
+    double result = results[position] * 0.5;
+    if (options.lambda == 0) return result;
+    return options.lambda * sigmoid(scaling_k, scores[position]) + (1 - options.lambda) * result;
+}
+
+// Mean squared error of the current weights under scaling constant k
+double Tuner::total_error(double k) {
+    std::vector<double> errors(options.threads, 0.0);
+    
+    parallel(options.threads, [&](int t) {
+        if (t + 1 >= int(slice_positions.size())) return;
+        
+        size_t offset = slice_features[t];
+        double error = 0;
+        for (size_t i = slice_positions[t]; i < slice_positions[t + 1]; i++) {
+            double diff = sigmoid(k, evaluate(offset, i)) - results[i] * 0.5;
+            error += diff * diff;
+            offset += feature_counts[i];
+        }
+        errors[t] = error;
+    });
+    
+    double error = 0;
+    for (double e : errors) error += e;
+    return error / std::max<size_t>(size(), 1);
+}
+
+// The k that best maps the untuned evaluation onto game results
+void Tuner::fit_scaling() {
+    double low = 0.0;
+    double high = 4.0;
+    
+    for (int i = 0; i < 40; i++) {
+        double a = low + (high - low) / 3;
+        double b = high - (high - low) / 3;
+        if (total_error(a) < total_error(b)) {
+            high = b;
+        } else {
+            low = a;
+        }
+    }
+    
+    scaling_k = (low + high) / 2;
+}
+
+void Tuner::compute_gradient(int slice, Gradient& gradient) const {
+    std::fill(&gradient.params[0][0], &gradient.params[0][0] + WEIGHT_NB, 0.0);
+    gradient.error = 0;
+    
+    if (slice + 1 >= int(slice_positions.size())) return;
+    
+    constexpr double LN10 = 2.302585092994046;
+    size_t offset = slice_features[slice];
+    
+    for (size_t i = slice_positions[slice]; i < slice_positions[slice + 1]; i++) {
+        double s = sigmoid(scaling_k, evaluate(offset, i));
+        double diff = s - target(i);
+        gradient.error += diff * diff;
+        
+        // d(error)/d(eval), then split by phase onto each weight
+        double g = 2 * diff * s * (1 - s) * scaling_k * LN10 / 400;
+        double g_midgame = g * phases[i] / PHASE_MAX;
+        double g_endgame = g * (PHASE_MAX - phases[i]) / PHASE_MAX;
+        
+        const uint16_t* f = features.data() + offset;
+        for (int j = 0; j < feature_counts[i]; j++) {
+            int param = f[j] >> COUNT_BITS;
+            int count = int8_t(uint8_t(f[j] << (8 - COUNT_BITS))) >> (8 - COUNT_BITS);
+            gradient.params[param][MIDGAME] += g_midgame * count;
+            gradient.params[param][ENDGAME] += g_endgame * count;
+        }
+        
+        offset += feature_counts[i];
+    }
+}
+
+void Tuner::run(std::ostream& log) {
+    if (size() == 0) {
+        log << "tune: no positions loaded" << std::endl;
+        return;
+    }
+    
+    make_slices();
+    fit_scaling();
+    log << size() << " positions, " << features.size() * sizeof(uint16_t) / (1 << 20)
+        << " MB of features, K = " << scaling_k << ", error " << total_error(scaling_k) << std::endl;
+    
+    std::vector<Gradient> gradients(options.threads);
+    std::vector<double> m(WEIGHT_NB, 0.0);
+    std::vector<double> v(WEIGHT_NB, 0.0);
+    double* weights = &params[0][0];
+    
+    for (int epoch = 1; epoch <= options.epochs; epoch++) {
+        auto start = std::chrono::steady_clock::now();
+        
+        parallel(options.threads, [&](int t) { compute_gradient(t, gradients[t]); });
+        
+        double error = 0;
+        for (const Gradient& g : gradients) error += g.error;
+        
+        double beta1_power = 1 - std::pow(ADAM_BETA1, epoch);
+        double beta2_power = 1 - std::pow(ADAM_BETA2, epoch);
+        
+        for (int p = 0; p < WEIGHT_NB; p++) {
+            double g = 0;
+            for (const Gradient& gradient : gradients) g += (&gradient.params[0][0])[p];
+            g /= size();
+            
+            m[p] = ADAM_BETA1 * m[p] + (1 - ADAM_BETA1) * g;
+            v[p] = ADAM_BETA2 * v[p] + (1 - ADAM_BETA2) * g * g;
+            weights[p] -= options.learning_rate * (m[p] / beta1_power) / (std::sqrt(v[p] / beta2_power) + ADAM_EPSILON);
+        }
+        
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        log << "epoch " << epoch << " error " << error / size() << " time " << seconds << " s" << std::endl;
+        
+        if (epoch % options.save_every == 0 || epoch == options.epochs) save(log);
+    }
+}
+
+bool Tuner::save(std::ostream& log) const {
+    std::ofstream out(options.output);
+    if (!out) {
+        log << "tune: cannot write " << options.output << std::endl;
+        return false;
+    }
+    write_header(out, params);
+    return true;
+}
+
+// Writes eval_params.hpp, rounding every weight to whole centipawns
+void Tuner::write_header(std::ostream& out, const double params[][EVAL_PHASE_NB]) {
+    out << "// ===== EVALUATION PARAMETERS =====\n"
+        << "// Generated by `nexus tune`; retune rather than editing by hand.\n"
+        << "// {middlegame, endgame} weight of every EvalParam, in centipawns.\n"
+        << "constexpr Score EVAL_PARAMS[EVAL_PARAM_NB][EVAL_PHASE_NB] = {\n";
+    
+    for (const ParamGroup& group : param_groups) {
+        out << "    // " << group.name << "\n";
+        for (int i = 0; i < group.count; i++) {
+            const double* p = params[group.start + i];
+            out << (i % 8 == 0 ? "    " : " ")
+                << "{" << std::lround(p[MIDGAME]) << ", " << std::lround(p[ENDGAME]) << "},";
+            if (i % 8 == 7 || i == group.count - 1) out << "\n";
+        }
+    }
+    
+    out << "};\n";
+}
@@ -0,0 +1,70 @@
+// ===== EVALUATION TUNER =====
+#include <ostream>
+
+// Texel-style tuning of the evaluation weights. Positions are loaded once
+// as sparse feature counts, after which every epoch is a pass of dot
+// products over them on all threads followed by one Adam step.
+class Tuner {
+public:
+    struct Options {
+        int threads = 1;
+        int epochs = 1000;
+        double learning_rate = 1.0;
+        
+        // Weight of the search score against the game result in the target
+        double lambda = 0.0;
+        
+        size_t max_positions = SIZE_MAX;
+        std::string output = "eval_params.hpp";
+        int save_every = 50;
+    };
+    
+    explicit Tuner(const Options& options);
+    
+    // Appends the positions of a packed training file; returns how many
+    size_t load(const std::string& path);
+    size_t size() const { return phases.size(); }
+    
+    void run(std::ostream& log);
+    
+    static void write_header(std::ostream& out, const double params[][EVAL_PHASE_NB]);
+    
+private:
+    // One feature in 16 bits: parameter index above a signed 7-bit count.
+    // Larger counts are split over several features.
+    static constexpr int COUNT_BITS = 7;
+    static constexpr int COUNT_LIMIT = (1 << (COUNT_BITS - 1)) - 1;
+    static_assert(EVAL_PARAM_NB <= (1 << (16 - COUNT_BITS)), "parameter index does not fit a feature");
+    
+    struct Gradient {
+        double params[EVAL_PARAM_NB][EVAL_PHASE_NB];
+        double error;
+    };
+    
+    Options options;
+    double params[EVAL_PARAM_NB][EVAL_PHASE_NB];
+    double scaling_k = 1.0;
+    
+    // Structure of arrays, one entry per position, features back to back
+    std::vector<uint16_t> features;
+    std::vector<uint8_t> feature_counts;
+    std::vector<uint8_t> phases;
+    std::vector<uint8_t> results;   // GameOutcome
+    std::vector<int16_t> scores;    // white's point of view
+    
+    // First position and first feature of each thread's slice
+    std::vector<size_t> slice_positions;
+    std::vector<size_t> slice_features;
+    
+    void add_position(const EvalFeatures& eval, GameOutcome result, Score white_score);
+    void make_slices();
+    
+    double evaluate(size_t feature_offset, size_t position) const;
+    double target(size_t position) const;
+    double total_error(double k);
+    void fit_scaling();
+    void compute_gradient(int slice, Gradient& gradient) const;
+    bool save(std::ostream& log) const;
+    
+    static double sigmoid(double k, double score);
+};
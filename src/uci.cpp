@@ -0,0 +1,442 @@
+#include "uci.hpp"
+#include "move_utils.hpp"
+#include "movegen.hpp"
+#include "bitboard_utils.hpp"
+#include "bench.hpp"
+#include "mate_search.hpp"
+#include "search_trace.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+
+void UCIInterface::run(std::istream& in) {
+    std::string line;
+    
+    while (std::getline(in, line)) {
+        std::vector<std::string> tokens = split_string(line);
+        if (tokens.empty()) continue;
+        
+        const std::string& command = tokens[0];
+        
+        if (command == "uci") {
+            handle_uci();
+        } else if (command == "isready") {
+            handle_isready();
+        } else if (command == "ucinewgame") {
+            handle_stop();
+            position_base.clear();
+        } else if (command == "position") {
+            handle_position(line);
+        } else if (command == "setoption") {
+            handle_setoption(tokens);
+        } else if (command == "go") {
+            handle_go(line);
+        } else if (command == "savehash" || command == "loadhash") {
+            handle_hash_file(command, line);
+        } else if (command == "bench") {
+            handle_stop();
+            Benchmark::run(Benchmark::parse_options({tokens.begin() + 1, tokens.end()}), std::cout);
+        } else if (command == "stop") {
+            handle_stop();
+        } else if (command == "quit") {
+            handle_quit();
+            break;
+        }
+    }
+    
+    handle_stop();
+}
+
+void UCIInterface::handle_uci() {
+    std::cout << "id name Nexus Chess" << std::endl;
+    std::cout << "id author the Nexus Chess developers" << std::endl;
+    std::cout << "info string cpu path " << BitboardUtils::cpu_path() << std::endl;
+    if constexpr (SEARCH_STATS_ENABLED) {
+        std::cout << "option name StatsFile type string default <empty>" << std::endl;
+    }
+    if constexpr (SEARCH_TRACE_ENABLED) {
+        std::cout << "option name TraceFile type string default <empty>" << std::endl;
+    }
+    std::cout << "option name Hash type spin default 16 min 1 max " << MAX_HASH_MB << std::endl;
+    std::cout << "option name MetricsShm type string default <empty>" << std::endl;
+    std::cout << "option name MultiPV type spin default 1 min 1 max " << MAX_MULTI_PV << std::endl;
+    std::cout << "uciok" << std::endl;
+}
+
+void UCIInterface::handle_isready() {
+    std::cout << "readyok" << std::endl;
+}
+
+// position [startpos | fen <fen>] [moves <m1> ... <mN>]
+// When the base position is unchanged, only the part of the move list that
+// differs from the previous command is undone and replayed, which keeps
+// long games cheap and preserves the key history used for repetitions.
+// A FEN that does not parse leaves the current position alone.
+void UCIInterface::handle_position(const std::string& cmd) {
+    handle_stop();
+    
+    std::string base;
+    std::vector<std::string> moves;
+    if (!parse_position(split_string(cmd), base, moves)) return;
+    
+    // Length of the move list shared with the current position
+    size_t common = 0;
+    if (base == position_base) {
+        while (common < moves.size() && common < position_moves.size()
+               && moves[common] == position_moves[common]) {
+            common++;
+        }
+    } else {
+        Position parsed;
+        if (!parsed.set_fen(base)) {
+            std::cout << "info string invalid fen " << base << std::endl;
+            return;
+        }
+        
+        position = parsed;
+        position_base = base;
+        position_moves.clear();
+        applied_moves.clear();
+    }
+    
+    while (applied_moves.size() > common) {
+        position.undo_move(applied_moves.back());
+        applied_moves.pop_back();
+        position_moves.pop_back();
+    }
+    
+    for (size_t j = common; j < moves.size(); j++) {
+        Move m = parse_move(moves[j], position);
+        if (MoveUtils::is_null(m)) {
+            std::cout << "info string invalid move " << moves[j] << std::endl;
+            break;
+        }
+        
+        position.do_move(m);
+        applied_moves.push_back(m);
+        position_moves.push_back(moves[j]);
+    }
+}
+
+// Splits a "position" command into its base FEN and move list; false when
+// neither startpos nor a FEN is given
+bool UCIInterface::parse_position(const std::vector<std::string>& tokens,
+                                  std::string& base, std::vector<std::string>& moves) {
+    size_t i = 1;
+    
+    base.clear();
+    moves.clear();
+    
+    if (i < tokens.size() && tokens[i] == "startpos") {
+        base = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+        i++;
+    } else if (i < tokens.size() && tokens[i] == "fen") {
+        for (i++; i < tokens.size() && tokens[i] != "moves"; i++) {
+            if (!base.empty()) base += ' ';
+            base += tokens[i];
+        }
+    } else {
+        return false;
+    }
+    
+    if (i < tokens.size() && tokens[i] == "moves") {
+        moves.assign(tokens.begin() + i + 1, tokens.end());
+    }
+    return true;
+}
+
+Move UCIInterface::parse_move(const std::string& token, const Position& pos) {
+    Move m = MoveUtils::from_string(token, pos);
+    if (MoveUtils::is_null(m)) return m;
+    
+    std::vector<Move> moves = MoveGenerator::generate_moves(pos);
+    if (std::find(moves.begin(), moves.end(), m) == moves.end() || !pos.is_legal(m)) {
+        return MoveUtils::null_move();
+    }
+    return m;
+}
+
+void UCIInterface::handle_go(const std::string& cmd) {
+    handle_stop();
+    
+    std::vector<std::string> invalid;
+    SearchEngine::SearchInfo info = parse_go(split_string(cmd), position.side_to_move(), &invalid);
+    for (const std::string& value : invalid) {
+        std::cout << "info string ignoring invalid " << value << std::endl;
+    }
+    
+    // From here on a stop is meant for this search, even before it starts
+    engine.clear_stop();
+    mate_search.clear_stop();
+    
+    if (info.mate > 0) {
+        search_thread = std::thread([this, info]() {
+            SearchEngine::SearchResult result = mate_search.search(position, info.mate, info);
+            if (result.score >= SCORE_MATE_IN_MAX_PLY) {
+                std::cout << format_info(result) << std::endl;
+            } else {
+                std::cout << "info string no mate in " << info.mate << " found" << std::endl;
+            }
+            std::cout << "bestmove " << MoveUtils::to_string(result.best_move) << std::endl;
+        });
+        return;
+    }
+    
+    info.multi_pv = multi_pv;
+    info.on_iteration = [](const SearchEngine::SearchResult& result) {
+        std::cout << format_info(result) << std::endl;
+    };
+    
+    search_thread = std::thread([this, info]() {
+        // Each search rewrites the trace file
+        if (SEARCH_TRACE_ENABLED && !trace_file.empty() && !SearchTrace::local.open(trace_file)) {
+            std::cout << "info string cannot create " << trace_file << std::endl;
+        }
+        
+        Move best_move = engine.search(position, info);
+        SearchTrace::local.close();
+        if constexpr (SEARCH_STATS_ENABLED) write_search_stats();
+        if constexpr (SEARCH_PROFILE_ENABLED) engine.profile_buckets().write_info(std::cout);
+        std::cout << "bestmove " << MoveUtils::to_string(best_move) << std::endl;
+    });
+}
+
+// Search limits of a "go" command, with the clock of the side to move
+// turned into a time budget for this move. Once any limit is given the
+// others no longer apply; a bare "go" keeps the default limits.
+SearchEngine::SearchInfo UCIInterface::parse_go(const std::vector<std::string>& tokens, Color us,
+                                                std::vector<std::string>* invalid) {
+    SearchEngine::SearchInfo info;
+    int max_depth = MAX_PLY - 1;
+    int max_nodes = INT_MAX;
+    int max_time_ms = INT_MAX;
+    bool has_limit = false;
+    
+    int time_left = -1;
+    int increment = 0;
+    int moves_to_go = 30;
+    bool white = us == WHITE;
+    
+    // Reads the value after tokens[i] and steps over it
+    auto read_value = [&](size_t& i, int& value) {
+        const std::string& name = tokens[i++];
+        if (parse_number(tokens[i], value)) return true;
+        if (invalid) invalid->push_back(name + " " + tokens[i]);
+        return false;
+    };
+    
+    for (size_t i = 1; i < tokens.size(); i++) {
+        const std::string& token = tokens[i];
+        bool has_value = i + 1 < tokens.size();
+        int value;
+        
+        if (token == "infinite") {
+            info.infinite = true;
+        } else if (token == "depth" && has_value) {
+            has_limit |= read_value(i, max_depth);
+        } else if (token == "nodes" && has_value) {
+            has_limit |= read_value(i, max_nodes);
+        } else if (token == "movetime" && has_value) {
+            has_limit |= read_value(i, max_time_ms);
+        } else if ((token == "wtime" || token == "btime") && has_value) {
+            if (read_value(i, value) && (token == "wtime") == white) time_left = value;
+        } else if ((token == "winc" || token == "binc") && has_value) {
+            if (read_value(i, value) && (token == "winc") == white) increment = value;
+        } else if (token == "mate" && has_value) {
+            read_value(i, info.mate);
+        } else if (token == "movestogo" && has_value) {
+            if (read_value(i, value)) moves_to_go = std::max(1, value);
+        }
+    }
+    
+    if (time_left >= 0) {
+        max_time_ms = std::max(1, time_left / moves_to_go + increment / 2);
+        has_limit = true;
+    }
+    
+    if (has_limit) {
+        info.max_depth = max_depth;
+        info.max_nodes = max_nodes;
+        info.max_time_ms = max_time_ms;
+    }
+    
+    return info;
+}
+
+// setoption name <name> [value <value>]
+void UCIInterface::handle_setoption(const std::vector<std::string>& tokens) {
+    handle_stop();
+    
+    std::string name;
+    std::string value;
+    std::string* field = nullptr;
+    
+    for (size_t i = 1; i < tokens.size(); i++) {
+        if (tokens[i] == "name") {
+            field = &name;
+        } else if (tokens[i] == "value") {
+            field = &value;
+        } else if (field) {
+            if (!field->empty()) *field += ' ';
+            *field += tokens[i];
+        }
+    }
+    
+    if (name == "StatsFile") {
+        stats_file = value == "<empty>" ? "" : value;
+    } else if (name == "TraceFile") {
+        trace_file = value == "<empty>" ? "" : value;
+    } else if (name == "Hash") {
+        size_t mb;
+        if (parse_number(value, mb)) {
+            engine.table().resize(std::clamp<size_t>(mb, 1, MAX_HASH_MB));
+        } else {
+            std::cout << "info string ignoring invalid " << name << ' ' << value << std::endl;
+        }
+    } else if (name == "MultiPV") {
+        int lines;
+        if (parse_number(value, lines)) {
+            multi_pv = std::clamp(lines, 1, MAX_MULTI_PV);
+        } else {
+            std::cout << "info string ignoring invalid " << name << ' ' << value << std::endl;
+        }
+    } else if (name == "MetricsShm") {
+        // Publish live search metrics to a shared-memory segment of this name
+        if (value.empty() || value == "<empty>") {
+            metrics.close();
+            engine.set_metrics(nullptr);
+        } else if (metrics.open(value)) {
+            engine.set_metrics(&metrics);
+        } else {
+            engine.set_metrics(nullptr);
+            std::cout << "info string cannot create shared memory " << value << std::endl;
+        }
+    }
+}
+
+// Search statistics go to the GUI as "info string" lines, or are appended
+// to StatsFile as one JSON object per search
+void UCIInterface::write_search_stats() {
+    if (stats_file.empty()) {
+        engine.search_stats().write_info(std::cout);
+        return;
+    }
+    
+    std::ofstream file(stats_file, std::ios::app);
+    if (file) {
+        engine.search_stats().write_json(file);
+    } else {
+        std::cout << "info string cannot open " << stats_file << std::endl;
+    }
+}
+
+// savehash <file> | loadhash <file>
+// Saves the transposition table, or maps a saved one in its place and
+// takes its size, so that an analysis restarted later keeps its entries.
+void UCIInterface::handle_hash_file(const std::string& command, const std::string& line) {
+    handle_stop();
+    
+    size_t start = line.find_first_not_of(" \t", line.find(command) + command.size());
+    std::string path = start == std::string::npos ? "" : line.substr(start);
+    if (path.empty()) {
+        std::cout << "info string usage: " << command << " <file>" << std::endl;
+        return;
+    }
+    
+    bool save = command == "savehash";
+    TranspositionTable& tt = engine.table();
+    
+    auto start_time = std::chrono::steady_clock::now();
+    bool ok = save ? tt.save(path) : tt.load(path);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    
+    if (!ok) {
+        std::cout << "info string cannot " << (save ? "save hash to " : "load hash from ") << path << std::endl;
+        return;
+    }
+    
+    double mb = double(tt.entry_count() * sizeof(TTEntry)) / (1024 * 1024);
+    std::cout << "info string " << (save ? "saved " : "loaded ") << mb << " MB "
+              << (save ? "to " : "from ") << path << " in " << int(seconds * 1000) << " ms";
+    if (save && seconds > 0) std::cout << " (" << int(mb / seconds) << " MB/s)";
+    std::cout << std::endl;
+}
+
+void UCIInterface::handle_stop() {
+    if (search_thread.joinable()) {
+        engine.stop_search();
+        mate_search.stop();
+        search_thread.join();
+    }
+}
+
+void UCIInterface::handle_quit() {
+    handle_stop();
+}
+
+// "cp <x>" or "mate <n>", where n counts moves and is negative when mated
+std::string UCIInterface::format_score(Score score) {
+    if (score >= SCORE_MATE_IN_MAX_PLY) {
+        return "mate " + std::to_string((SCORE_MATE - score + 1) / 2);
+    }
+    if (score <= -SCORE_MATE_IN_MAX_PLY) {
+        return "mate " + std::to_string(-(SCORE_MATE + score) / 2);
+    }
+    return "cp " + std::to_string(score);
+}
+
+// The "info" line reporting one completed iteration, or one line per
+// MultiPV line
+std::string UCIInterface::format_info(const SearchEngine::SearchResult& result) {
+    int nps = result.time_ms > 0 ? int(int64_t(result.nodes) * 1000 / result.time_ms) : 0;
+    std::ostringstream ss;
+    
+    if (result.lines.empty()) {
+        ss << "info depth " << result.depth
+           << " seldepth " << result.seldepth
+           << " score " << format_score(result.score)
+           << " nodes " << result.nodes
+           << " nps " << nps
+           << " time " << result.time_ms
+           << " pv " << format_pv(result.pv);
+        return ss.str();
+    }
+    
+    for (size_t i = 0; i < result.lines.size(); i++) {
+        const SearchEngine::PVLine& line = result.lines[i];
+        if (i > 0) ss << '\n';
+        ss << "info depth " << line.depth
+           << " seldepth " << result.seldepth
+           << " multipv " << i + 1
+           << " score " << format_score(line.score)
+           << " nodes " << result.nodes
+           << " nps " << nps
+           << " time " << result.time_ms
+           << " pv " << format_pv(line.pv);
+    }
+    return ss.str();
+}
+
+std::string UCIInterface::format_pv(const std::vector<Move>& pv) {
+    std::string result;
+    for (Move m : pv) {
+        if (!result.empty()) result += ' ';
+        result += MoveUtils::to_string(m);
+    }
+    return result;
+}
+
+std::vector<std::string> UCIInterface::split_string(const std::string& str) {
+    std::vector<std::string> tokens;
+    std::istringstream ss(str);
+    std::string token;
+    
+    while (ss >> token) {
+        tokens.push_back(token);
+    }
+    
+    return tokens;
+}
@@ -1,18 +1,73 @@
 // ===== UCI INTERFACE =====
+#include <charconv>
+#include <iostream>
+#include <thread>
+
 class UCIInterface {
 public:
-    void run();
+    // Reads commands until "quit" or the end of the input
+    void run(std::istream& in = std::cin);
+    
+    static std::string format_score(Score score);
+    static std::string format_pv(const std::vector<Move>& pv);
+    static std::string format_info(const SearchEngine::SearchResult& result);
+    
+    static bool parse_position(const std::vector<std::string>& tokens,
+                               std::string& base, std::vector<std::string>& moves);
+    
+    // The move a token names in pos; the null move unless it is legal there
+    static Move parse_move(const std::string& token, const Position& pos);
+    
+    // Values that are not numbers are skipped and, when invalid is given,
+    // listed there as "<name> <value>"
+    static SearchEngine::SearchInfo parse_go(const std::vector<std::string>& tokens, Color us,
+                                             std::vector<std::string>* invalid = nullptr);
+    static std::vector<std::string> split_string(const std::string& str);
+    
+    // False, leaving value as it was, unless the whole token is a number
+    // that fits
+    template<typename T>
+    static bool parse_number(const std::string& token, T& value) {
+        T parsed;
+        const char* end = token.data() + token.size();
+        auto [last, error] = std::from_chars(token.data(), end, parsed);
+        if (error != std::errc() || last != end || token.empty()) return false;
+        
+        value = parsed;
+        return true;
+    }
     
 private:
+    static constexpr int MAX_MULTI_PV = 256;
+    static constexpr size_t MAX_HASH_MB = 1 << 20;
+    
     Position position;
+    MetricsPublisher metrics;
     SearchEngine engine;
+    MateSearch mate_search;
+    std::thread search_thread;
+    
+    // What the current position was built from, so that a following
+    // "position" command extending the same game only replays new moves
+    std::string position_base;
+    std::vector<std::string> position_moves;
+    std::vector<Move> applied_moves;
+    
+    // JSON destination for search statistics; "info string" when empty
+    std::string stats_file;
+    
+    // Destination of the search tree recording; none when empty
+    std::string trace_file;
+    
+    int multi_pv = 1;
     
     void handle_uci();
     void handle_isready();
     void handle_position(const std::string& cmd);
+    void handle_setoption(const std::vector<std::string>& tokens);
     void handle_go(const std::string& cmd);
+    void handle_hash_file(const std::string& command, const std::string& line);
     void handle_stop();
     void handle_quit();
-    
-    std::vector<std::string> split_string(const std::string& str);
+    void write_search_stats();
 };
@@ -0,0 +1,80 @@
+// Prints the live metrics page of a running engine.
+//
+//   metrics_reader <shm-name> [interval_ms]
+//
+// With an interval the page is polled until the segment disappears;
+// otherwise it is printed once. Build: g++ -std=c++20 -O2 metrics_reader.cpp -o metrics_reader
+#include "../src/metrics.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    const MetricsPage* map_page(const std::string& name) {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) return nullptr;
+        
+        struct stat info;
+        if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(MetricsPage)) {
+            close(fd);
+            return nullptr;
+        }
+        
+        void* memory = mmap(nullptr, sizeof(MetricsPage), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        return memory == MAP_FAILED ? nullptr : static_cast<const MetricsPage*>(memory);
+    }
+    
+    void print(const MetricsSnapshot& s) {
+        std::cout << (s.searching ? "searching" : "idle")
+                  << " depth " << s.depth << " seldepth " << s.seldepth
+                  << " nodes " << s.nodes << " nps " << s.nps
+                  << " hashfull " << s.hashfull << " threads";
+        for (uint32_t i = 0; i < s.threads && i < uint32_t(METRICS_MAX_THREADS); i++) {
+            std::cout << ' ' << s.thread_nodes[i];
+        }
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: metrics_reader <shm-name> [interval_ms]" << std::endl;
+        return 1;
+    }
+    
+    std::string name = argv[1][0] == '/' ? argv[1] : "/" + std::string(argv[1]);
+    int interval_ms = argc > 2 ? std::atoi(argv[2]) : 0;
+    
+    const MetricsPage* page = map_page(name);
+    if (!page) {
+        std::cerr << "cannot open " << name << std::endl;
+        return 1;
+    }
+    
+    MetricsSnapshot snapshot;
+    if (!page->read(snapshot)) {
+        std::cerr << name << ": unknown layout (version " << page->version
+                  << ", expected " << METRICS_VERSION << ")" << std::endl;
+        return 1;
+    }
+    print(snapshot);
+    
+    while (interval_ms > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        
+        // The engine unlinks the segment on exit
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) break;
+        close(fd);
+        
+        if (page->read(snapshot)) print(snapshot);
+    }
+    
+    return 0;
+}